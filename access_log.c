@@ -0,0 +1,281 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "access_log.h"
+
+static access_log_ring_t *get_thread_ring(void);
+static void create_ring_key(void);
+static void retire_thread_ring(void *thread_ring);
+static size_t drain_ring(access_log_ring_t *ring, char *buffer, size_t length);
+static size_t format_record(access_log_record_t *record, char *line);
+static char *get_time_string(time_t timestamp);
+static void write_log(char *buffer, size_t length);
+
+// Set once at startup, before any worker is started.
+static int log_fd = -1;
+
+// Every ring there is. Rings are never freed: when a thread exits, its ring goes on the idle list and the next thread
+// that logs something carries on adding to it, whether or not the flusher has caught up with it yet. In thread per
+// connection mode every connection is a new thread, and this keeps each one from allocating a ring of over a megabyte
+// of its own, so there are only ever as many rings as threads logging at once. The lock is only taken when a thread
+// first logs something, when it exits and by the flusher while it goes through the rings, never while a record is
+// added.
+static access_log_ring_t *rings_head = NULL;
+static access_log_ring_t *idle_rings_head = NULL;
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ring_key;
+static __thread access_log_ring_t *thread_ring = NULL;
+// How many times the flusher has been through the rings, so that access_log_finish knows when it has caught up.
+static atomic_ulong flushes_done = 0;
+
+// Opens the access log (appending to it if it already exists) and starts the flusher thread which writes records
+// into it. Returns false if either could not be done.
+bool access_log_init(char *access_log_path) {
+    log_fd = open(access_log_path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, ACCESS_LOG_FILE_MODE);
+    if(log_fd < 0) {
+        perror("open");
+        return false;
+    }
+    pthread_t flusher_id;
+    if(pthread_create(&flusher_id, NULL, access_log_flusher, NULL) != 0) {
+        perror("pthread_create");
+        return false;
+    }
+    pthread_detach(flusher_id);
+    return true;
+}
+
+bool access_log_enabled(void) {
+    return log_fd >= 0;
+}
+
+// Returns the time a request's response starts being worked on, to pass to access_log_response once it has been
+// sent. Returns NOT_LOGGING if there is no access log, in which case nothing is logged.
+long access_log_start(void) {
+    if(log_fd < 0) {
+        return NOT_LOGGING;
+    }
+    return monotonic_nanoseconds();
+}
+
+// Adds a record of the response to the calling thread's ring, for the flusher to write out. Never blocks: if the
+// ring is full, the record is dropped and counted. Must be called before the request the response points to is
+// moved out of its buffer. Nothing is logged for a response that has not been prepared or has already been released,
+// so connections can call this when they close without knowing whether they were in the middle of a response.
+void access_log_response(struct sockaddr_storage *client_addr, http_response_t *response, long started_at) {
+    if(started_at == NOT_LOGGING || response->status_code == NO_STATUS_CODE) {
+        return;
+    }
+    access_log_ring_t *ring = get_thread_ring();
+    if(ring == NULL) {
+        return;
+    }
+
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if(tail - atomic_load_explicit(&ring->head, memory_order_acquire) == ACCESS_LOG_RING_SIZE) {
+        atomic_store_explicit(&ring->dropped, atomic_load_explicit(&ring->dropped, memory_order_relaxed) + 1,
+                              memory_order_relaxed);
+        stats_count(STATS_ACCESS_LOG_DROPPED, 1);
+        return;
+    }
+
+    access_log_record_t *record = &ring->records[tail % ACCESS_LOG_RING_SIZE];
+    record->timestamp = time(NULL);
+    record->duration = monotonic_nanoseconds() - started_at;
+    record->bytes_sent = (long long) response_bytes_sent(response);
+    record->status_code = response->status_code;
+    record->protocol_version = response->protocol_version;
+    record->path_length = response->request_path.length < ACCESS_LOG_MAX_PATH_LENGTH ?
+            response->request_path.length : ACCESS_LOG_MAX_PATH_LENGTH;
+    memcpy(record->path, response->request_path.data, record->path_length);
+    record->family = client_addr->ss_family;
+    if(client_addr->ss_family == AF_INET) {
+        memcpy(record->address, &((struct sockaddr_in *) client_addr)->sin_addr, sizeof(struct in_addr));
+    } else if(client_addr->ss_family == AF_INET6) {
+        memcpy(record->address, &((struct sockaddr_in6 *) client_addr)->sin6_addr, sizeof(struct in6_addr));
+    }
+    // Publish the record to the flusher.
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+// Function that is passed into pthread_create for the flusher thread. Every ACCESS_LOG_FLUSH_INTERVAL_MS it takes
+// every record out of every ring, formats them into lines in a large buffer and writes the buffer out whenever it
+// fills up, so the log file sees a few large writes instead of one per request. Dropped records are reported on
+// stderr, at most once every ACCESS_LOG_DROP_REPORT_INTERVAL seconds.
+void *access_log_flusher(void *access_log_args) {
+    struct timespec interval = {.tv_sec = 0, .tv_nsec = ACCESS_LOG_FLUSH_INTERVAL_MS * NANOSECONDS_PER_MILLISECOND};
+    char *buffer = (char *) malloc (ACCESS_LOG_WRITE_BUFFER_SIZE);
+    size_t reported_dropped = 0;
+    time_t reported_at = 0;
+    if(buffer == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+
+    while(true) {
+        nanosleep(&interval, NULL);
+
+        size_t length = 0;
+        size_t dropped = 0;
+        pthread_mutex_lock(&rings_lock);
+        for(access_log_ring_t *ring = rings_head; ring != NULL; ring = ring->next) {
+            length = drain_ring(ring, buffer, length);
+            dropped += atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+        }
+        pthread_mutex_unlock(&rings_lock);
+        write_log(buffer, length);
+        atomic_fetch_add_explicit(&flushes_done, 1, memory_order_release);
+
+        if(dropped > reported_dropped && monotonic_seconds() - reported_at >= ACCESS_LOG_DROP_REPORT_INTERVAL) {
+            reported_at = monotonic_seconds();
+            fprintf(stderr, "access log: dropped %zu records, the log cannot keep up\n", dropped - reported_dropped);
+            reported_dropped = dropped;
+        }
+    }
+    return NULL;
+}
+
+// Waits for everything logged before the call to be written out, for a server that is about to exit. The flusher
+// may be part way through the rings when this is called, so it has to go through them twice before every record
+// added so far is certain to have been written.
+void access_log_finish(void) {
+    if(log_fd < 0) {
+        return;
+    }
+    struct timespec interval = {.tv_sec = 0, .tv_nsec = ACCESS_LOG_FLUSH_INTERVAL_MS * NANOSECONDS_PER_MILLISECOND};
+    unsigned long started_at = atomic_load_explicit(&flushes_done, memory_order_acquire);
+    while(atomic_load_explicit(&flushes_done, memory_order_acquire) - started_at < ACCESS_LOG_FINISH_FLUSHES) {
+        nanosleep(&interval, NULL);
+    }
+}
+
+// Returns the calling thread's ring, taking over an idle one or allocating and registering one the first time. The
+// key's destructor puts it back on the idle list when the thread exits. Returns NULL if it could not be allocated, in
+// which case nothing is logged.
+static access_log_ring_t *get_thread_ring(void) {
+    if(thread_ring != NULL) {
+        return thread_ring;
+    }
+    pthread_once(&ring_key_once, create_ring_key);
+
+    // Taking the ring under the lock that its last thread put it back under is what lets this thread carry on from
+    // where that one left off.
+    pthread_mutex_lock(&rings_lock);
+    access_log_ring_t *ring = idle_rings_head;
+    if(ring != NULL) {
+        idle_rings_head = ring->next_idle;
+    }
+    pthread_mutex_unlock(&rings_lock);
+
+    if(ring == NULL) {
+        // The ring has members aligned to cache lines, which malloc does not guarantee.
+        // https://man7.org/linux/man-pages/man3/aligned_alloc.3.html
+        ring = (access_log_ring_t *) aligned_alloc (ACCESS_LOG_CACHE_LINE_SIZE, sizeof(access_log_ring_t));
+        if(ring == NULL) {
+            perror("aligned_alloc");
+            return NULL;
+        }
+        atomic_init(&ring->head, 0);
+        atomic_init(&ring->tail, 0);
+        atomic_init(&ring->dropped, 0);
+
+        pthread_mutex_lock(&rings_lock);
+        ring->next = rings_head;
+        rings_head = ring;
+        pthread_mutex_unlock(&rings_lock);
+    }
+
+    pthread_setspecific(ring_key, ring);
+    thread_ring = ring;
+    return ring;
+}
+
+static void create_ring_key(void) {
+    pthread_key_create(&ring_key, retire_thread_ring);
+}
+
+// Called when a thread that logged something exits. Its ring stays where it is for the flusher, and goes on the idle
+// list for the next thread to take over.
+static void retire_thread_ring(void *thread_ring_block) {
+    access_log_ring_t *ring = (access_log_ring_t *) thread_ring_block;
+    pthread_mutex_lock(&rings_lock);
+    ring->next_idle = idle_rings_head;
+    idle_rings_head = ring;
+    pthread_mutex_unlock(&rings_lock);
+}
+
+// Takes every record out of the ring and formats it onto the end of the buffer, writing the buffer out first when
+// there is no room for another line. Returns the new length of the buffer.
+static size_t drain_ring(access_log_ring_t *ring, char *buffer, size_t length) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    while(head != tail) {
+        if(ACCESS_LOG_WRITE_BUFFER_SIZE - length < ACCESS_LOG_MAX_LINE_LENGTH) {
+            write_log(buffer, length);
+            length = 0;
+        }
+        length += format_record(&ring->records[head % ACCESS_LOG_RING_SIZE], buffer + length);
+        head++;
+        // Hand the slot back to the worker.
+        atomic_store_explicit(&ring->head, head, memory_order_release);
+    }
+    return length;
+}
+
+// Formats a record as a line in the Common Log Format, with the time taken in microseconds added on the end. There
+// is no identity or user, so those fields are "-", as is the request line of a request that could not be parsed.
+// https://httpd.apache.org/docs/2.4/logs.html#common
+static size_t format_record(access_log_record_t *record, char *line) {
+    char address[INET6_ADDRSTRLEN] = "-";
+    char *time_string = get_time_string(record->timestamp);
+    int length;
+
+    if(record->family == AF_INET || record->family == AF_INET6) {
+        inet_ntop(record->family, record->address, address, sizeof address);
+    }
+
+    if(record->protocol_version != NULL) {
+        length = snprintf(line, ACCESS_LOG_MAX_LINE_LENGTH, "%s - - [%s] \"GET %.*s %s\" %d %lld %ld\n", address,
+                          time_string, (int) record->path_length, record->path, record->protocol_version,
+                          record->status_code, record->bytes_sent,
+                          record->duration / ACCESS_LOG_NANOSECONDS_PER_MICROSECOND);
+    } else {
+        length = snprintf(line, ACCESS_LOG_MAX_LINE_LENGTH, "%s - - [%s] \"-\" %d %lld %ld\n", address, time_string,
+                          record->status_code, record->bytes_sent,
+                          record->duration / ACCESS_LOG_NANOSECONDS_PER_MICROSECOND);
+    }
+    return length < ACCESS_LOG_MAX_LINE_LENGTH ? (size_t) length : ACCESS_LOG_MAX_LINE_LENGTH - 1;
+}
+
+// Returns the time formatted for the log. Records come in more or less in order, so like get_date_line, the last
+// time formatted is kept and only formatted again once the second has changed. Only the flusher calls this.
+static char *get_time_string(time_t timestamp) {
+    static char time_string[ACCESS_LOG_TIME_BUFFER_SIZE];
+    static time_t formatted_timestamp = -1;
+
+    if(timestamp != formatted_timestamp) {
+        struct tm time_gmt;
+        gmtime_r(&timestamp, &time_gmt);
+        strftime(time_string, sizeof time_string, ACCESS_LOG_TIME_FORMAT, &time_gmt);
+        formatted_timestamp = timestamp;
+    }
+    return time_string;
+}
+
+// Writes the whole buffer to the log file.
+static void write_log(char *buffer, size_t length) {
+    size_t written = 0;
+    while(written < length) {
+        ssize_t n = write(log_fd, buffer + written, length - written);
+        if(n < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            perror("write");
+            return;
+        }
+        written += n;
+    }
+}
@@ -0,0 +1,87 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_ACCESS_LOG_H
+#define COMP30023_2022_PROJECT_2_ACCESS_LOG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "respond.h"
+#include "stats.h"
+#include "monotonic.h"
+
+// Records per thread. A full ring drops records instead of making the worker wait for the flusher.
+#define ACCESS_LOG_RING_SIZE 4096
+#define ACCESS_LOG_MAX_PATH_LENGTH 256
+#define ACCESS_LOG_FLUSH_INTERVAL_MS 10
+// Dropped records are reported at most this often.
+#define ACCESS_LOG_DROP_REPORT_INTERVAL 1
+#define ACCESS_LOG_WRITE_BUFFER_SIZE 65536
+// Longest line the flusher writes: the path, the address and the fixed fields.
+#define ACCESS_LOG_MAX_LINE_LENGTH (ACCESS_LOG_MAX_PATH_LENGTH + INET6_ADDRSTRLEN + 128)
+#define ACCESS_LOG_FILE_MODE 0644
+#define ACCESS_LOG_TIME_FORMAT "%d/%b/%Y:%H:%M:%S +0000"
+#define ACCESS_LOG_TIME_BUFFER_SIZE 32
+#define ACCESS_LOG_CACHE_LINE_SIZE 64
+#define NANOSECONDS_PER_MILLISECOND 1000000L
+#define ACCESS_LOG_NANOSECONDS_PER_MICROSECOND 1000
+#define NOT_LOGGING 0
+#define ACCESS_LOG_FINISH_FLUSHES 2
+
+// One finished response, as copied into a ring by a worker. Everything is a plain value so that the record can be
+// formatted long after the connection it came from is gone. protocol_version points at one of the protocol string
+// constants, and is NULL for a request that could not be parsed.
+typedef struct access_log_record access_log_record_t;
+struct access_log_record {
+    time_t timestamp;
+    long duration;
+    long long bytes_sent;
+    int status_code;
+    sa_family_t family;
+    unsigned char address[sizeof(struct in6_addr)];
+    const char *protocol_version;
+    size_t path_length;
+    char path[ACCESS_LOG_MAX_PATH_LENGTH];
+};
+
+// A single producer single consumer ring of records. Only the worker that owns the ring moves the tail and only the
+// flusher moves the head, so each side just publishes its own position with a release store and reads the other's
+// with an acquire load. The two positions are on separate cache lines. When a thread exits, its ring is handed on to
+// the next thread to log something, which becomes the new worker side.
+typedef struct access_log_ring access_log_ring_t;
+struct access_log_ring {
+    access_log_record_t records[ACCESS_LOG_RING_SIZE];
+    _Alignas(ACCESS_LOG_CACHE_LINE_SIZE) atomic_size_t head;
+    _Alignas(ACCESS_LOG_CACHE_LINE_SIZE) atomic_size_t tail;
+    atomic_size_t dropped;
+    access_log_ring_t *next;
+    access_log_ring_t *next_idle;
+};
+
+bool access_log_init(char *access_log_path);
+
+bool access_log_enabled(void);
+
+long access_log_start(void);
+
+void access_log_response(struct sockaddr_storage *client_addr, http_response_t *response, long started_at);
+
+void access_log_finish(void);
+
+void *access_log_flusher(void *access_log_args);
+
+#endif //COMP30023_2022_PROJECT_2_ACCESS_LOG_H
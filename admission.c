@@ -0,0 +1,180 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "admission.h"
+
+static size_t get_client_address(const struct sockaddr_storage *client_addr, const unsigned char **address);
+static uint64_t hash_address(const unsigned char *address, size_t address_length);
+static client_connections_t **find_client(admission_shard_t *shard, uint64_t hash, const unsigned char *address,
+                                          size_t address_length);
+static bool admit_client(const unsigned char *address, size_t address_length);
+static void release_client(const unsigned char *address, size_t address_length);
+
+// Set once at startup, before any connection is accepted.
+static int connection_limit = NO_CONNECTION_LIMIT;
+static int client_connection_limit = NO_CONNECTION_LIMIT;
+static atomic_int open_connections = 0;
+static admission_shard_t *shards = NULL;
+
+// Sets the most connections the server keeps open at once, and the most any one client address can have open. The
+// table of client addresses is only set up if there is a limit per client. Returns false if it could not be.
+bool admission_init(int max_connections, int max_connections_per_client) {
+    connection_limit = max_connections;
+    client_connection_limit = max_connections_per_client;
+    if(client_connection_limit == NO_CONNECTION_LIMIT) {
+        return true;
+    }
+
+    shards = (admission_shard_t *) calloc (ADMISSION_NUM_SHARDS, sizeof(admission_shard_t));
+    if(shards == NULL) {
+        perror("calloc");
+        return false;
+    }
+    for(int i = 0; i < ADMISSION_NUM_SHARDS; i++) {
+        pthread_mutex_init(&shards[i].lock, NULL);
+        // The shard's lock is held whenever the slab is used, so the slab does not need one of its own.
+        slab_init(&shards[i].entries, sizeof(client_connections_t), false);
+    }
+    return true;
+}
+
+// Whether connections are counted by client address, in which case every mode needs to know the address of each
+// connection it accepts.
+bool admission_limits_clients(void) {
+    return client_connection_limit != NO_CONNECTION_LIMIT;
+}
+
+// Counts a connection that has just been accepted against the limits. Returns false if it would go over either of
+// them, in which case nothing is counted and the connection should be turned away with reject_connection. Every
+// connection that is admitted has to be released with admission_release once it is closed. Connections whose address
+// is not known only count towards the overall limit.
+bool admission_admit(const struct sockaddr_storage *client_addr) {
+    // Counted even without a limit, so that a server handing over to a new process can tell when it has finished.
+    if(atomic_fetch_add_explicit(&open_connections, 1, memory_order_relaxed) >= connection_limit &&
+            connection_limit != NO_CONNECTION_LIMIT) {
+        atomic_fetch_sub_explicit(&open_connections, 1, memory_order_relaxed);
+        stats_count(STATS_CONNECTIONS_REJECTED, 1);
+        return false;
+    }
+
+    const unsigned char *address;
+    size_t address_length;
+    if(client_connection_limit != NO_CONNECTION_LIMIT &&
+            (address_length = get_client_address(client_addr, &address)) > 0 &&
+            !admit_client(address, address_length)) {
+        atomic_fetch_sub_explicit(&open_connections, 1, memory_order_relaxed);
+        stats_count(STATS_CONNECTIONS_REJECTED, 1);
+        return false;
+    }
+    return true;
+}
+
+// Takes a closed connection back off the counts it was admitted to.
+void admission_release(const struct sockaddr_storage *client_addr) {
+    atomic_fetch_sub_explicit(&open_connections, 1, memory_order_relaxed);
+    const unsigned char *address;
+    size_t address_length;
+    if(client_connection_limit != NO_CONNECTION_LIMIT &&
+            (address_length = get_client_address(client_addr, &address)) > 0) {
+        release_client(address, address_length);
+    }
+}
+
+// How many admitted connections have not been released yet.
+int admission_open_connections(void) {
+    return atomic_load_explicit(&open_connections, memory_order_relaxed);
+}
+
+// Tells the client that the server is too busy and closes the connection. The request is never read, so the
+// response is sent straight away and it does not matter whether the write succeeds. The socket has only just been
+// accepted, so the few bytes of the response always fit in its send buffer and the write never blocks.
+void reject_connection(int sockfd) {
+    stats_count(STATS_RESPONSES_5XX, 1);
+    write_message(sockfd, SERVICE_UNAVAILABLE_RESPONSE);
+    close(sockfd);
+}
+
+// Points address at the bytes of the client's IP address, and returns how many there are, or 0 if the address is not
+// an IP address (such as when it could not be found out). IPv4 clients count as the same client whether they come
+// in over IPv4 or as IPv4-mapped IPv6 addresses.
+static size_t get_client_address(const struct sockaddr_storage *client_addr, const unsigned char **address) {
+    if(client_addr->ss_family == AF_INET) {
+        *address = (const unsigned char *) &((const struct sockaddr_in *) client_addr)->sin_addr;
+        return IPV4_ADDRESS_LENGTH;
+    }
+    if(client_addr->ss_family == AF_INET6) {
+        const struct in6_addr *ipv6_address = &((const struct sockaddr_in6 *) client_addr)->sin6_addr;
+        if(IN6_IS_ADDR_V4MAPPED(ipv6_address)) {
+            *address = ipv6_address->s6_addr + IPV4_MAPPED_ADDRESS_OFFSET;
+            return IPV4_ADDRESS_LENGTH;
+        }
+        *address = ipv6_address->s6_addr;
+        return IPV6_ADDRESS_LENGTH;
+    }
+    return 0;
+}
+
+// The 64-bit FNV-1a hash of the address, like hash_request_path. The low bits pick the shard and the bits above them
+// the bucket. http://www.isthe.com/chongo/tech/comp/fnv/index.html
+static uint64_t hash_address(const unsigned char *address, size_t address_length) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for(size_t i = 0; i < address_length; i++) {
+        hash ^= address[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// Returns the link in the shard that points at the client's entry, which points at NULL if the client has no
+// connections open. The shard must be locked.
+static client_connections_t **find_client(admission_shard_t *shard, uint64_t hash, const unsigned char *address,
+                                          size_t address_length) {
+    client_connections_t **link = &shard->buckets[(hash / ADMISSION_NUM_SHARDS) % ADMISSION_BUCKETS_PER_SHARD];
+    while(*link != NULL && ((*link)->address_length != address_length ||
+                            memcmp((*link)->address, address, address_length) != 0)) {
+        link = &(*link)->next_in_bucket;
+    }
+    return link;
+}
+
+// Counts one more connection for the client, unless it already has as many open as it is allowed.
+static bool admit_client(const unsigned char *address, size_t address_length) {
+    uint64_t hash = hash_address(address, address_length);
+    admission_shard_t *shard = &shards[hash % ADMISSION_NUM_SHARDS];
+    bool admitted = true;
+
+    pthread_mutex_lock(&shard->lock);
+    client_connections_t **link = find_client(shard, hash, address, address_length);
+    if(*link == NULL) {
+        client_connections_t *client = (client_connections_t *) slab_alloc(&shard->entries);
+        if(client != NULL) {
+            memcpy(client->address, address, address_length);
+            client->address_length = address_length;
+            client->count = 1;
+            client->next_in_bucket = NULL;
+            *link = client;
+        }
+    } else if((*link)->count >= client_connection_limit) {
+        admitted = false;
+    } else {
+        (*link)->count++;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return admitted;
+}
+
+// Counts one less connection for the client, and forgets about it once it has none left. A client which was let in
+// without an entry (because there was no memory for one) has nothing to take off.
+static void release_client(const unsigned char *address, size_t address_length) {
+    uint64_t hash = hash_address(address, address_length);
+    admission_shard_t *shard = &shards[hash % ADMISSION_NUM_SHARDS];
+
+    pthread_mutex_lock(&shard->lock);
+    client_connections_t **link = find_client(shard, hash, address, address_length);
+    client_connections_t *client = *link;
+    if(client != NULL && --client->count == 0) {
+        *link = client->next_in_bucket;
+        slab_free(&shard->entries, client);
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
@@ -0,0 +1,64 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_ADMISSION_H
+#define COMP30023_2022_PROJECT_2_ADMISSION_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "respond.h"
+#include "slab.h"
+
+// A limit of 0 means no limit.
+#define NO_CONNECTION_LIMIT 0
+// Clients are spread over the shards by the hash of their address so that workers accepting connections from
+// different clients rarely wait on the same lock.
+#define ADMISSION_NUM_SHARDS 64
+#define ADMISSION_BUCKETS_PER_SHARD 256
+#define CLIENT_ADDRESS_MAX_LENGTH 16
+#define IPV4_ADDRESS_LENGTH 4
+#define IPV6_ADDRESS_LENGTH 16
+// IPv4 clients of an IPv6 socket show up as ::ffff:a.b.c.d, which is the IPv4 address in the last four bytes.
+// https://datatracker.ietf.org/doc/html/rfc4291#section-2.5.5.2
+#define IPV4_MAPPED_ADDRESS_OFFSET 12
+
+// How many connections one client address has open. Entries only exist while the count is above 0.
+typedef struct client_connections client_connections_t;
+struct client_connections {
+    unsigned char address[CLIENT_ADDRESS_MAX_LENGTH];
+    size_t address_length;
+    int count;
+    client_connections_t *next_in_bucket;
+};
+
+// A part of the table of client addresses, with its own lock and its own slab of entries.
+typedef struct admission_shard admission_shard_t;
+struct admission_shard {
+    pthread_mutex_t lock;
+    client_connections_t *buckets[ADMISSION_BUCKETS_PER_SHARD];
+    slab_t entries;
+};
+
+bool admission_init(int max_connections, int max_connections_per_client);
+
+bool admission_limits_clients(void);
+
+bool admission_admit(const struct sockaddr_storage *client_addr);
+
+void admission_release(const struct sockaddr_storage *client_addr);
+
+int admission_open_connections(void);
+
+void reject_connection(int sockfd);
+
+#endif //COMP30023_2022_PROJECT_2_ADMISSION_H
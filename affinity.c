@@ -0,0 +1,86 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "affinity.h"
+
+// Set once at startup, before anything is pinned.
+static cpu_set_t allowed_cpus;
+
+// Records the CPUs the server is allowed to run on (which may not be all of them, or numbered from 0), which the
+// workers are spread over. Has to be called before any thread is pinned, since the main thread moves itself between
+// the workers' CPUs while setting them up. Returns false if they could not be looked up.
+// https://man7.org/linux/man-pages/man2/sched_getaffinity.2.html
+bool affinity_init(void) {
+    if(sched_getaffinity(0, sizeof(cpu_set_t), &allowed_cpus) < 0) {
+        perror("sched_getaffinity");
+        return false;
+    }
+    return true;
+}
+
+// Returns the CPU a worker is pinned to, going round the allowed CPUs one worker at a time.
+int worker_cpu(int worker_index) {
+    int cpu_index = worker_index % CPU_COUNT(&allowed_cpus);
+    for(int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if(CPU_ISSET(cpu, &allowed_cpus) && cpu_index-- == 0) {
+            return cpu;
+        }
+    }
+    return NO_CPU;
+}
+
+// Sets up the attributes of a worker thread so that it only ever runs on its CPU. Setting this before the thread is
+// created means it never starts off anywhere else.
+// https://man7.org/linux/man-pages/man3/pthread_attr_setaffinity_np.3.html
+// Returns false if the affinity could not be set.
+bool set_worker_cpu(pthread_attr_t *attributes, int worker_index) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(worker_cpu(worker_index), &cpus);
+    if(pthread_attr_setaffinity_np(attributes, sizeof(cpu_set_t), &cpus) != 0) {
+        fprintf(stderr, "pthread_attr_setaffinity_np: failed to pin worker %d\n", worker_index);
+        return false;
+    }
+    return true;
+}
+
+// Moves the calling thread onto a worker's CPU, so that whatever it sets up for the worker ends up on the worker's
+// NUMA node. The kernel allocates the memory of an epoll instance or an io_uring's rings on the node of the CPU that
+// creates them, and by default a page of ordinary memory goes on the node of the CPU which first touches it
+// (https://man7.org/linux/man-pages/man2/set_mempolicy.2.html), so this needs no NUMA library. The worker's
+// connections and buffers are allocated from its slabs by the worker itself, so they are local to it already.
+// sched_setaffinity moves the thread before returning. Returns false if it could not be moved.
+bool move_to_worker_cpu(int worker_index) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(worker_cpu(worker_index), &cpus);
+    if(sched_setaffinity(0, sizeof(cpu_set_t), &cpus) < 0) {
+        perror("sched_setaffinity");
+        return false;
+    }
+    return true;
+}
+
+// Lets the calling thread run on any of the allowed CPUs again, after setting up the workers.
+bool restore_cpus(void) {
+    if(sched_setaffinity(0, sizeof(cpu_set_t), &allowed_cpus) < 0) {
+        perror("sched_setaffinity");
+        return false;
+    }
+    return true;
+}
+
+// Tells the kernel to hand connections which arrive on a worker's CPU to that worker's listening socket, out of all
+// of the SO_REUSEPORT sockets sharing the port, so that a connection is served on the CPU which already has its
+// packets (and their socket) in cache. Kernels from 6.1 choose the socket this way when any socket in the group has
+// SO_INCOMING_CPU set, and go back to hashing when no socket matches; older ones ignore it.
+// https://man7.org/linux/man-pages/man7/socket.7.html
+// Returns false if the option could not be set.
+bool steer_to_worker_cpu(int listen_sockfd, int worker_index) {
+    int cpu = worker_cpu(worker_index);
+    if(setsockopt(listen_sockfd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof cpu) < 0) {
+        perror("setsockopt");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,34 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_AFFINITY_H
+#define COMP30023_2022_PROJECT_2_AFFINITY_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdbool.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#define NO_CPU -1
+// Per-worker state that is written on every request is kept on cache lines of its own, so that workers on different
+// CPUs never write to the same line.
+#define WORKER_CACHE_LINE_SIZE 64
+
+bool affinity_init(void);
+
+int worker_cpu(int worker_index);
+
+bool set_worker_cpu(pthread_attr_t *attributes, int worker_index);
+
+bool move_to_worker_cpu(int worker_index);
+
+bool restore_cpus(void);
+
+bool steer_to_worker_cpu(int listen_sockfd, int worker_index);
+
+#endif //COMP30023_2022_PROJECT_2_AFFINITY_H
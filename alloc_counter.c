@@ -0,0 +1,89 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "alloc_counter.h"
+
+static void map_counter_file(void) __attribute__((constructor));
+static void count(_Atomic uint64_t *counter);
+
+// Counts go here until the counter file has been mapped, which also covers running without one.
+static alloc_counts_t startup_counts;
+static alloc_counts_t *counts = &startup_counts;
+
+// An allocation counter to be loaded into the server with LD_PRELOAD, used by make check-allocs to check that the
+// server stops allocating once it has warmed up. Every allocator call is counted and passed on to glibc. The counts
+// are kept in the file named by ALLOC_COUNTER_FILE, which is mapped shared so that they can be read from outside
+// while the server is running. https://man7.org/linux/man-pages/man8/ld.so.8.html
+static void map_counter_file(void) {
+    char *counter_path = getenv(ALLOC_COUNTER_FILE_ENV);
+    if(counter_path == NULL) {
+        return;
+    }
+    int counter_fd = open(counter_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, ALLOC_COUNTER_FILE_MODE);
+    if(counter_fd < 0) {
+        perror("open");
+        return;
+    }
+    alloc_counts_t *mapped_counts = MAP_FAILED;
+    if(ftruncate(counter_fd, sizeof(alloc_counts_t)) == 0) {
+        mapped_counts = (alloc_counts_t *) mmap(NULL, sizeof(alloc_counts_t), PROT_READ | PROT_WRITE, MAP_SHARED,
+                                                counter_fd, 0);
+    }
+    if(mapped_counts == MAP_FAILED) {
+        perror("mmap");
+        close(counter_fd);
+        return;
+    }
+    close(counter_fd);
+    atomic_store(&mapped_counts->allocations, atomic_load(&startup_counts.allocations));
+    atomic_store(&mapped_counts->frees, atomic_load(&startup_counts.frees));
+    counts = mapped_counts;
+}
+
+void *malloc(size_t size) {
+    count(&counts->allocations);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t num_members, size_t size) {
+    count(&counts->allocations);
+    return __libc_calloc(num_members, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+    count(&counts->allocations);
+    return __libc_realloc(pointer, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    count(&counts->allocations);
+    return __libc_memalign(alignment, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    count(&counts->allocations);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **pointer, size_t alignment, size_t size) {
+    count(&counts->allocations);
+    void *memory = __libc_memalign(alignment, size);
+    if(memory == NULL) {
+        return ENOMEM;
+    }
+    *pointer = memory;
+    return 0;
+}
+
+void free(void *pointer) {
+    if(pointer == NULL) {
+        return;
+    }
+    count(&counts->frees);
+    __libc_free(pointer);
+}
+
+// The counters are shared by every thread, so unlike the server's own stats they need an atomic add.
+static void count(_Atomic uint64_t *counter) {
+    atomic_fetch_add_explicit(counter, 1, memory_order_relaxed);
+}
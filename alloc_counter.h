@@ -0,0 +1,53 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_ALLOC_COUNTER_H
+#define COMP30023_2022_PROJECT_2_ALLOC_COUNTER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#define ALLOC_COUNTER_FILE_ENV "ALLOC_COUNTER_FILE"
+#define ALLOC_COUNTER_FILE_MODE 0644
+
+// What the counter file holds: how many times memory has been allocated (by malloc, calloc, realloc, aligned_alloc,
+// memalign or posix_memalign) and how many times it has been freed since the program started, as two native 64 bit
+// integers, e.g. for od -A n -t u8.
+typedef struct alloc_counts alloc_counts_t;
+struct alloc_counts {
+    _Atomic uint64_t allocations;
+    _Atomic uint64_t frees;
+};
+
+// The allocator functions glibc exports under these names as well, which lets the counter pass calls on without
+// looking the real functions up with dlsym (which allocates).
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t num_members, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *pointer);
+
+void *malloc(size_t size);
+
+void *calloc(size_t num_members, size_t size);
+
+void *realloc(void *pointer, size_t size);
+
+void *aligned_alloc(size_t alignment, size_t size);
+
+void *memalign(size_t alignment, size_t size);
+
+int posix_memalign(void **pointer, size_t alignment, size_t size);
+
+void free(void *pointer);
+
+#endif //COMP30023_2022_PROJECT_2_ALLOC_COUNTER_H
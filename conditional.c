@@ -0,0 +1,123 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "conditional.h"
+
+static bool entity_tag_list_matches(string_view_t list, char *entity_tag);
+static string_view_t strip_weak_prefix(string_view_t entity_tag);
+static time_t parse_http_date(string_view_t value);
+
+// Formats the entity tag of a file into entity_tag, which must hold ENTITY_TAG_BUFFER_SIZE characters. It is made
+// from the inode number, the size and the modification time to the nanosecond, which all come from the fstat the
+// server does anyway, so nothing has to be read or hashed. Any change to the file (or replacing it with another one)
+// changes the tag, so it is used as a strong validator. https://datatracker.ietf.org/doc/html/rfc9110#section-8.8.3
+void format_entity_tag(char *entity_tag, struct stat *file_stat) {
+    unsigned long long modified = (unsigned long long) file_stat->st_mtim.tv_sec * NANOSECONDS_PER_SECOND_ULL +
+                                  (unsigned long long) file_stat->st_mtim.tv_nsec;
+    snprintf(entity_tag, ENTITY_TAG_BUFFER_SIZE, ENTITY_TAG_FORMAT, (unsigned long long) file_stat->st_ino,
+             (unsigned long long) file_stat->st_size, modified);
+}
+
+// Formats the ETag and Last-Modified header lines for a file into buffer, which must hold
+// VALIDATOR_HEADERS_BUFFER_SIZE characters. https://datatracker.ietf.org/doc/html/rfc9110#section-8.8.2
+void format_validator_headers(char *buffer, struct stat *file_stat) {
+    char entity_tag[ENTITY_TAG_BUFFER_SIZE];
+    char last_modified[HTTP_DATE_BUFFER_SIZE];
+    struct tm modified_gmt;
+
+    format_entity_tag(entity_tag, file_stat);
+    gmtime_r(&file_stat->st_mtime, &modified_gmt);
+    strftime(last_modified, HTTP_DATE_BUFFER_SIZE, IMF_FIXDATE_FORMAT, &modified_gmt);
+    snprintf(buffer, VALIDATOR_HEADERS_BUFFER_SIZE, VALIDATOR_HEADERS_FORMAT, entity_tag, last_modified);
+}
+
+// Returns true if a GET for the file can be answered with a 304 Not Modified, because the client already has the
+// version of the file it is about to be sent. If-None-Match is checked first, using the weak comparison, and
+// If-Modified-Since only counts when there is no If-None-Match. A date which cannot be parsed is ignored.
+// https://datatracker.ietf.org/doc/html/rfc9110#section-13.2.2
+bool request_not_modified(http_request_t *request, struct stat *file_stat) {
+    string_view_t *if_none_match = find_header(request, IF_NONE_MATCH_HEADER);
+    if(if_none_match != NULL) {
+        char entity_tag[ENTITY_TAG_BUFFER_SIZE];
+        format_entity_tag(entity_tag, file_stat);
+        return entity_tag_list_matches(*if_none_match, entity_tag);
+    }
+
+    string_view_t *if_modified_since = find_header(request, IF_MODIFIED_SINCE_HEADER);
+    if(if_modified_since != NULL) {
+        time_t since = parse_http_date(*if_modified_since);
+        return since != NOT_A_DATE && file_stat->st_mtime <= since;
+    }
+    return false;
+}
+
+// Returns true unless the request has an If-Range header which says the ranges it asks for are of a different
+// version of the file, in which case the whole file has to be sent instead. If-Range holds either an entity tag,
+// which has to match with the strong comparison (so weak tags never do), or the date the file was last modified.
+// https://datatracker.ietf.org/doc/html/rfc9110#section-13.1.5
+bool range_condition_holds(http_request_t *request, struct stat *file_stat) {
+    string_view_t *if_range = find_header(request, IF_RANGE_HEADER);
+    if(if_range == NULL) {
+        return true;
+    }
+    if(if_range->length > 0 && (if_range->data[0] == '"' || if_range->data[0] == 'W')) {
+        char entity_tag[ENTITY_TAG_BUFFER_SIZE];
+        format_entity_tag(entity_tag, file_stat);
+        return string_view_equals(*if_range, entity_tag);
+    }
+    return parse_http_date(*if_range) == file_stat->st_mtime;
+}
+
+// Returns true if the comma separated list of entity tags in an If-None-Match header has one which matches
+// entity_tag when weakness is ignored, or is just "*".
+static bool entity_tag_list_matches(string_view_t list, char *entity_tag) {
+    const char *position = list.data;
+    const char *end = list.data + list.length;
+
+    while(position < end) {
+        while(position < end && (*position == ' ' || *position == '\t' || *position == ',')) {
+            position++;
+        }
+        const char *tag_end = position;
+        while(tag_end < end && *tag_end != ',' && *tag_end != ' ' && *tag_end != '\t') {
+            tag_end++;
+        }
+        string_view_t tag = {position, tag_end - position};
+        if(tag.length > 0 && (string_view_equals(tag, ANY_ENTITY_TAG) ||
+                              string_view_equals(strip_weak_prefix(tag), entity_tag))) {
+            return true;
+        }
+        position = tag_end;
+    }
+    return false;
+}
+
+// Returns the entity tag without the W/ that marks a weak one.
+static string_view_t strip_weak_prefix(string_view_t entity_tag) {
+    size_t prefix_length = strlen(WEAK_ENTITY_TAG_PREFIX);
+    if(entity_tag.length >= prefix_length && memcmp(entity_tag.data, WEAK_ENTITY_TAG_PREFIX, prefix_length) ==
+            SAME_STRING) {
+        entity_tag.data += prefix_length;
+        entity_tag.length -= prefix_length;
+    }
+    return entity_tag;
+}
+
+// Parses an HTTP date in the IMF-fixdate format, returning NOT_A_DATE if it is not one. The view is copied out so
+// strptime has a null terminated string to work on. https://man7.org/linux/man-pages/man3/strptime.3.html
+static time_t parse_http_date(string_view_t value) {
+    char date[HTTP_DATE_BUFFER_SIZE];
+    struct tm date_gmt;
+
+    if(value.length >= HTTP_DATE_BUFFER_SIZE) {
+        return NOT_A_DATE;
+    }
+    memcpy(date, value.data, value.length);
+    date[value.length] = '\0';
+    memset(&date_gmt, 0, sizeof date_gmt);
+    char *date_end = strptime(date, IMF_FIXDATE_FORMAT, &date_gmt);
+    if(date_end == NULL || *date_end != '\0') {
+        return NOT_A_DATE;
+    }
+    return timegm(&date_gmt);
+}
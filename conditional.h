@@ -0,0 +1,46 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_CONDITIONAL_H
+#define COMP30023_2022_PROJECT_2_CONDITIONAL_H
+
+// strptime() and timegm() are not part of standard C. https://man7.org/linux/man-pages/man3/strptime.3.html
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "parse.h"
+
+#define IF_NONE_MATCH_HEADER "If-None-Match"
+#define IF_MODIFIED_SINCE_HEADER "If-Modified-Since"
+#define IF_RANGE_HEADER "If-Range"
+#define ANY_ENTITY_TAG "*"
+#define WEAK_ENTITY_TAG_PREFIX "W/"
+#define ENTITY_TAG_FORMAT "\"%llx-%llx-%llx\""
+#define ENTITY_TAG_BUFFER_SIZE 64
+// The only date format servers send, and the one every client has sent for decades.
+// https://datatracker.ietf.org/doc/html/rfc9110#section-5.6.7
+#define IMF_FIXDATE_FORMAT "%a, %d %b %Y %H:%M:%S GMT"
+#define HTTP_DATE_BUFFER_SIZE 32
+// ETag and Last-Modified header lines, with the validators of a file.
+#define VALIDATOR_HEADERS_FORMAT "ETag: %s\r\nLast-Modified: %s\r\n"
+#define VALIDATOR_HEADERS_BUFFER_SIZE (ENTITY_TAG_BUFFER_SIZE + HTTP_DATE_BUFFER_SIZE + 32)
+#define NOT_A_DATE ((time_t) -1)
+#define NANOSECONDS_PER_SECOND_ULL 1000000000ULL
+
+void format_entity_tag(char *entity_tag, struct stat *file_stat);
+
+void format_validator_headers(char *buffer, struct stat *file_stat);
+
+bool request_not_modified(http_request_t *request, struct stat *file_stat);
+
+bool range_condition_holds(http_request_t *request, struct stat *file_stat);
+
+#endif //COMP30023_2022_PROJECT_2_CONDITIONAL_H
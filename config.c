@@ -0,0 +1,319 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "config.h"
+
+// Long forms of every option. https://man7.org/linux/man-pages/man3/getopt_long.3.html
+static const struct option long_options[] = {
+    {"mode", required_argument, NULL, 'm'},
+    {"workers", required_argument, NULL, 'w'},
+    {"pin-workers", no_argument, NULL, PIN_WORKERS_OPTION},
+    {"incoming-cpu", no_argument, NULL, INCOMING_CPU_OPTION},
+    {"backlog", required_argument, NULL, 'b'},
+    {"queue-depth", required_argument, NULL, 'q'},
+    {"overload", required_argument, NULL, 'o'},
+    {"keep-alive-timeout", required_argument, NULL, 'k'},
+    {"header-timeout", required_argument, NULL, HEADER_TIMEOUT_OPTION},
+    {"send-timeout", required_argument, NULL, SEND_TIMEOUT_OPTION},
+    {"max-connections", required_argument, NULL, MAX_CONNECTIONS_OPTION},
+    {"max-connections-per-client", required_argument, NULL, MAX_CONNECTIONS_PER_CLIENT_OPTION},
+    {"file-cache-size", required_argument, NULL, FILE_CACHE_SIZE_OPTION},
+    {"file-cache-revalidate", required_argument, NULL, FILE_CACHE_REVALIDATE_OPTION},
+    {"response-cache-size", required_argument, NULL, RESPONSE_CACHE_SIZE_OPTION},
+    {"response-cache-max-entry", required_argument, NULL, RESPONSE_CACHE_MAX_ENTRY_OPTION},
+    {"mmap-max-size", required_argument, NULL, MMAP_MAX_SIZE_OPTION},
+    {"stats", no_argument, NULL, STATS_OPTION},
+    {"precompressed", no_argument, NULL, PRECOMPRESSED_OPTION},
+    {"index-web-root", no_argument, NULL, INDEX_WEB_ROOT_OPTION},
+    {"access-log", required_argument, NULL, 'l'},
+    {"drain-timeout", required_argument, NULL, DRAIN_TIMEOUT_OPTION},
+    {NULL, 0, NULL, 0}
+};
+
+// Takes the command line arguments and fills in the server_config struct passed in. The original three positional
+// arguments (protocol number, port number and web root path) are still required and keep their meaning. Any
+// additional options are parsed with getopt_long, which permutes argv so that options may be given either before or
+// after the positional arguments (https://man7.org/linux/man-pages/man3/getopt.3.html). Returns true if the
+// arguments make sense; false otherwise.
+bool parse_server_config(int argc, char **argv, server_config_t *config) {
+    int option;
+
+    config->serving_mode = SERVING_MODE_THREAD;
+    config->num_workers = DEFAULT_NUM_WORKERS;
+    config->pin_workers = false;
+    config->incoming_cpu = false;
+    config->listen_backlog = DEFAULT_LISTEN_BACKLOG;
+    config->queue_depth = DEFAULT_QUEUE_DEPTH;
+    config->overload_behaviour = OVERLOAD_STOP_ACCEPTING;
+    config->keep_alive_timeout = DEFAULT_KEEP_ALIVE_TIMEOUT;
+    config->header_timeout = DEFAULT_HEADER_TIMEOUT;
+    config->send_timeout = DEFAULT_SEND_TIMEOUT;
+    config->max_connections = DEFAULT_MAX_CONNECTIONS;
+    config->max_connections_per_client = DEFAULT_MAX_CONNECTIONS_PER_CLIENT;
+    config->file_cache_size = DEFAULT_FILE_CACHE_SIZE;
+    config->file_cache_revalidate_interval = DEFAULT_FILE_CACHE_REVALIDATE_INTERVAL;
+    config->mmap_max_size = DEFAULT_MMAP_MAX_SIZE;
+    config->file_cache = NULL;
+    config->response_cache_size = DEFAULT_RESPONSE_CACHE_SIZE;
+    config->response_cache_max_entry_size = DEFAULT_RESPONSE_CACHE_MAX_ENTRY_SIZE;
+    config->response_cache = NULL;
+    config->stats = false;
+    config->precompressed = false;
+    config->index_web_root = false;
+    config->access_log_path = NULL;
+    config->drain_timeout = DEFAULT_DRAIN_TIMEOUT;
+
+    while((option = getopt_long(argc, argv, "m:w:b:q:o:k:l:", long_options, NULL)) != -1) {
+        switch(option) {
+            // Serving mode, either the original thread per connection model, the epoll event loop (with a shared
+            // listening socket or one per worker) or the thread pool.
+            case 'm':
+                if(strcmp(optarg, THREAD_MODE_ARG) == SAME_STRING) {
+                    config->serving_mode = SERVING_MODE_THREAD;
+                } else if(strcmp(optarg, EPOLL_MODE_ARG) == SAME_STRING) {
+                    config->serving_mode = SERVING_MODE_EPOLL;
+                } else if(strcmp(optarg, POOL_MODE_ARG) == SAME_STRING) {
+                    config->serving_mode = SERVING_MODE_POOL;
+                } else if(strcmp(optarg, REUSEPORT_MODE_ARG) == SAME_STRING) {
+                    config->serving_mode = SERVING_MODE_REUSEPORT;
+                } else if(strcmp(optarg, URING_MODE_ARG) == SAME_STRING) {
+                    config->serving_mode = SERVING_MODE_URING;
+                } else {
+                    fprintf(stderr, "ERROR, unknown serving mode %s.\n", optarg);
+                    return false;
+                }
+                break;
+            // Number of worker threads for the modes which use a fixed number of workers.
+            case 'w':
+                config->num_workers = atoi(optarg);
+                if(config->num_workers < 0) {
+                    fprintf(stderr, "ERROR, number of workers cannot be negative.\n");
+                    return false;
+                }
+                break;
+            // Pin each worker of the modes with a fixed number of workers to its own CPU.
+            case PIN_WORKERS_OPTION:
+                config->pin_workers = true;
+                break;
+            // In reuseport mode, have the kernel give each connection to the worker pinned to the CPU it arrived on.
+            // Only makes sense with pinned workers, so it pins them too.
+            case INCOMING_CPU_OPTION:
+                config->incoming_cpu = true;
+                config->pin_workers = true;
+                break;
+            // Number of connections the kernel queues up on a listening socket before they are accepted. The kernel
+            // caps this at net.core.somaxconn. https://man7.org/linux/man-pages/man2/listen.2.html
+            case 'b':
+                config->listen_backlog = atoi(optarg);
+                if(config->listen_backlog <= 0) {
+                    fprintf(stderr, "ERROR, backlog must be positive.\n");
+                    return false;
+                }
+                break;
+            // Number of accepted connections the thread pool can hold before it is considered overloaded.
+            case 'q':
+                config->queue_depth = atoi(optarg);
+                if(config->queue_depth <= 0) {
+                    fprintf(stderr, "ERROR, queue depth must be positive.\n");
+                    return false;
+                }
+                break;
+            // What to do with new connections once the thread pool is overloaded.
+            case 'o':
+                if(strcmp(optarg, REJECT_OVERLOAD_ARG) == SAME_STRING) {
+                    config->overload_behaviour = OVERLOAD_REJECT;
+                } else if(strcmp(optarg, STOP_ACCEPTING_OVERLOAD_ARG) == SAME_STRING) {
+                    config->overload_behaviour = OVERLOAD_STOP_ACCEPTING;
+                } else {
+                    fprintf(stderr, "ERROR, unknown overload behaviour %s.\n", optarg);
+                    return false;
+                }
+                break;
+            // Number of seconds an idle persistent connection is kept open while waiting for its next request.
+            case 'k':
+                config->keep_alive_timeout = atoi(optarg);
+                if(config->keep_alive_timeout <= 0) {
+                    fprintf(stderr, "ERROR, keep-alive timeout must be positive.\n");
+                    return false;
+                }
+                break;
+            // Number of seconds a client has to send the whole of a request's headers, counted from when the
+            // connection is accepted or, on a persistent connection, from the first bytes of the request. This is
+            // what stops a client from holding a connection open by sending its request a byte at a time.
+            case HEADER_TIMEOUT_OPTION:
+                config->header_timeout = atoi(optarg);
+                if(config->header_timeout <= 0) {
+                    fprintf(stderr, "ERROR, header timeout must be positive.\n");
+                    return false;
+                }
+                break;
+            // Number of seconds a response can go without the client taking any more of it before the connection is
+            // dropped.
+            case SEND_TIMEOUT_OPTION:
+                config->send_timeout = atoi(optarg);
+                if(config->send_timeout <= 0) {
+                    fprintf(stderr, "ERROR, send timeout must be positive.\n");
+                    return false;
+                }
+                break;
+            // Most connections open at once, beyond which new ones get a 503 straight away. 0 means no limit.
+            case MAX_CONNECTIONS_OPTION:
+                config->max_connections = atoi(optarg);
+                if(config->max_connections < 0) {
+                    fprintf(stderr, "ERROR, maximum connections cannot be negative.\n");
+                    return false;
+                }
+                break;
+            // Most connections one client IP address can have open at once. 0 means no limit.
+            case MAX_CONNECTIONS_PER_CLIENT_OPTION:
+                config->max_connections_per_client = atoi(optarg);
+                if(config->max_connections_per_client < 0) {
+                    fprintf(stderr, "ERROR, maximum connections per client cannot be negative.\n");
+                    return false;
+                }
+                break;
+            // Maximum number of open files kept in the file cache, 0 turns the cache off.
+            case FILE_CACHE_SIZE_OPTION:
+                config->file_cache_size = atoi(optarg);
+                if(config->file_cache_size < 0) {
+                    fprintf(stderr, "ERROR, file cache size cannot be negative.\n");
+                    return false;
+                }
+                break;
+            // Number of seconds a file cache entry is trusted before it is checked against the file on disk again.
+            case FILE_CACHE_REVALIDATE_OPTION:
+                config->file_cache_revalidate_interval = atoi(optarg);
+                if(config->file_cache_revalidate_interval < 0) {
+                    fprintf(stderr, "ERROR, file cache revalidate interval cannot be negative.\n");
+                    return false;
+                }
+                break;
+            // Largest file in bytes which the file cache maps into memory to send from there instead of with
+            // sendfile, 0 (the default) turns mapping off.
+            case MMAP_MAX_SIZE_OPTION:
+                config->mmap_max_size = atol(optarg);
+                if(config->mmap_max_size < 0) {
+                    fprintf(stderr, "ERROR, mmap max size cannot be negative.\n");
+                    return false;
+                }
+                break;
+            // Memory budget in bytes for rendered responses of small files, 0 (the default) turns the cache off.
+            case RESPONSE_CACHE_SIZE_OPTION:
+                config->response_cache_size = atol(optarg);
+                if(config->response_cache_size < 0) {
+                    fprintf(stderr, "ERROR, response cache size cannot be negative.\n");
+                    return false;
+                }
+                break;
+            // Largest file in bytes whose response is kept in the response cache.
+            case RESPONSE_CACHE_MAX_ENTRY_OPTION:
+                config->response_cache_max_entry_size = atol(optarg);
+                if(config->response_cache_max_entry_size < 0) {
+                    fprintf(stderr, "ERROR, response cache entry size cannot be negative.\n");
+                    return false;
+                }
+                break;
+            // Collect counters and latency histograms and serve them at /__stats and /__stats.json.
+            case STATS_OPTION:
+                config->stats = true;
+                break;
+            // Send the .br or .gz copy of a text file that sits next to it to clients which accept that encoding.
+            case PRECOMPRESSED_OPTION:
+                config->precompressed = true;
+                break;
+            // Index the files in the web root at startup and answer requests for anything else with a 404 without
+            // looking on disk.
+            case INDEX_WEB_ROOT_OPTION:
+                config->index_web_root = true;
+                break;
+            // File to append a line to for every response, written in the background by the access log's flusher.
+            case 'l':
+                config->access_log_path = optarg;
+                break;
+            // Start a new server with the same arguments on SIGUSR2 and hand it the listening sockets, then give the
+            // connections this server still has this many seconds to finish before exiting. 0 (the default) turns
+            // upgrades off.
+            case DRAIN_TIMEOUT_OPTION:
+                config->drain_timeout = atoi(optarg);
+                if(config->drain_timeout < 0) {
+                    fprintf(stderr, "ERROR, drain timeout cannot be negative.\n");
+                    return false;
+                }
+                break;
+            default:
+                return false;
+        }
+    }
+
+    // getopt leaves optind at the first positional argument once it's done.
+    if(argc - optind < NUM_POSITIONAL_ARGS) {
+        fprintf(stderr, "ERROR, not enough arguments provided.\n");
+        return false;
+    }
+
+    config->ip_version = argv[optind];
+    config->port_number = argv[optind + 1];
+    config->web_root_path = argv[optind + 2];
+
+    // Only files in the file cache are ever mapped.
+    if(config->mmap_max_size > 0 && config->file_cache_size == 0) {
+        fprintf(stderr, "ERROR, --mmap-max-size needs the file cache (--file-cache-size).\n");
+        return false;
+    }
+    if(config->incoming_cpu && config->serving_mode != SERVING_MODE_REUSEPORT) {
+        fprintf(stderr, "ERROR, --incoming-cpu needs a listening socket per worker (reuseport mode).\n");
+        return false;
+    }
+
+    // Resolve the default worker count here so the rest of the program never has to deal with 0 workers.
+    // https://man7.org/linux/man-pages/man3/sysconf.3.html
+    if(config->num_workers == DEFAULT_NUM_WORKERS) {
+        long num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+        config->num_workers = num_cores > 0 ? (int) num_cores : 1;
+    }
+
+    return true;
+}
+
+// Prints out how the server is supposed to be run.
+void print_usage(char *program_name) {
+    fprintf(stderr, "Usage: %s [options] <4|6> <port> <web root path>\n", program_name);
+    fprintf(stderr, "  -m, --mode <thread|epoll|pool|reuseport|uring>  serving mode (default thread)\n");
+    fprintf(stderr, "  -w, --workers <n>                  number of worker threads (default one per core)\n");
+    fprintf(stderr, "      --pin-workers                  pin pool, epoll, reuseport and uring workers to their own "
+                    "CPUs\n");
+    fprintf(stderr, "      --incoming-cpu                 pin reuseport workers and give each the connections that "
+                    "arrive on its CPU\n");
+    fprintf(stderr, "  -b, --backlog <n>                  listen backlog (default %d)\n", DEFAULT_LISTEN_BACKLOG);
+    fprintf(stderr, "  -q, --queue-depth <n>              pool queue depth (default %d)\n", DEFAULT_QUEUE_DEPTH);
+    fprintf(stderr, "  -o, --overload <reject|block>      pool overload behaviour (default block)\n");
+    fprintf(stderr, "  -k, --keep-alive-timeout <s>       keep-alive idle timeout (default %d)\n",
+            DEFAULT_KEEP_ALIVE_TIMEOUT);
+    fprintf(stderr, "      --header-timeout <s>           time to send a request's headers (default %d)\n",
+            DEFAULT_HEADER_TIMEOUT);
+    fprintf(stderr, "      --send-timeout <s>             time a response can stall before it is dropped "
+                    "(default %d)\n", DEFAULT_SEND_TIMEOUT);
+    fprintf(stderr, "      --max-connections <n>          open connections before new ones get a 503, 0 for no "
+                    "limit (default %d)\n", DEFAULT_MAX_CONNECTIONS);
+    fprintf(stderr, "      --max-connections-per-client <n>  open connections per client address, 0 for no limit "
+                    "(default %d)\n", DEFAULT_MAX_CONNECTIONS_PER_CLIENT);
+    fprintf(stderr, "      --file-cache-size <n>          open files to cache, 0 to disable (default %d)\n",
+            DEFAULT_FILE_CACHE_SIZE);
+    fprintf(stderr, "      --file-cache-revalidate <s>    seconds between checks of cached files (default %d)\n",
+            DEFAULT_FILE_CACHE_REVALIDATE_INTERVAL);
+    fprintf(stderr, "      --mmap-max-size <bytes>        send files in the file cache up to this size from a mapping "
+                    "of the file, 0 to disable (default %d)\n", DEFAULT_MMAP_MAX_SIZE);
+    fprintf(stderr, "      --response-cache-size <bytes>  memory for rendered small responses, 0 to disable "
+                    "(default %d)\n", DEFAULT_RESPONSE_CACHE_SIZE);
+    fprintf(stderr, "      --response-cache-max-entry <bytes>  largest file kept in the response cache, lowered to "
+                    "what fits in a sixteenth of it (default %d)\n", DEFAULT_RESPONSE_CACHE_MAX_ENTRY_SIZE);
+    fprintf(stderr, "      --stats                        collect stats and serve them at /__stats and "
+                    "/__stats.json\n");
+    fprintf(stderr, "      --precompressed                serve .br and .gz copies of text files to clients "
+                    "which accept them\n");
+    fprintf(stderr, "      --index-web-root               index the web root at startup and 404 anything not in "
+                    "it, for web roots that do not change\n");
+    fprintf(stderr, "  -l, --access-log <path>            append a line for every response to the file\n");
+    fprintf(stderr, "      --drain-timeout <s>            on SIGUSR2, hand the listening sockets to a new server and "
+                    "give open connections this long to finish, 0 to disable (default %d)\n", DEFAULT_DRAIN_TIMEOUT);
+}
@@ -0,0 +1,131 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_CONFIG_H
+#define COMP30023_2022_PROJECT_2_CONFIG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <getopt.h>
+#include <sys/socket.h>
+
+#define SAME_STRING 0
+
+#define NUM_POSITIONAL_ARGS 3
+
+#define THREAD_MODE_ARG "thread"
+#define EPOLL_MODE_ARG "epoll"
+#define POOL_MODE_ARG "pool"
+#define REUSEPORT_MODE_ARG "reuseport"
+#define URING_MODE_ARG "uring"
+
+#define REJECT_OVERLOAD_ARG "reject"
+#define STOP_ACCEPTING_OVERLOAD_ARG "block"
+
+// A worker count of 0 means one worker per online core.
+#define DEFAULT_NUM_WORKERS 0
+#define DEFAULT_QUEUE_DEPTH 1024
+#define DEFAULT_KEEP_ALIVE_TIMEOUT 5
+#define DEFAULT_HEADER_TIMEOUT 10
+#define DEFAULT_SEND_TIMEOUT 30
+// 0 means no limit.
+#define DEFAULT_MAX_CONNECTIONS 0
+#define DEFAULT_MAX_CONNECTIONS_PER_CLIENT 0
+// The file cache is off unless it is given a size, like the response cache, since a cached file can be served for up
+// to the revalidate interval after it changes and holds a file descriptor open against the web root.
+#define DEFAULT_FILE_CACHE_SIZE 0
+#define DEFAULT_FILE_CACHE_REVALIDATE_INTERVAL 1
+#define DEFAULT_RESPONSE_CACHE_SIZE 0
+#define DEFAULT_RESPONSE_CACHE_MAX_ENTRY_SIZE 65536
+#define DEFAULT_MMAP_MAX_SIZE 0
+#define DEFAULT_LISTEN_BACKLOG SOMAXCONN
+#define DEFAULT_DRAIN_TIMEOUT 0
+
+// Options which only have a long form. They start after the range of characters so they cannot clash with the short
+// options.
+enum long_only_option {
+    FILE_CACHE_SIZE_OPTION = 256,
+    FILE_CACHE_REVALIDATE_OPTION,
+    RESPONSE_CACHE_SIZE_OPTION,
+    RESPONSE_CACHE_MAX_ENTRY_OPTION,
+    PIN_WORKERS_OPTION,
+    STATS_OPTION,
+    PRECOMPRESSED_OPTION,
+    HEADER_TIMEOUT_OPTION,
+    SEND_TIMEOUT_OPTION,
+    MAX_CONNECTIONS_OPTION,
+    MAX_CONNECTIONS_PER_CLIENT_OPTION,
+    INDEX_WEB_ROOT_OPTION,
+    MMAP_MAX_SIZE_OPTION,
+    DRAIN_TIMEOUT_OPTION,
+    INCOMING_CPU_OPTION
+};
+
+// The ways in which the server can serve its connections. SERVING_MODE_THREAD is the original model where every
+// accepted connection gets its own thread. SERVING_MODE_EPOLL runs a fixed number of worker threads which each
+// multiplex many non-blocking connections through their own epoll instance. SERVING_MODE_POOL runs a fixed number
+// of pre-spawned threads which each serve one connection at a time, handed to them through a queue.
+// SERVING_MODE_REUSEPORT runs the same workers as SERVING_MODE_EPOLL, but each of them accepts from its own
+// SO_REUSEPORT listening socket instead of all of them sharing one, so accepting scales with the number of workers.
+// SERVING_MODE_URING runs a fixed number of workers which each drive their connections through their own io_uring
+// instance, and falls back to SERVING_MODE_EPOLL on kernels without io_uring.
+typedef enum serving_mode {
+    SERVING_MODE_THREAD,
+    SERVING_MODE_EPOLL,
+    SERVING_MODE_POOL,
+    SERVING_MODE_REUSEPORT,
+    SERVING_MODE_URING
+} serving_mode_t;
+
+// What the thread pool does with a new connection when its queue is already full.
+typedef enum overload_behaviour {
+    OVERLOAD_REJECT,
+    OVERLOAD_STOP_ACCEPTING
+} overload_behaviour_t;
+
+struct file_cache;
+struct response_cache;
+
+// A struct which contains everything that was passed in on the command line. The positional arguments are kept as
+// the strings that were given since they are only ever handed to getaddrinfo or used to build file paths. The caches
+// are set up by main once the options are known and are NULL when disabled.
+typedef struct server_config server_config_t;
+struct server_config {
+    char *ip_version;
+    char *port_number;
+    char *web_root_path;
+    serving_mode_t serving_mode;
+    int num_workers;
+    bool pin_workers;
+    bool incoming_cpu;
+    int listen_backlog;
+    int queue_depth;
+    overload_behaviour_t overload_behaviour;
+    int keep_alive_timeout;
+    int header_timeout;
+    int send_timeout;
+    int max_connections;
+    int max_connections_per_client;
+    int file_cache_size;
+    int file_cache_revalidate_interval;
+    long mmap_max_size;
+    struct file_cache *file_cache;
+    long response_cache_size;
+    long response_cache_max_entry_size;
+    struct response_cache *response_cache;
+    bool stats;
+    bool precompressed;
+    bool index_web_root;
+    char *access_log_path;
+    int drain_timeout;
+};
+
+bool parse_server_config(int argc, char **argv, server_config_t *config);
+
+void print_usage(char *program_name);
+
+#endif //COMP30023_2022_PROJECT_2_CONFIG_H
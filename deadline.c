@@ -0,0 +1,65 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "deadline.h"
+
+// Sets up an empty list of deadlines which run out timeout seconds after they start.
+void deadline_list_init(deadline_list_t *list, int timeout) {
+    list->head = NULL;
+    list->tail = NULL;
+    list->timeout = timeout;
+}
+
+// Starts the deadline from now at the back of the list, taking it out of whichever list it was in first. Restarting a
+// deadline in the list it is already in pushes it back, which is how a connection that is still making progress
+// keeps from running out of time.
+void deadline_start(deadline_t *deadline, deadline_list_t *list, time_t now) {
+    deadline_stop(deadline);
+    deadline->list = list;
+    deadline->started_at = now;
+    deadline->next = NULL;
+    deadline->prev = list->tail;
+    if(list->tail != NULL) {
+        list->tail->next = deadline;
+    } else {
+        list->head = deadline;
+    }
+    list->tail = deadline;
+}
+
+// Takes the deadline out of its list, if it is in one.
+void deadline_stop(deadline_t *deadline) {
+    deadline_list_t *list = deadline->list;
+    if(list == NULL) {
+        return;
+    }
+    if(deadline->prev != NULL) {
+        deadline->prev->next = deadline->next;
+    } else {
+        list->head = deadline->next;
+    }
+    if(deadline->next != NULL) {
+        deadline->next->prev = deadline->prev;
+    } else {
+        list->tail = deadline->prev;
+    }
+    deadline->list = NULL;
+    deadline->prev = NULL;
+    deadline->next = NULL;
+}
+
+// Returns the owner of the deadline at the front of the list if it has run out, and NULL otherwise. Only the front
+// needs to be checked since the list is ordered by when its deadlines run out. The deadline stays in the list, so the
+// caller has to stop it (or close its connection) before asking again.
+void *deadline_list_expired(deadline_list_t *list, time_t now) {
+    if(list->head == NULL || now - list->head->started_at < list->timeout) {
+        return NULL;
+    }
+    return list->head->owner;
+}
+
+// Returns the owner of the deadline at the front of the list, whether or not it has run out, or NULL if the list is
+// empty. Used to close every connection in a list, which like deadline_list_expired needs each one stopped first.
+void *deadline_list_first(deadline_list_t *list) {
+    return list->head == NULL ? NULL : list->head->owner;
+}
@@ -0,0 +1,45 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_DEADLINE_H
+#define COMP30023_2022_PROJECT_2_DEADLINE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+
+typedef struct deadline_list deadline_list_t;
+
+// The deadline of one connection, which is in at most one of its worker's deadline lists at a time. owner is the
+// connection, so that whoever finds the deadline has run out can get back to it.
+typedef struct deadline deadline_t;
+struct deadline {
+    void *owner;
+    deadline_list_t *list;
+    time_t started_at;
+    deadline_t *prev;
+    deadline_t *next;
+};
+
+// Every deadline in a list is for the same timeout, so appending each one as it starts keeps the list ordered from the
+// one which runs out first to the one which runs out last. Starting, restarting and stopping a deadline and finding
+// the ones that have run out are all O(1), without a timer of its own for every connection.
+struct deadline_list {
+    deadline_t *head;
+    deadline_t *tail;
+    int timeout;
+};
+
+void deadline_list_init(deadline_list_t *list, int timeout);
+
+void deadline_start(deadline_t *deadline, deadline_list_t *list, time_t now);
+
+void deadline_stop(deadline_t *deadline);
+
+void *deadline_list_expired(deadline_list_t *list, time_t now);
+
+void *deadline_list_first(deadline_list_t *list);
+
+#endif //COMP30023_2022_PROJECT_2_DEADLINE_H
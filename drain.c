@@ -0,0 +1,42 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "drain.h"
+
+// Set once at startup, before any worker is started.
+static int wake_fd = NO_WAKE_FD;
+static atomic_bool is_draining = false;
+
+// Sets up the eventfd that workers wait on to find out the server has started draining. Only needed when the server
+// can hand over to a new process. Returns false if it could not be created.
+// https://man7.org/linux/man-pages/man2/eventfd.2.html
+bool drain_init(void) {
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if(wake_fd < 0) {
+        perror("eventfd");
+        return false;
+    }
+    return true;
+}
+
+// Starts draining: from now on no new connections are accepted, every response is sent with Connection: close and
+// idle persistent connections are closed, so that the connections the server already has finish on their own. The
+// eventfd is never read, so it stays readable for every worker that waits on it from now on.
+void drain_begin(void) {
+    atomic_store_explicit(&is_draining, true, memory_order_release);
+    if(wake_fd != NO_WAKE_FD) {
+        uint64_t wake = 1;
+        if(write(wake_fd, &wake, sizeof wake) < 0) {
+            perror("write");
+        }
+    }
+}
+
+bool draining(void) {
+    return atomic_load_explicit(&is_draining, memory_order_acquire);
+}
+
+// The eventfd that becomes readable once the server starts draining, or NO_WAKE_FD if the server never drains.
+int drain_wake_fd(void) {
+    return wake_fd;
+}
@@ -0,0 +1,25 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_DRAIN_H
+#define COMP30023_2022_PROJECT_2_DRAIN_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#define NO_WAKE_FD -1
+
+bool drain_init(void);
+
+void drain_begin(void);
+
+bool draining(void);
+
+int drain_wake_fd(void);
+
+#endif //COMP30023_2022_PROJECT_2_DRAIN_H
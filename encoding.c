@@ -0,0 +1,151 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "encoding.h"
+
+static const char *parse_coding(const char *position, const char *end, string_view_t *coding, int *quality);
+static int parse_quality(const char *position, const char *end);
+
+// Set once at startup, before any worker is started.
+static bool precompressed_enabled = false;
+
+// Turns on serving precompressed copies of files. It is off by default since looking for a copy costs a failed open
+// for every file that does not have one, unless the web root is indexed.
+void encoding_enable(void) {
+    precompressed_enabled = true;
+}
+
+bool encoding_enabled(void) {
+    return precompressed_enabled;
+}
+
+// Fills in encodings (which has room for NUM_PRECOMPRESSED_ENCODINGS) with the encodings the request's
+// Accept-Encoding header allows, best first, and returns how many there are. Brotli comes before gzip unless the
+// client gives gzip a higher quality. A quality of 0 rules an encoding out, and "*" stands for every encoding that is
+// not named. Without the header, the client only gets the file itself.
+// https://datatracker.ietf.org/doc/html/rfc9110#section-12.5.3
+int get_accepted_encodings(http_request_t *request, content_encoding_t *encodings) {
+    string_view_t *accept_encoding = find_header(request, ACCEPT_ENCODING_HEADER);
+    int brotli_quality = NO_QUALITY;
+    int gzip_quality = NO_QUALITY;
+    int any_quality = NO_QUALITY;
+    int num_encodings = 0;
+
+    if(accept_encoding == NULL) {
+        return 0;
+    }
+    const char *position = accept_encoding->data;
+    const char *end = accept_encoding->data + accept_encoding->length;
+    while(position < end) {
+        string_view_t coding;
+        int quality;
+        position = parse_coding(position, end, &coding, &quality);
+        if(string_view_case_equals(coding, BROTLI_CODING)) {
+            brotli_quality = quality;
+        } else if(string_view_case_equals(coding, GZIP_CODING) || string_view_case_equals(coding, X_GZIP_CODING)) {
+            gzip_quality = quality;
+        } else if(string_view_equals(coding, ANY_CODING)) {
+            any_quality = quality;
+        }
+    }
+    if(brotli_quality == NO_QUALITY) {
+        brotli_quality = any_quality;
+    }
+    if(gzip_quality == NO_QUALITY) {
+        gzip_quality = any_quality;
+    }
+
+    if(brotli_quality > 0) {
+        encodings[num_encodings++] = CONTENT_ENCODING_BROTLI;
+    }
+    if(gzip_quality > 0) {
+        encodings[num_encodings++] = CONTENT_ENCODING_GZIP;
+    }
+    if(num_encodings == NUM_PRECOMPRESSED_ENCODINGS && gzip_quality > brotli_quality) {
+        encodings[0] = CONTENT_ENCODING_GZIP;
+        encodings[1] = CONTENT_ENCODING_BROTLI;
+    }
+    return num_encodings;
+}
+
+// Returns the suffix that files with the encoding have on the end of their name, which is empty for the file itself.
+const char *get_encoding_suffix(content_encoding_t encoding) {
+    switch(encoding) {
+        case CONTENT_ENCODING_BROTLI:
+            return BROTLI_SUFFIX;
+        case CONTENT_ENCODING_GZIP:
+            return GZIP_SUFFIX;
+        default:
+            return "";
+    }
+}
+
+// Formats the header lines that go with a body in the encoding into buffer, which must hold
+// ENCODING_HEADERS_BUFFER_SIZE characters. varies says whether a different encoding could have been picked for
+// another client, in which case caches are told that the response depends on Accept-Encoding, even when the file
+// itself was sent. https://datatracker.ietf.org/doc/html/rfc9110#section-12.5.5
+void format_encoding_headers(char *buffer, content_encoding_t encoding, bool varies) {
+    int length = 0;
+    buffer[0] = '\0';
+    if(encoding == CONTENT_ENCODING_BROTLI) {
+        length = snprintf(buffer, ENCODING_HEADERS_BUFFER_SIZE, CONTENT_ENCODING_HEADER_FORMAT, BROTLI_CODING);
+    } else if(encoding == CONTENT_ENCODING_GZIP) {
+        length = snprintf(buffer, ENCODING_HEADERS_BUFFER_SIZE, CONTENT_ENCODING_HEADER_FORMAT, GZIP_CODING);
+    }
+    if(varies) {
+        snprintf(buffer + length, ENCODING_HEADERS_BUFFER_SIZE - length, "%s", VARY_ACCEPT_ENCODING_HEADER);
+    }
+}
+
+// Reads one element of an Accept-Encoding list, like "gzip;q=0.5", starting at position. The coding is pointed at
+// and its quality (MAX_QUALITY if none is given) is filled in. Returns the position just past the element and the
+// comma after it.
+static const char *parse_coding(const char *position, const char *end, string_view_t *coding, int *quality) {
+    while(position < end && (*position == ' ' || *position == '\t' || *position == ',')) {
+        position++;
+    }
+    coding->data = position;
+    while(position < end && *position != ',' && *position != ';' && *position != ' ' && *position != '\t') {
+        position++;
+    }
+    coding->length = position - coding->data;
+    *quality = MAX_QUALITY;
+
+    // Parameters, of which only the quality matters.
+    size_t parameter_length = strlen(QUALITY_PARAMETER);
+    while(position < end && *position != ',') {
+        if(*position == ';') {
+            position++;
+            while(position < end && (*position == ' ' || *position == '\t')) {
+                position++;
+            }
+            if((size_t) (end - position) >= parameter_length &&
+                    strncasecmp(position, QUALITY_PARAMETER, parameter_length) == SAME_STRING) {
+                *quality = parse_quality(position + parameter_length, end);
+            }
+            continue;
+        }
+        position++;
+    }
+    return position;
+}
+
+// Reads a quality value, which is 0 or 1 with up to three decimal places, as a number of thousandths. Anything else
+// counts as 0 so that an encoding the client may not want is never sent to it.
+static int parse_quality(const char *position, const char *end) {
+    if(position == end || (*position != '0' && *position != '1')) {
+        return 0;
+    }
+    int quality = (*position - '0') * MAX_QUALITY;
+    int place_value = MAX_QUALITY;
+    position++;
+    if(position < end && *position == '.') {
+        position++;
+        for(int i = 0; i < QUALITY_DECIMAL_PLACES && position < end && *position >= '0' && *position <= '9'; i++) {
+            place_value /= DECIMAL_BASE;
+            quality += (*position - '0') * place_value;
+            position++;
+        }
+    }
+    return quality > MAX_QUALITY ? MAX_QUALITY : quality;
+}
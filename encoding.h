@@ -0,0 +1,62 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_ENCODING_H
+#define COMP30023_2022_PROJECT_2_ENCODING_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+
+#include "parse.h"
+
+#define ACCEPT_ENCODING_HEADER "Accept-Encoding"
+#define BROTLI_CODING "br"
+#define GZIP_CODING "gzip"
+// An old name for gzip which clients are still allowed to send.
+// https://datatracker.ietf.org/doc/html/rfc9110#section-8.4.1.3
+#define X_GZIP_CODING "x-gzip"
+#define ANY_CODING "*"
+#define BROTLI_SUFFIX ".br"
+#define GZIP_SUFFIX ".gz"
+#define QUALITY_PARAMETER "q="
+// Qualities have at most three decimal places, so they are read as whole thousandths.
+// https://datatracker.ietf.org/doc/html/rfc9110#section-12.4.2
+#define MAX_QUALITY 1000
+#define NO_QUALITY -1
+#define QUALITY_DECIMAL_PLACES 3
+#define DECIMAL_BASE 10
+#define CONTENT_ENCODING_HEADER_FORMAT "Content-Encoding: %s\r\n"
+#define VARY_ACCEPT_ENCODING_HEADER "Vary: Accept-Encoding\r\n"
+#define ENCODING_HEADERS_BUFFER_SIZE 64
+// The longest request path that is looked for with an encoding suffix on the end.
+#define ENCODED_REQUEST_PATH_BUFFER_SIZE 1024
+#define ENCODING_SUFFIX_MAX_LENGTH 3
+
+// How the body of a response is encoded. Precompressed copies of a file sit next to it with the suffix of their
+// encoding added on, so "app.js.br" is "app.js" compressed with Brotli. A file is only sent with an encoding when it
+// was picked as the copy of another file for a client which accepts that encoding, never because of its name alone:
+// a request for "archive.tar.gz" itself gets the archive as it is.
+typedef enum content_encoding {
+    CONTENT_ENCODING_IDENTITY,
+    CONTENT_ENCODING_GZIP,
+    CONTENT_ENCODING_BROTLI
+} content_encoding_t;
+
+// The encodings a client can be sent instead of the file itself, at most this many of them.
+#define NUM_PRECOMPRESSED_ENCODINGS 2
+
+void encoding_enable(void);
+
+bool encoding_enabled(void);
+
+int get_accepted_encodings(http_request_t *request, content_encoding_t *encodings);
+
+const char *get_encoding_suffix(content_encoding_t encoding);
+
+void format_encoding_headers(char *buffer, content_encoding_t encoding, bool varies);
+
+#endif //COMP30023_2022_PROJECT_2_ENCODING_H
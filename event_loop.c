@@ -0,0 +1,423 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "event_loop.h"
+
+static void accept_connections(event_loop_worker_t *worker);
+static void advance_connection(event_loop_worker_t *worker, connection_t *connection);
+static bool read_request(event_loop_worker_t *worker, connection_t *connection);
+static bool write_headers(event_loop_worker_t *worker, connection_t *connection);
+static bool send_body(event_loop_worker_t *worker, connection_t *connection);
+static void finish_response(event_loop_worker_t *worker, connection_t *connection);
+static void wait_for_socket(event_loop_worker_t *worker, connection_t *connection, uint32_t events);
+static void close_expired_connections(event_loop_worker_t *worker, deadline_list_t *deadlines, bool timed_out);
+static void close_connection(event_loop_worker_t *worker, connection_t *connection);
+static void stop_accepting(event_loop_worker_t *worker);
+
+// Starts config->num_workers event loop workers and then waits on them. In epoll mode the workers all share the
+// listening socket, which is made non-blocking so that a worker which loses the race for a new connection to another
+// worker gets EAGAIN back from accept instead of blocking. In reuseport mode each worker gets a listening socket of
+// its own instead, all bound to the same port, so there is no race and no shared accept queue for the workers to
+// contend on. The sockets are all opened before any worker starts so that a failure stops the server straight away.
+// With --incoming-cpu, each of those sockets is given the connections that arrive on its worker's CPU. Only returns
+// if the workers could not be started.
+bool run_event_loop(int listen_sockfd, server_config_t *config) {
+    bool per_worker_listeners = config->serving_mode == SERVING_MODE_REUSEPORT;
+    if(!per_worker_listeners) {
+        int flags = fcntl(listen_sockfd, F_GETFL, 0);
+        if(flags < 0 || fcntl(listen_sockfd, F_SETFL, flags | O_NONBLOCK) < 0) {
+            perror("fcntl");
+            return false;
+        }
+    }
+
+    // Each worker starts on a cache line of its own (the struct is aligned to one), since it is written on every
+    // request. https://man7.org/linux/man-pages/man3/aligned_alloc.3.html
+    event_loop_worker_t *workers = (event_loop_worker_t *) aligned_alloc (WORKER_CACHE_LINE_SIZE,
+                                                                          config->num_workers *
+                                                                          sizeof(event_loop_worker_t));
+    if(workers == NULL) {
+        perror("aligned_alloc");
+        return false;
+    }
+    memset(workers, 0, config->num_workers * sizeof(event_loop_worker_t));
+
+    for(int i = 0; i < config->num_workers; i++) {
+        // A pinned worker's epoll instance and listening socket are created on its own CPU, and so on its own NUMA
+        // node.
+        if(config->pin_workers && !move_to_worker_cpu(i)) {
+            return false;
+        }
+        workers[i].listen_sockfd = per_worker_listeners ? open_listener(config, true) : listen_sockfd;
+        if(workers[i].listen_sockfd == NO_LISTENER) {
+            return false;
+        }
+        if(per_worker_listeners && config->incoming_cpu && !steer_to_worker_cpu(workers[i].listen_sockfd, i)) {
+            return false;
+        }
+        workers[i].config = config;
+        deadline_list_init(&workers[i].keep_alive_deadlines, config->keep_alive_timeout);
+        deadline_list_init(&workers[i].header_deadlines, config->header_timeout);
+        deadline_list_init(&workers[i].send_deadlines, config->send_timeout);
+        slab_init(&workers[i].connections, sizeof(connection_t), false);
+        if((workers[i].epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+            perror("epoll_create1");
+            return false;
+        }
+
+        // The listening socket is identified by a NULL data pointer since every other registered file descriptor
+        // carries its connection struct. With a shared listening socket, EPOLLEXCLUSIVE makes the kernel wake up one
+        // worker per incoming connection instead of all of them. https://man7.org/linux/man-pages/man2/epoll_ctl.2.html
+        struct epoll_event event = {.events = per_worker_listeners ? EPOLLIN : EPOLLIN | EPOLLEXCLUSIVE,
+                                    .data.ptr = NULL};
+        if(epoll_ctl(workers[i].epoll_fd, EPOLL_CTL_ADD, workers[i].listen_sockfd, &event) < 0) {
+            perror("epoll_ctl");
+            return false;
+        }
+        // The eventfd which says the server has started draining is identified by the worker's own address.
+        struct epoll_event drain_event = {.events = EPOLLIN, .data.ptr = &workers[i]};
+        if(upgrade_enabled() && epoll_ctl(workers[i].epoll_fd, EPOLL_CTL_ADD, drain_wake_fd(), &drain_event) < 0) {
+            perror("epoll_ctl");
+            return false;
+        }
+    }
+    if(config->pin_workers && !restore_cpus()) {
+        return false;
+    }
+
+    for(int i = 0; i < config->num_workers; i++) {
+        pthread_attr_t attributes;
+        pthread_attr_init(&attributes);
+        if(config->pin_workers && !set_worker_cpu(&attributes, i)) {
+            return false;
+        }
+        if(pthread_create(&workers[i].thread_id, &attributes, event_loop_worker, (void *) &workers[i]) != 0) {
+            perror("pthread_create");
+            return false;
+        }
+        pthread_attr_destroy(&attributes);
+    }
+    if(!upgrade_start()) {
+        return false;
+    }
+
+    for(int i = 0; i < config->num_workers; i++) {
+        pthread_join(workers[i].thread_id, NULL);
+    }
+    free(workers);
+    return true;
+}
+
+// Function that is passed into pthread_create for each worker. Waits on the worker's epoll instance forever and
+// hands every ready file descriptor to either accept_connections (for the listening socket), stop_accepting (for the
+// eventfd that says the server is draining) or advance_connection (for a client socket). epoll_wait is woken up at
+// least once every DEADLINE_SWEEP_INTERVAL_MS so that connections which have run out of time get closed even when
+// nothing else is happening.
+void *event_loop_worker(void *event_loop_worker_args) {
+    event_loop_worker_t *worker = (event_loop_worker_t *) event_loop_worker_args;
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+
+    slab_reserve(&worker->connections);
+
+    while(true) {
+        int num_events = epoll_wait(worker->epoll_fd, events, MAX_EPOLL_EVENTS, DEADLINE_SWEEP_INTERVAL_MS);
+        if(num_events < 0) {
+            // Being interrupted by a signal is not an error, just wait again.
+            if(errno != EINTR) {
+                perror("epoll_wait");
+            }
+            continue;
+        }
+
+        // Idle connections are only closed after going through every event, since a later event may be for one of
+        // them.
+        bool drain_started = false;
+        for(int i = 0; i < num_events; i++) {
+            if(events[i].data.ptr == NULL) {
+                accept_connections(worker);
+            } else if(events[i].data.ptr == worker) {
+                drain_started = true;
+            } else {
+                advance_connection(worker, (connection_t *) events[i].data.ptr);
+            }
+        }
+        if(drain_started) {
+            stop_accepting(worker);
+        }
+        close_expired_connections(worker, &worker->keep_alive_deadlines, false);
+        close_expired_connections(worker, &worker->header_deadlines, true);
+        close_expired_connections(worker, &worker->send_deadlines, true);
+    }
+    return NULL;
+}
+
+// Accepts every connection that is currently waiting on the listening socket and registers each of them with this
+// worker's epoll instance. accept4 lets the new sockets be created non-blocking without an extra fcntl call.
+// https://man7.org/linux/man-pages/man2/accept.2.html
+static void accept_connections(event_loop_worker_t *worker) {
+    while(true) {
+        struct sockaddr_storage client_addr;
+        socklen_t client_addr_size = sizeof client_addr;
+        int newsockfd = accept4(worker->listen_sockfd, (struct sockaddr *) &client_addr, &client_addr_size,
+                                SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(newsockfd < 0) {
+            // EAGAIN means there is nothing left to accept (or another worker sharing the socket got there first).
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("accept4");
+            }
+            return;
+        }
+        stats_count(STATS_CONNECTIONS_ACCEPTED, 1);
+        if(!admission_admit(&client_addr)) {
+            reject_connection(newsockfd);
+            continue;
+        }
+
+        connection_t *connection = (connection_t *) slab_alloc(&worker->connections);
+        if(connection == NULL) {
+            close(newsockfd);
+            admission_release(&client_addr);
+            continue;
+        }
+        // Zeroed so that the connection starts off with an empty buffer and a parser at the start of it.
+        memset(connection, 0, sizeof(connection_t));
+        connection->sockfd = newsockfd;
+        connection->client_addr = client_addr;
+        connection->state = CONNECTION_READING_REQUEST;
+        connection->response.file_fd = NO_FILE_DESCRIPTOR;
+        connection->epoll_events = EPOLLIN;
+        connection->accepted_at = stats_now();
+        // The header timeout of the first request starts straight away, so a client that never sends anything does
+        // not hold on to the connection either.
+        connection->deadline.owner = connection;
+        deadline_start(&connection->deadline, &worker->header_deadlines, monotonic_seconds());
+
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = connection};
+        if(epoll_ctl(worker->epoll_fd, EPOLL_CTL_ADD, newsockfd, &event) < 0) {
+            perror("epoll_ctl");
+            close_connection(worker, connection);
+        }
+    }
+}
+
+// Moves a connection through as many stages as it can without blocking. Each stage function returns true once the
+// stage is finished and false if the socket would block, in which case the connection waits on epoll for the socket
+// to become ready again. Errors move the connection straight to CONNECTION_CLOSING, which drops it like
+// serve_client does. Every time a response has to wait for the client to take more of it, its send deadline starts
+// again, so only a response which stops going anywhere runs out of time.
+static void advance_connection(event_loop_worker_t *worker, connection_t *connection) {
+    while(true) {
+        switch(connection->state) {
+            case CONNECTION_READING_REQUEST:
+                if(!read_request(worker, connection)) {
+                    wait_for_socket(worker, connection, EPOLLIN);
+                    return;
+                }
+                break;
+            case CONNECTION_WRITING_HEADERS:
+                if(!write_headers(worker, connection)) {
+                    wait_for_socket(worker, connection, EPOLLOUT);
+                    deadline_start(&connection->deadline, &worker->send_deadlines, monotonic_seconds());
+                    return;
+                }
+                break;
+            case CONNECTION_SENDING_BODY:
+                if(!send_body(worker, connection)) {
+                    wait_for_socket(worker, connection, EPOLLOUT);
+                    deadline_start(&connection->deadline, &worker->send_deadlines, monotonic_seconds());
+                    return;
+                }
+                break;
+            case CONNECTION_CLOSING:
+                // Closing the socket also removes it from the epoll instance.
+                close_connection(worker, connection);
+                return;
+        }
+    }
+}
+
+// Reads whatever is available on the socket into the connection's buffer, unless the buffer already holds a
+// complete request that was pipelined behind the previous one. Once "\r\n\r\n" has arrived, the request is turned
+// into a response in the same way serve_client does it and the connection moves on to writing the headers. Returns
+// false if the request is not complete yet.
+static bool read_request(event_loop_worker_t *worker, connection_t *connection) {
+    size_t request_length;
+
+    while((request_length = find_request_end(&connection->parser, connection->buffer, connection->bytes_read_so_far))
+            == NO_COMPLETE_REQUEST) {
+        // A request which fills up the whole buffer without ending is answered with a 404 like other invalid
+        // requests, since it can never be completed. The 404 closes the connection.
+        if(connection->bytes_read_so_far == REQUEST_MAX_BUFFER_SIZE) {
+            connection->response_started_at = access_log_start();
+            prepare_http_response(&connection->response, NULL, NULL);
+            connection->request_length = connection->bytes_read_so_far;
+            connection->state = CONNECTION_WRITING_HEADERS;
+            return true;
+        }
+
+        int n = read(connection->sockfd, connection->buffer + connection->bytes_read_so_far,
+                     REQUEST_MAX_BUFFER_SIZE - connection->bytes_read_so_far);
+        if(n < 0) {
+            if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return false;
+            }
+            perror("read");
+            connection->state = CONNECTION_CLOSING;
+            return true;
+        }
+        // The client closed the connection.
+        if(n == 0) {
+            connection->state = CONNECTION_CLOSING;
+            return true;
+        }
+        // Something has arrived, so the connection is no longer idle and the header timeout of its next request
+        // starts.
+        if(connection->deadline.list == &worker->keep_alive_deadlines) {
+            deadline_start(&connection->deadline, &worker->header_deadlines, monotonic_seconds());
+        }
+        connection->bytes_read_so_far += n;
+        stats_record(STATS_STAGE_FIRST_BYTE, connection->accepted_at);
+        connection->accepted_at = STATS_NOT_TIMED;
+    }
+
+    deadline_stop(&connection->deadline);
+    connection->response_started_at = access_log_start();
+    prepare_response_to_request(&connection->response, connection->buffer, request_length, worker->config);
+
+    connection->request_length = request_length;
+    connection->state = CONNECTION_WRITING_HEADERS;
+    return true;
+}
+
+// Writes as much of the formatted headers (and the body, if it is in memory) as the socket will take. Returns false
+// if the socket would block before all of them have been written.
+static bool write_headers(event_loop_worker_t *worker, connection_t *connection) {
+    http_response_t *response = &connection->response;
+
+    while(!response_buffers_sent(response)) {
+        if(write_response_buffers(connection->sockfd, response) < 0) {
+            if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return false;
+            }
+            perror("sendmsg");
+            connection->state = CONNECTION_CLOSING;
+            return true;
+        }
+    }
+    record_headers_sent(response);
+
+    if(response->file_fd == NO_FILE_DESCRIPTOR) {
+        finish_response(worker, connection);
+    } else {
+        connection->state = CONNECTION_SENDING_BODY;
+    }
+    return true;
+}
+
+// Sends as much of the body as the socket will take with sendfile. sendfile advances body_offset by itself, so the
+// next call carries on from where this one stopped. Returns false if the socket would block before the whole body
+// has been sent.
+static bool send_body(event_loop_worker_t *worker, connection_t *connection) {
+    http_response_t *response = &connection->response;
+
+    while(response->body_offset < response->body_end) {
+        ssize_t n = sendfile(connection->sockfd, response->file_fd, &response->body_offset,
+                             response->body_end - response->body_offset);
+        if(n < 0) {
+            if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return false;
+            }
+            perror("sendfile");
+            connection->state = CONNECTION_CLOSING;
+            return true;
+        }
+        // The file got shorter after it was opened. The Content-Length has already gone out, so the connection has
+        // to be dropped.
+        if(n == 0) {
+            connection->state = CONNECTION_CLOSING;
+            return true;
+        }
+        stats_count(STATS_FILE_BYTES_SENT, n);
+    }
+
+    // The next part of a multipart body goes out the same way, starting with its headers.
+    if(response_next_part(response)) {
+        connection->state = CONNECTION_WRITING_HEADERS;
+        return true;
+    }
+    record_body_sent(response);
+    finish_response(worker, connection);
+    return true;
+}
+
+// Called once a response has been sent in full. Persistent connections drop the request that was just answered from
+// the front of the buffer and go back to reading, starting with any pipelined bytes that came in after it. If
+// nothing has come in yet, the connection is idle until it does, and otherwise the next request's header timeout
+// starts now. A server that has started draining since the response was prepared closes the connection anyway.
+static void finish_response(event_loop_worker_t *worker, connection_t *connection) {
+    access_log_response(&connection->client_addr, &connection->response, connection->response_started_at);
+    connection->response_started_at = NOT_LOGGING;
+    release_http_response(&connection->response);
+    if(!connection->response.keep_alive || draining()) {
+        connection->state = CONNECTION_CLOSING;
+        return;
+    }
+
+    connection->bytes_read_so_far -= connection->request_length;
+    memmove(connection->buffer, connection->buffer + connection->request_length, connection->bytes_read_so_far);
+    connection->request_length = 0;
+    deadline_start(&connection->deadline, connection->bytes_read_so_far == 0 ? &worker->keep_alive_deadlines
+                                                                            : &worker->header_deadlines,
+                   monotonic_seconds());
+    connection->state = CONNECTION_READING_REQUEST;
+}
+
+// Changes which events the worker's epoll instance reports for this connection, if they are not the ones already
+// being waited on.
+static void wait_for_socket(event_loop_worker_t *worker, connection_t *connection, uint32_t events) {
+    if(connection->epoll_events == events) {
+        return;
+    }
+    struct epoll_event event = {.events = events, .data.ptr = connection};
+    if(epoll_ctl(worker->epoll_fd, EPOLL_CTL_MOD, connection->sockfd, &event) < 0) {
+        perror("epoll_ctl");
+    }
+    connection->epoll_events = events;
+}
+
+// Closes every connection in the list whose deadline has run out, counting them as timed out unless they were only
+// idle persistent connections, which are closed once the keep-alive timeout is up as a matter of course.
+static void close_expired_connections(event_loop_worker_t *worker, deadline_list_t *deadlines, bool timed_out) {
+    time_t now = monotonic_seconds();
+    connection_t *connection;
+    while((connection = (connection_t *) deadline_list_expired(deadlines, now)) != NULL) {
+        if(timed_out) {
+            stats_count(STATS_CONNECTIONS_TIMED_OUT, 1);
+        }
+        close_connection(worker, connection);
+    }
+}
+
+// Drops the connection by closing the socket and the file being sent, then hands the connection struct back to the
+// worker's slab. A response that was still being sent is logged with however much of it got out.
+static void close_connection(event_loop_worker_t *worker, connection_t *connection) {
+    deadline_stop(&connection->deadline);
+    access_log_response(&connection->client_addr, &connection->response, connection->response_started_at);
+    release_http_response(&connection->response);
+    close(connection->sockfd);
+    admission_release(&connection->client_addr);
+    slab_free(&worker->connections, connection);
+}
+
+// Called once the server starts draining. The worker stops waiting on the listening socket and the eventfd (which
+// stays readable from now on), and closes its idle persistent connections, which would otherwise only be closed
+// once their keep-alive timeout runs out. Connections in the middle of a request or response carry on and are
+// closed once their response has been sent.
+static void stop_accepting(event_loop_worker_t *worker) {
+    epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, worker->listen_sockfd, NULL);
+    epoll_ctl(worker->epoll_fd, EPOLL_CTL_DEL, drain_wake_fd(), NULL);
+    connection_t *connection;
+    while((connection = (connection_t *) deadline_list_first(&worker->keep_alive_deadlines)) != NULL) {
+        close_connection(worker, connection);
+    }
+}
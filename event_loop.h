@@ -0,0 +1,93 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_EVENT_LOOP_H
+#define COMP30023_2022_PROJECT_2_EVENT_LOOP_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "config.h"
+#include "monotonic.h"
+#include "parse.h"
+#include "respond.h"
+#include "listener.h"
+#include "access_log.h"
+#include "slab.h"
+#include "deadline.h"
+#include "admission.h"
+#include "upgrade.h"
+#include "affinity.h"
+
+#define MAX_EPOLL_EVENTS 64
+#define DEADLINE_SWEEP_INTERVAL_MS 1000
+
+// The stages a connection goes through in the event loop. Every connection starts off reading its request and then
+// moves down the list one stage at a time, stopping whenever the socket would block and picking up from the same
+// stage the next time epoll reports the socket as ready.
+typedef enum connection_state {
+    CONNECTION_READING_REQUEST,
+    CONNECTION_WRITING_HEADERS,
+    CONNECTION_SENDING_BODY,
+    CONNECTION_CLOSING
+} connection_state_t;
+
+// A struct which contains everything that serve_client would normally keep on its stack. Since a worker serves
+// many connections at once, this has to live on the heap between calls instead. The deadline is in whichever of its
+// worker's deadline lists goes with what the connection is waiting for, if it is waiting at all. accepted_at is when
+// the connection was accepted, until its first bytes arrive. response_started_at is when the response being sent
+// was prepared, for the access log, and NOT_LOGGING when there is none or nothing is logged.
+typedef struct connection connection_t;
+struct connection {
+    int sockfd;
+    struct sockaddr_storage client_addr;
+    connection_state_t state;
+    uint32_t epoll_events;
+    long accepted_at;
+    long response_started_at;
+    int bytes_read_so_far;
+    size_t request_length;
+    http_parser_t parser;
+    char buffer[REQUEST_MAX_BUFFER_SIZE];
+    http_response_t response;
+    deadline_t deadline;
+};
+
+// A struct which contains the arguments needed for the event_loop_worker function. Each worker owns its own epoll
+// instance and every connection it accepts, which come out of its own slab so that accepting and closing connections
+// does not go through malloc once the worker has seen its busiest moment. Connections that are waiting on their client
+// are in one of the deadline lists: persistent connections waiting for their next request in keep_alive_deadlines,
+// connections part way through receiving a request in header_deadlines, and connections waiting for the client to
+// take more of a response in send_deadlines.
+typedef struct event_loop_worker event_loop_worker_t;
+struct event_loop_worker {
+    _Alignas(WORKER_CACHE_LINE_SIZE) pthread_t thread_id;
+    int epoll_fd;
+    int listen_sockfd;
+    server_config_t *config;
+    deadline_list_t keep_alive_deadlines;
+    deadline_list_t header_deadlines;
+    deadline_list_t send_deadlines;
+    slab_t connections;
+};
+
+bool run_event_loop(int listen_sockfd, server_config_t *config);
+
+void *event_loop_worker(void *event_loop_worker_args);
+
+#endif //COMP30023_2022_PROJECT_2_EVENT_LOOP_H
@@ -0,0 +1,112 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "fd_queue.h"
+
+static void enqueue(fd_queue_t *queue, int fd, const struct sockaddr_storage *client_addr, long accepted_at);
+static int dequeue(fd_queue_t *queue, struct sockaddr_storage *client_addr, long *accepted_at);
+
+// Sets up the queue so it can hold at least capacity file descriptors. The capacity is rounded up to a power of two
+// so that positions can be turned into slot indexes with a mask instead of a division. Returns false if memory for
+// the slots could not be allocated.
+bool fd_queue_init(fd_queue_t *queue, size_t capacity) {
+    size_t rounded_capacity = 1;
+    while(rounded_capacity < capacity) {
+        rounded_capacity <<= 1;
+    }
+
+    queue->slots = (fd_queue_slot_t *) calloc (rounded_capacity, sizeof(fd_queue_slot_t));
+    if(queue->slots == NULL) {
+        perror("calloc");
+        return false;
+    }
+    for(size_t i = 0; i < rounded_capacity; i++) {
+        atomic_init(&queue->slots[i].sequence, i);
+    }
+    queue->mask = rounded_capacity - 1;
+    atomic_init(&queue->enqueue_pos, 0);
+    atomic_init(&queue->dequeue_pos, 0);
+
+    // Only the free slot count starts above 0. https://man7.org/linux/man-pages/man3/sem_init.3.html
+    if(sem_init(&queue->free_slots, 0, rounded_capacity) < 0 || sem_init(&queue->queued_fds, 0, 0) < 0) {
+        perror("sem_init");
+        free(queue->slots);
+        return false;
+    }
+    return true;
+}
+
+// Pushes fd onto the queue if there is room for it. Returns false straight away if the queue is full.
+bool fd_queue_try_push(fd_queue_t *queue, int fd, const struct sockaddr_storage *client_addr,
+                       long accepted_at) {
+    if(sem_trywait(&queue->free_slots) < 0) {
+        return false;
+    }
+    enqueue(queue, fd, client_addr, accepted_at);
+    return true;
+}
+
+// Pushes fd onto the queue, waiting for a slot to free up if the queue is full. Returns false if waiting failed for
+// any reason other than a signal, in which case nothing has been pushed and the caller still owns fd.
+// https://man7.org/linux/man-pages/man3/sem_wait.3.html
+bool fd_queue_push(fd_queue_t *queue, int fd, const struct sockaddr_storage *client_addr, long accepted_at) {
+    while(sem_wait(&queue->free_slots) < 0) {
+        // Only retry if interrupted by a signal.
+        if(errno != EINTR) {
+            perror("sem_wait");
+            return false;
+        }
+    }
+    enqueue(queue, fd, client_addr, accepted_at);
+    return true;
+}
+
+// Pops the oldest file descriptor off the queue into fd, waiting for one to be pushed if the queue is empty. The
+// client's address is put in client_addr and the time it was accepted in accepted_at. Returns false if waiting failed
+// for any reason other than a signal, in which case nothing has been popped.
+bool fd_queue_pop(fd_queue_t *queue, int *fd, struct sockaddr_storage *client_addr, long *accepted_at) {
+    while(sem_wait(&queue->queued_fds) < 0) {
+        if(errno != EINTR) {
+            perror("sem_wait");
+            return false;
+        }
+    }
+    *fd = dequeue(queue, client_addr, accepted_at);
+    sem_post(&queue->free_slots);
+    return true;
+}
+
+// Claims the next position for writing and fills in its slot. The caller has already taken a free slot from the
+// semaphore, so the slot at the claimed position is guaranteed to be consumed already (or about to be), and this
+// only has to wait out a consumer that is still between claiming and releasing it.
+static void enqueue(fd_queue_t *queue, int fd, const struct sockaddr_storage *client_addr, long accepted_at) {
+    size_t position = atomic_fetch_add_explicit(&queue->enqueue_pos, 1, memory_order_relaxed);
+    fd_queue_slot_t *slot = &queue->slots[position & queue->mask];
+
+    while(atomic_load_explicit(&slot->sequence, memory_order_acquire) != position) {
+        // Spin, the previous consumer of this slot is about to release it.
+    }
+    slot->fd = fd;
+    slot->accepted_at = accepted_at;
+    slot->client_addr = *client_addr;
+    // Publish the file descriptor to consumers.
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+    sem_post(&queue->queued_fds);
+}
+
+// Claims the next position for reading and takes the file descriptor out of its slot. The caller has already taken
+// a queued file descriptor from the semaphore, so this only has to wait out a producer that is still filling it in.
+static int dequeue(fd_queue_t *queue, struct sockaddr_storage *client_addr, long *accepted_at) {
+    size_t position = atomic_fetch_add_explicit(&queue->dequeue_pos, 1, memory_order_relaxed);
+    fd_queue_slot_t *slot = &queue->slots[position & queue->mask];
+
+    while(atomic_load_explicit(&slot->sequence, memory_order_acquire) != position + 1) {
+        // Spin, the producer of this slot is about to publish it.
+    }
+    int fd = slot->fd;
+    *accepted_at = slot->accepted_at;
+    *client_addr = slot->client_addr;
+    // Hand the slot back to producers for the next lap around the ring.
+    atomic_store_explicit(&slot->sequence, position + queue->mask + 1, memory_order_release);
+    return fd;
+}
@@ -0,0 +1,55 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_FD_QUEUE_H
+#define COMP30023_2022_PROJECT_2_FD_QUEUE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <semaphore.h>
+#include <sys/socket.h>
+
+#define CACHE_LINE_SIZE 64
+
+// One slot of the ring buffer. The sequence number says whose turn it is to use the slot: it equals the slot's
+// position when a producer may write to it and the position + 1 once there is a file descriptor in it for a consumer.
+// The client's address and the time the connection was accepted travel with it, for the connection limits, the
+// access log and the stats.
+typedef struct fd_queue_slot fd_queue_slot_t;
+struct fd_queue_slot {
+    atomic_size_t sequence;
+    int fd;
+    long accepted_at;
+    struct sockaddr_storage client_addr;
+};
+
+// A bounded multi-producer multi-consumer queue of file descriptors. Pushing and popping each claim a slot with an
+// atomic fetch_add on the relevant position counter, then wait for the slot's sequence number to say it is ready
+// for them (filled for a pop, emptied for a push), so no lock is held while handing a connection over. The two
+// semaphores count free slots and queued file descriptors so that callers can sleep instead of spinning when the
+// queue is full or empty. The position counters are kept on separate cache lines so producers and consumers do not
+// keep stealing the same line from each other.
+typedef struct fd_queue fd_queue_t;
+struct fd_queue {
+    fd_queue_slot_t *slots;
+    size_t mask;
+    sem_t free_slots;
+    sem_t queued_fds;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t enqueue_pos;
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t dequeue_pos;
+};
+
+bool fd_queue_init(fd_queue_t *queue, size_t capacity);
+
+bool fd_queue_try_push(fd_queue_t *queue, int fd, const struct sockaddr_storage *client_addr,
+                       long accepted_at);
+
+bool fd_queue_push(fd_queue_t *queue, int fd, const struct sockaddr_storage *client_addr, long accepted_at);
+
+bool fd_queue_pop(fd_queue_t *queue, int *fd, struct sockaddr_storage *client_addr, long *accepted_at);
+
+#endif //COMP30023_2022_PROJECT_2_FD_QUEUE_H
@@ -0,0 +1,288 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "file_cache.h"
+#include "respond.h"
+
+static file_cache_entry_t *find_entry(file_cache_shard_t *shard, string_view_t request_path,
+                                      content_encoding_t content_encoding, uint64_t hash);
+static bool revalidate_entry(file_cache_t *cache, file_cache_entry_t *entry);
+static file_cache_entry_t *create_entry(string_view_t request_path, content_encoding_t content_encoding,
+                                        char *file_path, int fd, struct stat *file_stat, uint64_t hash);
+static const char *map_file(int fd, size_t file_size, size_t mmap_max_size);
+static file_cache_entry_t *insert_entry(file_cache_shard_t *shard, file_cache_entry_t *entry);
+static void remove_entry(file_cache_shard_t *shard, file_cache_entry_t *entry);
+static size_t claim_clock_slot(file_cache_shard_t *shard);
+
+// Sets up a cache which holds up to capacity open files, split evenly between the shards. Returns false if memory
+// could not be allocated.
+bool file_cache_init(file_cache_t *cache, size_t capacity, int revalidate_interval, size_t mmap_max_size) {
+    size_t shard_capacity = (capacity + FILE_CACHE_NUM_SHARDS - 1) / FILE_CACHE_NUM_SHARDS;
+
+    // Round the bucket count up to a power of two so a bucket can be picked with a mask.
+    size_t num_buckets = 1;
+    while(num_buckets < shard_capacity * FILE_CACHE_BUCKETS_PER_ENTRY) {
+        num_buckets <<= 1;
+    }
+
+    cache->revalidate_interval = revalidate_interval;
+    cache->mmap_max_size = mmap_max_size;
+    for(int i = 0; i < FILE_CACHE_NUM_SHARDS; i++) {
+        file_cache_shard_t *shard = &cache->shards[i];
+        shard->buckets = (file_cache_entry_t **) calloc (num_buckets, sizeof(file_cache_entry_t *));
+        shard->clock_slots = (file_cache_entry_t **) calloc (shard_capacity, sizeof(file_cache_entry_t *));
+        if(shard->buckets == NULL || shard->clock_slots == NULL) {
+            perror("calloc");
+            return false;
+        }
+        shard->bucket_mask = num_buckets - 1;
+        shard->capacity = shard_capacity;
+        shard->clock_hand = 0;
+        pthread_mutex_init(&shard->lock, NULL);
+    }
+    return true;
+}
+
+// Looks up the file for request_path, to be sent with content_encoding, and returns its entry with a reference taken
+// on behalf of the caller, who must hand it back with file_cache_release once the file is no longer needed. On a miss
+// (or if the cached file has changed on disk) the file is opened and added to the cache. Returns NULL if there is no
+// regular file at the path, in which case the request gets a 404. The request path must already have been checked
+// for escape components.
+file_cache_entry_t *file_cache_acquire(file_cache_t *cache, string_view_t request_path,
+                                       content_encoding_t content_encoding) {
+    file_cache_entry_t *entry = file_cache_find(cache, request_path, content_encoding);
+    if(entry != NULL) {
+        return entry;
+    }
+
+    char file_path[FILE_PATH_BUFFER_SIZE];
+    if(!get_file_path(file_path, request_path)) {
+        return NULL;
+    }
+    long start_time = stats_now();
+    int fd = web_root_open_file(file_path);
+    struct stat file_stat;
+    bool opened = fd >= 0 && fstat(fd, &file_stat) == 0;
+    stats_record(STATS_STAGE_OPEN, start_time);
+    // Only regular files are served, same as when the cache is not used.
+    if(!opened || !S_ISREG(file_stat.st_mode)) {
+        if(fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    return file_cache_add(cache, request_path, content_encoding, file_path, fd, &file_stat);
+}
+
+// Same as file_cache_acquire, but only looks in the cache and returns NULL on a miss without opening anything, for
+// callers which open files themselves.
+file_cache_entry_t *file_cache_find(file_cache_t *cache, string_view_t request_path,
+                                    content_encoding_t content_encoding) {
+    uint64_t hash = hash_request_path(request_path);
+    file_cache_shard_t *shard = &cache->shards[hash % FILE_CACHE_NUM_SHARDS];
+
+    pthread_mutex_lock(&shard->lock);
+    file_cache_entry_t *entry = find_entry(shard, request_path, content_encoding, hash);
+    if(entry != NULL) {
+        atomic_fetch_add_explicit(&entry->reference_count, 1, memory_order_relaxed);
+        atomic_store_explicit(&entry->referenced, true, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    // The stat done to revalidate an entry happens outside the lock so that it does not hold up the rest of the
+    // shard.
+    if(entry != NULL && !revalidate_entry(cache, entry)) {
+        pthread_mutex_lock(&shard->lock);
+        remove_entry(shard, entry);
+        pthread_mutex_unlock(&shard->lock);
+        file_cache_release(entry);
+        entry = NULL;
+    }
+    return entry;
+}
+
+// Adds a regular file that the caller has just opened for request_path to the cache and returns its entry, with a
+// reference for the caller like file_cache_acquire. The entry takes over the file descriptor, which is closed straight
+// away if the entry cannot be allocated, in which case NULL is returned. The file path is copied into the entry.
+file_cache_entry_t *file_cache_add(file_cache_t *cache, string_view_t request_path,
+                                   content_encoding_t content_encoding, char *file_path, int fd,
+                                   struct stat *file_stat) {
+    uint64_t hash = hash_request_path(request_path);
+    file_cache_shard_t *shard = &cache->shards[hash % FILE_CACHE_NUM_SHARDS];
+
+    file_cache_entry_t *entry = create_entry(request_path, content_encoding, file_path, fd, file_stat, hash);
+    if(entry == NULL) {
+        return NULL;
+    }
+    entry->mapping = map_file(fd, file_stat->st_size, cache->mmap_max_size);
+    pthread_mutex_lock(&shard->lock);
+    entry = insert_entry(shard, entry);
+    pthread_mutex_unlock(&shard->lock);
+    return entry;
+}
+
+// Hands back a reference taken by file_cache_acquire. The file is closed and the entry freed once nothing refers to
+// it anymore.
+void file_cache_release(file_cache_entry_t *entry) {
+    if(atomic_fetch_sub_explicit(&entry->reference_count, 1, memory_order_acq_rel) == 1) {
+        if(entry->mapping != NULL) {
+            munmap((void *) entry->mapping, entry->file_stat.st_size);
+        }
+        close(entry->fd);
+        free(entry->request_path);
+        free(entry->file_path);
+        free(entry);
+    }
+}
+
+// Finds the entry for request_path sent with content_encoding in the shard. The shard must be locked.
+static file_cache_entry_t *find_entry(file_cache_shard_t *shard, string_view_t request_path,
+                                      content_encoding_t content_encoding, uint64_t hash) {
+    file_cache_entry_t *entry = shard->buckets[(hash / FILE_CACHE_NUM_SHARDS) & shard->bucket_mask];
+    while(entry != NULL) {
+        if(entry->hash == hash && entry->content_encoding == content_encoding &&
+                entry->request_path_length == request_path.length &&
+                memcmp(entry->request_path, request_path.data, request_path.length) == SAME_STRING) {
+            return entry;
+        }
+        entry = entry->next_in_bucket;
+    }
+    return NULL;
+}
+
+// Checks the entry against the file on disk if it has not been checked within the revalidate interval. Returns false
+// if the file has been changed, replaced or removed since it was opened.
+static bool revalidate_entry(file_cache_t *cache, file_cache_entry_t *entry) {
+    time_t now = monotonic_seconds();
+    if(now - atomic_load_explicit(&entry->last_validated, memory_order_relaxed) < cache->revalidate_interval) {
+        return true;
+    }
+
+    struct stat current_stat;
+    if(web_root_stat_file(entry->file_path, &current_stat) < 0 || !file_unchanged(&entry->file_stat, &current_stat)) {
+        return false;
+    }
+    atomic_store_explicit(&entry->last_validated, now, memory_order_relaxed);
+    return true;
+}
+
+// Returns true if the stat data taken now describes the same, unmodified file as the cached stat data. Also used by
+// the response cache.
+bool file_unchanged(struct stat *cached_stat, struct stat *current_stat) {
+    return cached_stat->st_dev == current_stat->st_dev && cached_stat->st_ino == current_stat->st_ino &&
+            cached_stat->st_size == current_stat->st_size &&
+            cached_stat->st_mtim.tv_sec == current_stat->st_mtim.tv_sec &&
+            cached_stat->st_mtim.tv_nsec == current_stat->st_mtim.tv_nsec;
+}
+
+// Creates an entry for a file which has been opened for request_path, with one reference for the caller. Returns NULL
+// if memory could not be allocated, after closing the file.
+static file_cache_entry_t *create_entry(string_view_t request_path, content_encoding_t content_encoding,
+                                        char *file_path, int fd, struct stat *file_stat, uint64_t hash) {
+    file_cache_entry_t *entry = (file_cache_entry_t *) malloc (sizeof(file_cache_entry_t));
+    char *request_path_copy = strndup(request_path.data, request_path.length);
+    char *file_path_copy = strdup(file_path);
+    if(entry == NULL || request_path_copy == NULL || file_path_copy == NULL) {
+        perror("malloc");
+        free(entry);
+        free(request_path_copy);
+        free(file_path_copy);
+        close(fd);
+        return NULL;
+    }
+    entry->request_path = request_path_copy;
+    entry->request_path_length = request_path.length;
+    entry->file_path = file_path_copy;
+    entry->hash = hash;
+    entry->fd = fd;
+    entry->file_stat = *file_stat;
+    entry->content_type = get_content_type(file_path, content_encoding);
+    entry->content_encoding = content_encoding;
+    entry->mapping = NULL;
+    atomic_init(&entry->reference_count, 1);
+    atomic_init(&entry->referenced, true);
+    atomic_init(&entry->last_validated, monotonic_seconds());
+    entry->next_in_bucket = NULL;
+    return entry;
+}
+
+// Adds a freshly created entry to the shard, evicting another entry if the shard is full. If another thread added an
+// entry for the same path in the meantime, that entry is used instead and the new one is thrown away. Returns the
+// entry that ended up in the cache, with a reference for the caller. The shard must be locked.
+static file_cache_entry_t *insert_entry(file_cache_shard_t *shard, file_cache_entry_t *entry) {
+    string_view_t request_path = {entry->request_path, entry->request_path_length};
+    file_cache_entry_t *existing_entry = find_entry(shard, request_path, entry->content_encoding, entry->hash);
+    if(existing_entry != NULL) {
+        atomic_fetch_add_explicit(&existing_entry->reference_count, 1, memory_order_relaxed);
+        file_cache_release(entry);
+        return existing_entry;
+    }
+
+    // The cache's own reference.
+    atomic_fetch_add_explicit(&entry->reference_count, 1, memory_order_relaxed);
+    entry->clock_slot = claim_clock_slot(shard);
+    shard->clock_slots[entry->clock_slot] = entry;
+
+    file_cache_entry_t **bucket = &shard->buckets[(entry->hash / FILE_CACHE_NUM_SHARDS) & shard->bucket_mask];
+    entry->next_in_bucket = *bucket;
+    *bucket = entry;
+    return entry;
+}
+
+// Takes an entry out of the shard and drops the cache's reference to it. Does nothing if the entry has already been
+// removed by another thread. The shard must be locked.
+static void remove_entry(file_cache_shard_t *shard, file_cache_entry_t *entry) {
+    file_cache_entry_t **link = &shard->buckets[(entry->hash / FILE_CACHE_NUM_SHARDS) & shard->bucket_mask];
+    while(*link != NULL && *link != entry) {
+        link = &(*link)->next_in_bucket;
+    }
+    if(*link == NULL) {
+        return;
+    }
+    *link = entry->next_in_bucket;
+    shard->clock_slots[entry->clock_slot] = NULL;
+    file_cache_release(entry);
+}
+
+// Moves the clock hand around the shard until it finds a free slot or an entry which has not been used since the hand
+// last passed it, evicting that entry. Used entries have their referenced flag cleared as the hand goes past, so this
+// always finds a slot within two sweeps. The shard must be locked.
+static size_t claim_clock_slot(file_cache_shard_t *shard) {
+    while(true) {
+        size_t slot = shard->clock_hand;
+        shard->clock_hand = (shard->clock_hand + 1) % shard->capacity;
+
+        file_cache_entry_t *entry = shard->clock_slots[slot];
+        if(entry == NULL) {
+            return slot;
+        }
+        if(!atomic_exchange_explicit(&entry->referenced, false, memory_order_relaxed)) {
+            remove_entry(shard, entry);
+            return slot;
+        }
+    }
+}
+
+// Maps a file of up to mmap_max_size bytes into memory to send its body from there, with a single sendmsg for the
+// headers and the body together, instead of from the file with sendfile. Returns NULL if the file is not mapped, in
+// which case it is sent with sendfile as usual. MAP_POPULATE reads the whole file in and sets up the page tables for
+// it straight away, so no later request waits on a page fault. A file which is cut short while it is mapped does not
+// raise SIGBUS, since the pages past its new end are only ever touched by the kernel while copying them into the
+// socket, which fails the send with EFAULT instead and drops the connection like any other send error.
+// https://man7.org/linux/man-pages/man2/mmap.2.html
+static const char *map_file(int fd, size_t file_size, size_t mmap_max_size) {
+    if(mmap_max_size == MMAP_DISABLED || file_size == 0 || file_size > mmap_max_size) {
+        return NULL;
+    }
+    void *mapping = mmap(NULL, file_size, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+    if(mapping == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+    // Only a hint, which is turned down on kernels that cannot put file pages in huge pages, and the mapping works
+    // just the same without them. https://man7.org/linux/man-pages/man2/madvise.2.html
+    if(file_size >= HUGE_PAGE_SIZE) {
+        madvise(mapping, file_size, MADV_HUGEPAGE);
+    }
+    return (const char *) mapping;
+}
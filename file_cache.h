@@ -0,0 +1,103 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_FILE_CACHE_H
+#define COMP30023_2022_PROJECT_2_FILE_CACHE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "monotonic.h"
+#include "parse.h"
+#include "encoding.h"
+#include "stats.h"
+#include "web_root.h"
+
+#define FILE_CACHE_NUM_SHARDS 16
+#define FILE_CACHE_BUCKETS_PER_ENTRY 2
+#define FILE_CACHE_DISABLED 0
+#define MMAP_DISABLED 0
+// Mappings this big or bigger are worth asking transparent huge pages for, which cuts the TLB misses of copying the
+// whole file out of the mapping. https://www.kernel.org/doc/html/latest/admin-guide/mm/transhuge.html
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// A cached open file. The file descriptor is shared by every request for the same path, which is safe because
+// sendfile is always given its own offset and never moves the file position. Each entry is reference counted: the
+// cache holds one reference while the entry is in the table and every response being sent holds another, so a file
+// that gets evicted or invalidated mid-transfer is only closed once the last transfer using it has finished. Small
+// enough files are also mapped into memory (when mapping is turned on), and the mapping is shared and kept for just as
+// long, so a file that changes is only unmapped once nothing is sending from the old mapping.
+typedef struct file_cache_entry file_cache_entry_t;
+struct file_cache_entry {
+    char *request_path;
+    size_t request_path_length;
+    char *file_path;
+    uint64_t hash;
+    int fd;
+    struct stat file_stat;
+    const char *content_type;
+    content_encoding_t content_encoding;
+    const char *mapping;
+    atomic_int reference_count;
+    atomic_bool referenced;
+    _Atomic time_t last_validated;
+    size_t clock_slot;
+    file_cache_entry_t *next_in_bucket;
+};
+
+// One shard of the cache. Requests for paths in different shards never wait on each other. The clock slots hold every
+// entry in the shard and are swept by the clock hand to pick which entry to evict when the shard is full: entries
+// that have been used since the hand last passed get a second chance, everything else is evicted.
+typedef struct file_cache_shard file_cache_shard_t;
+struct file_cache_shard {
+    pthread_mutex_t lock;
+    file_cache_entry_t **buckets;
+    size_t bucket_mask;
+    file_cache_entry_t **clock_slots;
+    size_t capacity;
+    size_t clock_hand;
+};
+
+// A cache from request path to an open file descriptor along with the file's stat data and content type, so that a
+// repeated request does not need to build the file path, open the file or fstat it. A precompressed copy picked for a
+// client is cached apart from a request for the copy itself, since only the first is sent with an encoding. Entries
+// are checked against the file on disk with stat at most once every revalidate_interval seconds and replaced if the
+// file has changed. Files of up to mmap_max_size bytes are mapped into memory when they are opened, unless it is
+// MMAP_DISABLED.
+typedef struct file_cache file_cache_t;
+struct file_cache {
+    file_cache_shard_t shards[FILE_CACHE_NUM_SHARDS];
+    int revalidate_interval;
+    size_t mmap_max_size;
+};
+
+bool file_cache_init(file_cache_t *cache, size_t capacity, int revalidate_interval, size_t mmap_max_size);
+
+file_cache_entry_t *file_cache_acquire(file_cache_t *cache, string_view_t request_path,
+                                       content_encoding_t content_encoding);
+
+file_cache_entry_t *file_cache_find(file_cache_t *cache, string_view_t request_path,
+                                    content_encoding_t content_encoding);
+
+file_cache_entry_t *file_cache_add(file_cache_t *cache, string_view_t request_path,
+                                   content_encoding_t content_encoding, char *file_path, int fd,
+                                   struct stat *file_stat);
+
+void file_cache_release(file_cache_entry_t *entry);
+
+bool file_unchanged(struct stat *cached_stat, struct stat *current_stat);
+
+#endif //COMP30023_2022_PROJECT_2_FILE_CACHE_H
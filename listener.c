@@ -0,0 +1,103 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "listener.h"
+
+// Creates a socket listening on the port and IP version given on the command line, with the backlog from the
+// config. With reuse_port, the socket is one of several bound to the same port with SO_REUSEPORT, and the kernel
+// spreads incoming connections across all of them (https://man7.org/linux/man-pages/man7/socket.7.html). Those are
+// only used by event loop workers, so they are created non-blocking. A server started by an upgrade gets the sockets
+// of the server it is replacing back instead of opening new ones. Returns the socket, or NO_LISTENER if it could not
+// be set up.
+int open_listener(server_config_t *config, bool reuse_port) {
+    int sockfd = upgrade_take_listener(), s;
+    struct addrinfo hints, *res, *p;
+    if(sockfd != NO_INHERITED_LISTENER) {
+        return sockfd;
+    }
+
+    // Create address we're going to listen on (with given port number)
+    memset(&hints, 0, sizeof hints);
+
+    if(strcmp(config->ip_version, IPV4_ARG) == SAME_STRING) {
+        hints.ai_family = AF_INET; // IPv4
+    } else if (strcmp(config->ip_version, IPV6_ARG) == SAME_STRING) {
+        hints.ai_family = AF_INET6; // IPv6
+    }
+    hints.ai_socktype = SOCK_STREAM; // TCP
+    hints.ai_flags = AI_PASSIVE;     // for bind, listen, accept
+
+    // node (NULL means any interface), service (port), hints, res.
+    s = getaddrinfo(NULL, config->port_number, &hints, &res);
+    if (s != 0) {
+        fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(s));
+        return NO_LISTENER;
+    }
+
+    // The code used in the if statement was referenced and modified from COMP30023 Week 8 Lecture 2 Lecture Slide 13
+    // "Create IPv6 Socket". getaddrinfo returns multiple addresses in a linked list as mentioned in COMP30023
+    // Week 8 Lecture 2. Hence, if we want a IPv6 address, we need to use a for loop to step through the
+    // linked list returned (res) and find a valid IPv6 address to use to create a socket. SOCK_CLOEXEC keeps the
+    // socket from leaking into anything the server executes. https://man7.org/linux/man-pages/man2/socket.2.html
+    // The thread and pool modes wait for connections with poll when upgrades are enabled, so their socket is
+    // non-blocking too, in case another server takes a connection between the poll and the accept.
+    bool poll_before_accept = upgrade_enabled() &&
+            (config->serving_mode == SERVING_MODE_THREAD || config->serving_mode == SERVING_MODE_POOL);
+    int socket_flags = SOCK_CLOEXEC | (reuse_port || poll_before_accept ? SOCK_NONBLOCK : 0);
+    for (p = res; p != NULL; p = p->ai_next) {
+        // hints.ai_family contains the IP address type that we want (AF_INET or AF_INET6). Check that the current
+        // address in this node of the linked list corresponds to the address family stored in hints.ai_family.
+        if (p->ai_family == hints.ai_family) {
+            // We attempt to create a socket from this address. If socket creation was successful, we can use
+            // this socket, so we break out of the loop. Otherwise, we keep trying with remaining addresses until
+            // we run out.
+            if ((sockfd = socket(p->ai_family, p->ai_socktype | socket_flags, p->ai_protocol)) >= 0) {
+                break;
+            }
+        }
+    }
+
+    // If no sockets were successfully created (either IPv6 or IPv4)
+    if (sockfd < 0) {
+        perror("socket");
+        freeaddrinfo(res);
+        return NO_LISTENER;
+    }
+
+    // Reuse port if possible. This piece of code was provided in COMP30023 Project 2 Spec. Similar code was included
+    // in server.c from COMP30023 Week 9 Practicals but was replaced with this.
+    int enable = 1;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(int)) < 0) {
+        perror("setsockopt");
+        close(sockfd);
+        freeaddrinfo(res);
+        return NO_LISTENER;
+    }
+    // Every socket sharing the port has to set SO_REUSEPORT before it is bound.
+    if (reuse_port && setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(int)) < 0) {
+        perror("setsockopt");
+        close(sockfd);
+        freeaddrinfo(res);
+        return NO_LISTENER;
+    }
+
+    // Bind the address the socket was created for to the socket
+    if (bind(sockfd, p->ai_addr, p->ai_addrlen) < 0) {
+        perror("bind");
+        close(sockfd);
+        freeaddrinfo(res);
+        return NO_LISTENER;
+    }
+    freeaddrinfo(res);
+
+    // Listen on socket - means we're ready to accept connections,
+    // incoming connection requests will be queued, man 3 listen. The backlog is how many connections the kernel
+    // will hold on to until they are accepted, past which new ones are dropped.
+    if (listen(sockfd, config->listen_backlog) < 0) {
+        perror("listen");
+        close(sockfd);
+        return NO_LISTENER;
+    }
+    upgrade_add_listener(sockfd);
+    return sockfd;
+}
@@ -0,0 +1,25 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_LISTENER_H
+#define COMP30023_2022_PROJECT_2_LISTENER_H
+
+#include <netdb.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <sys/socket.h>
+
+#include "config.h"
+#include "upgrade.h"
+
+#define IPV4_ARG "4"
+#define IPV6_ARG "6"
+
+#define NO_LISTENER -1
+
+int open_listener(server_config_t *config, bool reuse_port);
+
+#endif //COMP30023_2022_PROJECT_2_LISTENER_H
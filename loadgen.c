@@ -0,0 +1,712 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "loadgen.h"
+
+static void start_request(load_thread_t *thread, client_t *client);
+static bool open_connection(load_thread_t *thread, client_t *client);
+static void close_connection(load_thread_t *thread, client_t *client);
+static void handle_client_event(load_thread_t *thread, client_t *client);
+static bool send_request(load_thread_t *thread, client_t *client);
+static bool receive_response(load_thread_t *thread, client_t *client, char *buffer, bool *complete);
+static bool handle_response_bytes(client_t *client, char *bytes, size_t length, bool *complete);
+static void complete_request(load_thread_t *thread, client_t *client);
+static void fail_request(load_thread_t *thread, client_t *client);
+static bool watch_client(load_thread_t *thread, client_t *client, uint32_t events, int operation);
+static mix_entry_t *pick_entry(load_thread_t *thread);
+static bool record_latency(load_thread_t *thread, long latency);
+static bool add_mix_entry(loadgen_config_t *config, char *path, int weight, int *capacity);
+static char *find_json_string(char *line, char *key);
+static bool find_json_number(char *line, char *key, long *number);
+static int compare_latencies(const void *a, const void *b);
+static long now_nanoseconds(void);
+
+// The files --make-web-root generates, and how often the default request mix asks for each of them.
+static const web_root_file_t web_root_files[] = {
+    {"/index.html", 1024, 50},
+    {"/style.css", 8 * 1024, 25},
+    {"/app.js", 64 * 1024, 15},
+    {"/photo.jpg", 512 * 1024, 9},
+    {"/large.jpg", 4 * 1024 * 1024, 1}
+};
+
+static const struct option long_options[] = {
+    {"connections", required_argument, NULL, 'c'},
+    {"threads", required_argument, NULL, 't'},
+    {"duration", required_argument, NULL, 'd'},
+    {"new-connections", no_argument, NULL, 'n'},
+    {"requests", required_argument, NULL, 'r'},
+    {"make-web-root", required_argument, NULL, MAKE_WEB_ROOT_OPTION},
+    {NULL, 0, NULL, 0}
+};
+
+// HTTP load generator for benchmarking the server over loopback. Keeps a fixed number of client connections busy for
+// a fixed time, each sending a request, reading the whole response and then sending the next one, either on the same
+// persistent connection or on a new connection every time. Requests are picked at random from a weighted mix, which
+// is either the files that --make-web-root generates or one read from a JSONL file. At the end it prints the request
+// rate, transfer rate and latency percentiles. Run with "make bench", or see print_usage for running it directly.
+int main(int argc, char **argv) {
+    loadgen_config_t config;
+
+    if(!parse_loadgen_config(argc, argv, &config)) {
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if(config.web_root_path != NULL) {
+        return make_web_root(config.web_root_path) ? 0 : EXIT_FAILURE;
+    }
+    if(!load_request_mix(&config) || !build_requests(&config)) {
+        exit(EXIT_FAILURE);
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int result = getaddrinfo(config.host, config.port, &hints, &config.address);
+    if(result != 0) {
+        fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(result));
+        exit(EXIT_FAILURE);
+    }
+
+    load_thread_t *threads = (load_thread_t *) calloc (config.num_threads, sizeof(load_thread_t));
+    if(threads == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    long start_time = now_nanoseconds();
+    long end_time = start_time + config.duration * NANOSECONDS_PER_SECOND;
+    for(int i = 0; i < config.num_threads; i++) {
+        threads[i].config = &config;
+        threads[i].end_time = end_time;
+        threads[i].random_state = (unsigned int) (start_time + i);
+        // Spread the connections as evenly as possible over the threads.
+        threads[i].num_clients = config.num_connections / config.num_threads +
+                (i < config.num_connections % config.num_threads);
+        if(pthread_create(&threads[i].thread_id, NULL, load_thread, (void *) &threads[i]) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for(int i = 0; i < config.num_threads; i++) {
+        pthread_join(threads[i].thread_id, NULL);
+    }
+
+    print_results(&config, threads, now_nanoseconds() - start_time);
+    return 0;
+}
+
+// Takes the command line arguments and fills in the loadgen_config struct passed in. The host and port are required
+// unless --make-web-root is given. Returns true if the arguments make sense; false otherwise.
+bool parse_loadgen_config(int argc, char **argv, loadgen_config_t *config) {
+    int option;
+
+    memset(config, 0, sizeof(loadgen_config_t));
+    config->num_connections = DEFAULT_CONNECTIONS;
+    config->num_threads = DEFAULT_THREADS;
+    config->duration = DEFAULT_DURATION;
+
+    while((option = getopt_long(argc, argv, "c:t:d:nr:", long_options, NULL)) != -1) {
+        switch(option) {
+            case 'c':
+                config->num_connections = atoi(optarg);
+                if(config->num_connections <= 0) {
+                    fprintf(stderr, "ERROR, connections must be positive.\n");
+                    return false;
+                }
+                break;
+            case 't':
+                config->num_threads = atoi(optarg);
+                if(config->num_threads <= 0) {
+                    fprintf(stderr, "ERROR, threads must be positive.\n");
+                    return false;
+                }
+                break;
+            case 'd':
+                config->duration = atoi(optarg);
+                if(config->duration <= 0) {
+                    fprintf(stderr, "ERROR, duration must be positive.\n");
+                    return false;
+                }
+                break;
+            case 'n':
+                config->new_connection_per_request = true;
+                break;
+            case 'r':
+                config->mix_file_path = optarg;
+                break;
+            case MAKE_WEB_ROOT_OPTION:
+                config->web_root_path = optarg;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    if(argc - optind != NUM_POSITIONAL_ARGS) {
+        fprintf(stderr, "ERROR, expected a host and a port.\n");
+        return false;
+    }
+    config->host = argv[optind];
+    config->port = argv[optind + 1];
+    if(config->num_threads > config->num_connections) {
+        config->num_threads = config->num_connections;
+    }
+    return true;
+}
+
+// Prints out how the load generator is supposed to be run.
+void print_usage(char *program_name) {
+    fprintf(stderr, "Usage: %s [options] <host> <port>\n", program_name);
+    fprintf(stderr, "       %s --make-web-root <directory>\n", program_name);
+    fprintf(stderr, "  -c, --connections <n>    concurrent connections (default %d)\n", DEFAULT_CONNECTIONS);
+    fprintf(stderr, "  -t, --threads <n>        load generating threads (default %d)\n", DEFAULT_THREADS);
+    fprintf(stderr, "  -d, --duration <s>       seconds to run for (default %d)\n", DEFAULT_DURATION);
+    fprintf(stderr, "  -n, --new-connections    open a new connection for every request instead of keeping them "
+                    "alive\n");
+    fprintf(stderr, "  -r, --requests <file>    JSONL request mix, one {\"path\": ..., \"weight\": ...} per line "
+                    "(default the generated web root)\n");
+    fprintf(stderr, "      --make-web-root <directory>  write the files of the default request mix and exit\n");
+}
+
+// Writes every file of the default request mix into the web root directory, creating it if necessary. The contents
+// are just repeated text, since the server never looks at them.
+bool make_web_root(char *web_root_path) {
+    if(mkdir(web_root_path, WEB_ROOT_DIRECTORY_MODE) < 0 && errno != EEXIST) {
+        perror("mkdir");
+        return false;
+    }
+
+    for(size_t i = 0; i < sizeof(web_root_files) / sizeof(web_root_files[0]); i++) {
+        const web_root_file_t *file = &web_root_files[i];
+        size_t path_length = strlen(web_root_path) + strlen(file->path) + NULL_TERMINATOR_SPACE;
+        char *file_path = (char *) malloc (path_length);
+        char *contents = (char *) malloc (file->size);
+        if(file_path == NULL || contents == NULL) {
+            perror("malloc");
+            return false;
+        }
+        snprintf(file_path, path_length, "%s%s", web_root_path, file->path);
+        for(size_t j = 0; j < file->size; j++) {
+            contents[j] = (char) ('a' + j % 26);
+        }
+
+        int fd = open(file_path, O_WRONLY | O_CREAT | O_TRUNC, WEB_ROOT_FILE_MODE);
+        if(fd < 0) {
+            perror("open");
+            return false;
+        }
+        size_t written = 0;
+        while(written < file->size) {
+            ssize_t n = write(fd, contents + written, file->size - written);
+            if(n < 0) {
+                perror("write");
+                close(fd);
+                return false;
+            }
+            written += n;
+        }
+        close(fd);
+        free(contents);
+        free(file_path);
+    }
+    return true;
+}
+
+// Fills in the request mix, either from the JSONL file or from the files that --make-web-root generates. Each line
+// of the file is a JSON object, and only its "path" (required) and "weight" (default 1) keys are looked at, so lines
+// can carry anything else alongside them. Lines without a path are skipped. Returns false if the file could not be
+// read or had no requests in it.
+bool load_request_mix(loadgen_config_t *config) {
+    int capacity = 0;
+
+    if(config->mix_file_path == NULL) {
+        for(size_t i = 0; i < sizeof(web_root_files) / sizeof(web_root_files[0]); i++) {
+            if(!add_mix_entry(config, strdup(web_root_files[i].path), web_root_files[i].weight, &capacity)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    FILE *mix_file = fopen(config->mix_file_path, "r");
+    if(mix_file == NULL) {
+        perror("fopen");
+        return false;
+    }
+    char *line = (char *) malloc (MAX_MIX_LINE_LENGTH);
+    if(line == NULL) {
+        perror("malloc");
+        fclose(mix_file);
+        return false;
+    }
+    while(fgets(line, MAX_MIX_LINE_LENGTH, mix_file) != NULL) {
+        char *path = find_json_string(line, PATH_KEY);
+        long weight = DEFAULT_MIX_WEIGHT;
+        if(path == NULL) {
+            continue;
+        }
+        if(find_json_number(line, WEIGHT_KEY, &weight) && weight <= 0) {
+            free(path);
+            continue;
+        }
+        if(!add_mix_entry(config, path, (int) weight, &capacity)) {
+            free(line);
+            fclose(mix_file);
+            return false;
+        }
+    }
+    free(line);
+    fclose(mix_file);
+
+    if(config->mix_size == 0) {
+        fprintf(stderr, "ERROR, no requests with a \"path\" in %s.\n", config->mix_file_path);
+        return false;
+    }
+    return true;
+}
+
+// Writes out the request that is sent for every entry in the mix. Requests are HTTP/1.1, which keeps the connection
+// alive by default, and ask for the connection to be closed when every request gets a new connection.
+bool build_requests(loadgen_config_t *config) {
+    char *connection_header = config->new_connection_per_request ? "Connection: close\r\n" : "";
+
+    for(int i = 0; i < config->mix_size; i++) {
+        mix_entry_t *entry = &config->mix[i];
+        int length = snprintf(NULL, 0, "GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: loadgen\r\n%s\r\n",
+                              entry->path, config->host, connection_header);
+        entry->request = (char *) malloc (length + NULL_TERMINATOR_SPACE);
+        if(entry->request == NULL) {
+            perror("malloc");
+            return false;
+        }
+        snprintf(entry->request, length + NULL_TERMINATOR_SPACE, "GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: "
+                 "loadgen\r\n%s\r\n", entry->path, config->host, connection_header);
+        entry->request_length = length;
+    }
+    return true;
+}
+
+// Function that is passed into pthread_create for each load generating thread. Starts a request on each of its
+// clients and then handles their events until the run is over.
+void *load_thread(void *load_thread_args) {
+    load_thread_t *thread = (load_thread_t *) load_thread_args;
+    struct epoll_event events[MAX_EVENTS];
+
+    thread->epollfd = epoll_create1(EPOLL_CLOEXEC);
+    thread->clients = (client_t *) calloc (thread->num_clients, sizeof(client_t));
+    thread->latencies = (long *) malloc (INITIAL_LATENCY_CAPACITY * sizeof(long));
+    thread->latency_capacity = INITIAL_LATENCY_CAPACITY;
+    if(thread->epollfd < 0 || thread->clients == NULL || thread->latencies == NULL) {
+        perror("load_thread");
+        return NULL;
+    }
+
+    for(int i = 0; i < thread->num_clients; i++) {
+        thread->clients[i].sockfd = NO_SOCKET;
+        start_request(thread, &thread->clients[i]);
+    }
+    while(now_nanoseconds() < thread->end_time) {
+        int num_events = epoll_wait(thread->epollfd, events, MAX_EVENTS, EPOLL_WAIT_TIMEOUT_MS);
+        if(num_events < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for(int i = 0; i < num_events; i++) {
+            handle_client_event(thread, (client_t *) events[i].data.ptr);
+        }
+    }
+
+    for(int i = 0; i < thread->num_clients; i++) {
+        if(thread->clients[i].sockfd != NO_SOCKET) {
+            close(thread->clients[i].sockfd);
+        }
+    }
+    free(thread->clients);
+    close(thread->epollfd);
+    return NULL;
+}
+
+// Adds up the results of every thread and prints them. Latency percentiles are nearest-rank over every request that
+// completed during the run.
+void print_results(loadgen_config_t *config, load_thread_t *threads, long elapsed) {
+    long requests = 0;
+    long errors = 0;
+    long unsuccessful_responses = 0;
+    long bytes_received = 0;
+    size_t num_latencies = 0;
+
+    for(int i = 0; i < config->num_threads; i++) {
+        requests += threads[i].requests;
+        errors += threads[i].errors;
+        unsuccessful_responses += threads[i].unsuccessful_responses;
+        bytes_received += threads[i].bytes_received;
+        num_latencies += threads[i].num_latencies;
+    }
+    long *latencies = (long *) malloc ((num_latencies + 1) * sizeof(long));
+    if(latencies == NULL) {
+        perror("malloc");
+        return;
+    }
+    size_t offset = 0;
+    for(int i = 0; i < config->num_threads; i++) {
+        memcpy(latencies + offset, threads[i].latencies, threads[i].num_latencies * sizeof(long));
+        offset += threads[i].num_latencies;
+    }
+    qsort(latencies, num_latencies, sizeof(long), compare_latencies);
+
+    double seconds = (double) elapsed / NANOSECONDS_PER_SECOND;
+    printf("%d connections, %d threads, %d s, %s\n", config->num_connections, config->num_threads,
+           config->duration, config->new_connection_per_request ? "new connection per request" : "keep-alive");
+    printf("  requests    %ld (%.1f/s)\n", requests, requests / seconds);
+    printf("  errors      %ld\n", errors);
+    printf("  non-2xx     %ld\n", unsuccessful_responses);
+    printf("  received    %.1f MB (%.1f MB/s)\n", bytes_received / BYTES_PER_MEGABYTE,
+           bytes_received / BYTES_PER_MEGABYTE / seconds);
+    if(num_latencies > 0) {
+        double percentiles[] = {0.5, 0.99, 0.999};
+        char *names[] = {"p50", "p99", "p999"};
+        for(int i = 0; i < 3; i++) {
+            size_t rank = (size_t) (percentiles[i] * num_latencies + 0.999999);
+            size_t index = rank == 0 ? 0 : rank - 1;
+            printf("  latency %-4s %.3f ms\n", names[i], latencies[index] / NANOSECONDS_PER_MILLISECOND);
+        }
+        printf("  latency max  %.3f ms\n", latencies[num_latencies - 1] / NANOSECONDS_PER_MILLISECOND);
+    }
+    free(latencies);
+}
+
+// Starts the client's next request, opening a new connection first if it does not have one. A client whose
+// connection cannot even be started (say the server is not running) sits out the rest of the run.
+static void start_request(load_thread_t *thread, client_t *client) {
+    client->entry = pick_entry(thread);
+    client->bytes_sent = 0;
+    client->header_length = 0;
+    client->headers_received = false;
+    client->content_length = NO_CONTENT_LENGTH;
+    client->body_received = 0;
+    client->start_time = now_nanoseconds();
+
+    if(client->sockfd == NO_SOCKET) {
+        if(!open_connection(thread, client)) {
+            thread->errors++;
+        }
+        return;
+    }
+    client->state = CLIENT_SENDING;
+    if(!send_request(thread, client)) {
+        fail_request(thread, client);
+    }
+}
+
+// Opens a non-blocking connection to the server and waits for it to be established. Nagle's algorithm is turned off
+// so that requests go out straight away. https://man7.org/linux/man-pages/man2/connect.2.html
+static bool open_connection(load_thread_t *thread, client_t *client) {
+    struct addrinfo *address = thread->config->address;
+    int enable = 1;
+
+    client->sockfd = socket(address->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(client->sockfd < 0) {
+        perror("socket");
+        return false;
+    }
+    setsockopt(client->sockfd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof enable);
+    if(connect(client->sockfd, address->ai_addr, address->ai_addrlen) < 0 && errno != EINPROGRESS) {
+        close_connection(thread, client);
+        return false;
+    }
+    client->state = CLIENT_CONNECTING;
+    if(!watch_client(thread, client, EPOLLOUT, EPOLL_CTL_ADD)) {
+        close_connection(thread, client);
+        return false;
+    }
+    return true;
+}
+
+// Closes the client's connection, which also removes it from the epoll instance.
+static void close_connection(load_thread_t *thread, client_t *client) {
+    close(client->sockfd);
+    client->sockfd = NO_SOCKET;
+}
+
+// Moves the client along when its socket is ready.
+static void handle_client_event(load_thread_t *thread, client_t *client) {
+    char buffer[RECEIVE_BUFFER_SIZE];
+    bool complete = false;
+
+    if(client->state == CLIENT_CONNECTING) {
+        int error = 0;
+        socklen_t error_length = sizeof error;
+        if(getsockopt(client->sockfd, SOL_SOCKET, SO_ERROR, &error, &error_length) < 0 || error != 0) {
+            fail_request(thread, client);
+            return;
+        }
+        client->state = CLIENT_SENDING;
+        if(!send_request(thread, client)) {
+            fail_request(thread, client);
+        }
+        return;
+    }
+    if(client->state == CLIENT_SENDING) {
+        if(!send_request(thread, client)) {
+            fail_request(thread, client);
+        }
+        return;
+    }
+
+    if(!receive_response(thread, client, buffer, &complete)) {
+        fail_request(thread, client);
+    } else if(complete) {
+        complete_request(thread, client);
+    }
+}
+
+// Sends as much of the request as the socket will take, and starts waiting for the response once all of it has gone.
+static bool send_request(load_thread_t *thread, client_t *client) {
+    mix_entry_t *entry = client->entry;
+
+    while(client->bytes_sent < entry->request_length) {
+        ssize_t n = send(client->sockfd, entry->request + client->bytes_sent,
+                         entry->request_length - client->bytes_sent, MSG_NOSIGNAL);
+        if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return watch_client(thread, client, EPOLLOUT, EPOLL_CTL_MOD);
+        }
+        if(n < 0) {
+            return false;
+        }
+        client->bytes_sent += n;
+    }
+    client->state = CLIENT_RECEIVING;
+    return watch_client(thread, client, EPOLLIN, EPOLL_CTL_MOD);
+}
+
+// Reads everything that is waiting on the socket, setting complete once the whole response has arrived. A response
+// without a Content-Length ends when the server closes the connection. Returns false if the connection failed.
+static bool receive_response(load_thread_t *thread, client_t *client, char *buffer, bool *complete) {
+    while(!*complete) {
+        ssize_t n = recv(client->sockfd, buffer, RECEIVE_BUFFER_SIZE, 0);
+        if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if(n < 0) {
+            return false;
+        }
+        if(n == 0) {
+            *complete = client->headers_received && client->content_length == NO_CONTENT_LENGTH;
+            client->server_keep_alive = false;
+            return *complete;
+        }
+        thread->bytes_received += n;
+        if(!handle_response_bytes(client, buffer, n, complete)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Takes in bytes of the response. The headers are collected until the blank line that ends them, and then looked
+// through for the status code, Content-Length and whether the server is closing the connection. Everything after the
+// headers is body, which is only counted. Returns false if the headers are too long or malformed.
+static bool handle_response_bytes(client_t *client, char *bytes, size_t length, bool *complete) {
+    if(!client->headers_received) {
+        size_t copied = length < RESPONSE_HEADER_MAX_SIZE - client->header_length ?
+                length : RESPONSE_HEADER_MAX_SIZE - client->header_length;
+        memcpy(client->headers + client->header_length, bytes, copied);
+        client->header_length += copied;
+        client->headers[client->header_length] = '\0';
+
+        char *header_end = strstr(client->headers, HEADER_END);
+        if(header_end == NULL) {
+            return client->header_length < RESPONSE_HEADER_MAX_SIZE;
+        }
+        size_t headers_length = header_end - client->headers + strlen(HEADER_END);
+        // Whatever came in after the headers (in this read) is the start of the body.
+        size_t body_bytes = client->header_length - headers_length + (length - copied);
+        *header_end = '\0';
+
+        if(client->header_length < STATUS_CODE_OFFSET) {
+            return false;
+        }
+        client->status_code = atoi(client->headers + STATUS_CODE_OFFSET);
+        char *content_length = strcasestr(client->headers, CONTENT_LENGTH_HEADER);
+        if(content_length != NULL) {
+            client->content_length = strtol(content_length + strlen(CONTENT_LENGTH_HEADER), NULL, 10);
+        }
+        client->server_keep_alive = strcasestr(client->headers, CONNECTION_CLOSE_HEADER) == NULL;
+        client->headers_received = true;
+        client->body_received = (long) body_bytes;
+    } else {
+        client->body_received += (long) length;
+    }
+
+    *complete = client->content_length != NO_CONTENT_LENGTH && client->body_received >= client->content_length;
+    return true;
+}
+
+// Records the finished request and starts the next one, on the same connection if both sides are keeping it alive.
+// Requests that finish after the end of the run are not counted.
+static void complete_request(load_thread_t *thread, client_t *client) {
+    long now = now_nanoseconds();
+
+    if(now < thread->end_time) {
+        thread->requests++;
+        if(client->status_code < MIN_SUCCESS_STATUS || client->status_code > MAX_SUCCESS_STATUS) {
+            thread->unsuccessful_responses++;
+        }
+        record_latency(thread, now - client->start_time);
+    }
+    if(thread->config->new_connection_per_request || !client->server_keep_alive) {
+        close_connection(thread, client);
+    }
+    start_request(thread, client);
+}
+
+// Counts the request as an error and starts the next one on a new connection.
+static void fail_request(load_thread_t *thread, client_t *client) {
+    if(now_nanoseconds() < thread->end_time) {
+        thread->errors++;
+    }
+    if(client->sockfd != NO_SOCKET) {
+        close_connection(thread, client);
+    }
+    start_request(thread, client);
+}
+
+// Sets which events the client's socket is watched for.
+static bool watch_client(load_thread_t *thread, client_t *client, uint32_t events, int operation) {
+    struct epoll_event event;
+    event.events = events;
+    event.data.ptr = client;
+    if(epoll_ctl(thread->epollfd, operation, client->sockfd, &event) < 0) {
+        perror("epoll_ctl");
+        return false;
+    }
+    return true;
+}
+
+// Picks an entry from the mix at random in proportion to the weights, by binary searching the cumulative weights.
+static mix_entry_t *pick_entry(load_thread_t *thread) {
+    loadgen_config_t *config = thread->config;
+    int total_weight = config->mix[config->mix_size - 1].cumulative_weight;
+    int target = rand_r(&thread->random_state) % total_weight;
+    int low = 0;
+    int high = config->mix_size - 1;
+
+    while(low < high) {
+        int middle = (low + high) / 2;
+        if(config->mix[middle].cumulative_weight > target) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return &config->mix[low];
+}
+
+// Adds a latency to the thread's list, growing it as needed.
+static bool record_latency(load_thread_t *thread, long latency) {
+    if(thread->num_latencies == thread->latency_capacity) {
+        long *latencies = (long *) realloc (thread->latencies, 2 * thread->latency_capacity * sizeof(long));
+        if(latencies == NULL) {
+            perror("realloc");
+            return false;
+        }
+        thread->latencies = latencies;
+        thread->latency_capacity *= 2;
+    }
+    thread->latencies[thread->num_latencies++] = latency;
+    return true;
+}
+
+// Adds a request for path to the mix, taking ownership of path.
+static bool add_mix_entry(loadgen_config_t *config, char *path, int weight, int *capacity) {
+    if(path == NULL) {
+        perror("strdup");
+        return false;
+    }
+    if(config->mix_size == *capacity) {
+        int new_capacity = *capacity == 0 ? 16 : 2 * *capacity;
+        mix_entry_t *mix = (mix_entry_t *) realloc (config->mix, new_capacity * sizeof(mix_entry_t));
+        if(mix == NULL) {
+            perror("realloc");
+            free(path);
+            return false;
+        }
+        config->mix = mix;
+        *capacity = new_capacity;
+    }
+
+    mix_entry_t *entry = &config->mix[config->mix_size];
+    entry->path = path;
+    entry->weight = weight;
+    entry->cumulative_weight = weight;
+    if(config->mix_size > 0) {
+        entry->cumulative_weight += config->mix[config->mix_size - 1].cumulative_weight;
+    }
+    entry->request = NULL;
+    entry->request_length = 0;
+    config->mix_size++;
+    return true;
+}
+
+// Returns a copy of the string value of key in a line of JSON, with backslash escapes reduced to the character they
+// escape, or NULL if the key is not there. This is only enough JSON for request mix files, not a general parser.
+static char *find_json_string(char *line, char *key) {
+    char *value = strstr(line, key);
+    if(value == NULL) {
+        return NULL;
+    }
+    value += strlen(key);
+    value += strspn(value, " \t");
+    if(*value != ':') {
+        return NULL;
+    }
+    value++;
+    value += strspn(value, " \t");
+    if(*value != '"') {
+        return NULL;
+    }
+    value++;
+
+    char *string = (char *) malloc (strlen(value) + NULL_TERMINATOR_SPACE);
+    if(string == NULL) {
+        return NULL;
+    }
+    size_t length = 0;
+    while(*value != '"' && *value != '\0') {
+        if(*value == '\\' && value[1] != '\0') {
+            value++;
+        }
+        string[length++] = *value++;
+    }
+    string[length] = '\0';
+    return string;
+}
+
+// Finds the number value of key in a line of JSON. Returns false if the key is not there.
+static bool find_json_number(char *line, char *key, long *number) {
+    char *value = strstr(line, key);
+    if(value == NULL) {
+        return false;
+    }
+    value += strlen(key);
+    value += strspn(value, " \t");
+    if(*value != ':') {
+        return false;
+    }
+    *number = strtol(value + 1, NULL, 10);
+    return true;
+}
+
+static int compare_latencies(const void *a, const void *b) {
+    long first = *(const long *) a;
+    long second = *(const long *) b;
+    return (first > second) - (first < second);
+}
+
+// Returns the time on the monotonic clock in nanoseconds.
+static long now_nanoseconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NANOSECONDS_PER_SECOND + now.tv_nsec;
+}
@@ -0,0 +1,163 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_LOADGEN_H
+#define COMP30023_2022_PROJECT_2_LOADGEN_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define DEFAULT_CONNECTIONS 64
+#define DEFAULT_THREADS 1
+#define DEFAULT_DURATION 10
+#define NUM_POSITIONAL_ARGS 2
+#define SAME_STRING 0
+
+#define MAX_EVENTS 256
+#define EPOLL_WAIT_TIMEOUT_MS 100
+#define RECEIVE_BUFFER_SIZE 65536
+#define RESPONSE_HEADER_MAX_SIZE 8192
+#define NULL_TERMINATOR_SPACE 1
+#define INITIAL_LATENCY_CAPACITY 65536
+#define NANOSECONDS_PER_SECOND 1000000000L
+#define NANOSECONDS_PER_MILLISECOND 1000000.0
+#define BYTES_PER_MEGABYTE (1024.0 * 1024.0)
+#define NO_SOCKET -1
+#define NO_CONTENT_LENGTH -1
+
+#define MAX_MIX_LINE_LENGTH 65536
+#define DEFAULT_MIX_WEIGHT 1
+#define PATH_KEY "\"path\""
+#define WEIGHT_KEY "\"weight\""
+
+#define HEADER_END "\r\n\r\n"
+#define CONTENT_LENGTH_HEADER "\r\nContent-Length:"
+#define CONNECTION_CLOSE_HEADER "\r\nConnection: close"
+#define STATUS_CODE_OFFSET 9
+#define MIN_SUCCESS_STATUS 200
+#define MAX_SUCCESS_STATUS 299
+
+#define WEB_ROOT_FILE_MODE 0644
+#define WEB_ROOT_DIRECTORY_MODE 0755
+
+// Options which only have a long form.
+enum long_only_option {
+    MAKE_WEB_ROOT_OPTION = 256
+};
+
+// One kind of request in the mix, with the request text that is sent for it. Requests are picked at random in
+// proportion to their weights.
+typedef struct mix_entry mix_entry_t;
+struct mix_entry {
+    char *path;
+    int weight;
+    int cumulative_weight;
+    char *request;
+    size_t request_length;
+};
+
+// A file in the web root that --make-web-root generates. The default request mix asks for these in proportion to
+// their weights, so that most requests are for small files like on a real site.
+typedef struct web_root_file web_root_file_t;
+struct web_root_file {
+    char *path;
+    size_t size;
+    int weight;
+};
+
+// Everything that was passed in on the command line, along with the request mix and the server's address.
+typedef struct loadgen_config loadgen_config_t;
+struct loadgen_config {
+    char *host;
+    char *port;
+    int num_connections;
+    int num_threads;
+    int duration;
+    bool new_connection_per_request;
+    char *mix_file_path;
+    char *web_root_path;
+    mix_entry_t *mix;
+    int mix_size;
+    struct addrinfo *address;
+};
+
+// Where a client connection is up to with its current request.
+typedef enum client_state {
+    CLIENT_CONNECTING,
+    CLIENT_SENDING,
+    CLIENT_RECEIVING
+} client_state_t;
+
+// One of the simulated clients. Each has at most one request in flight, and the time from starting the request
+// (including connecting, if it needs a new connection) to receiving the last byte of the response is its latency.
+typedef struct client client_t;
+struct client {
+    int sockfd;
+    client_state_t state;
+    mix_entry_t *entry;
+    size_t bytes_sent;
+    char headers[RESPONSE_HEADER_MAX_SIZE + NULL_TERMINATOR_SPACE];
+    size_t header_length;
+    bool headers_received;
+    long content_length;
+    long body_received;
+    int status_code;
+    bool server_keep_alive;
+    long start_time;
+};
+
+// A load generating thread, which drives its share of the clients from its own epoll instance and keeps its own
+// results until they are added up at the end.
+typedef struct load_thread load_thread_t;
+struct load_thread {
+    pthread_t thread_id;
+    loadgen_config_t *config;
+    int epollfd;
+    client_t *clients;
+    int num_clients;
+    unsigned int random_state;
+    long end_time;
+    long *latencies;
+    size_t num_latencies;
+    size_t latency_capacity;
+    long requests;
+    long errors;
+    long unsuccessful_responses;
+    long bytes_received;
+};
+
+bool parse_loadgen_config(int argc, char **argv, loadgen_config_t *config);
+
+void print_usage(char *program_name);
+
+bool make_web_root(char *web_root_path);
+
+bool load_request_mix(loadgen_config_t *config);
+
+bool build_requests(loadgen_config_t *config);
+
+void *load_thread(void *load_thread_args);
+
+void print_results(loadgen_config_t *config, load_thread_t *threads, long elapsed);
+
+#endif //COMP30023_2022_PROJECT_2_LOADGEN_H
@@ -0,0 +1,23 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "mime.h"
+// The table is generated from mime.types by mime_table_gen when the server is built, and is only included here so
+// that there is just the one copy of it.
+#include "mime_table.h"
+
+// Returns the content type of files with the extension (without its '.'), or DEFAULT_CONTENT_TYPE if it is not in
+// mime.types. The table is a perfect hash, so the extension can only ever be in the one slot its hash picks, and
+// finding its content type takes a single hash and comparison however many types there are.
+const char *get_extension_content_type(string_view_t extension) {
+    if(extension.length == 0 || extension.length > MIME_EXTENSION_MAX_LENGTH) {
+        return DEFAULT_CONTENT_TYPE;
+    }
+    const mime_table_entry_t *entry =
+            &mime_table[hash_extension(extension, MIME_TABLE_SEED) >> (HASH_BITS - MIME_TABLE_BITS)];
+    if(entry->extension != NULL && entry->extension_length == extension.length &&
+            strncasecmp(entry->extension, extension.data, extension.length) == SAME_STRING) {
+        return entry->content_type;
+    }
+    return DEFAULT_CONTENT_TYPE;
+}
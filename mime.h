@@ -0,0 +1,31 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_MIME_H
+#define COMP30023_2022_PROJECT_2_MIME_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "parse.h"
+
+#define DEFAULT_CONTENT_TYPE "application/octet-stream"
+#define HASH_BITS 64
+
+// A slot of the MIME table, which is empty if extension is NULL. The extension is stored without its '.' and in lower
+// case.
+typedef struct mime_table_entry mime_table_entry_t;
+struct mime_table_entry {
+    const char *extension;
+    size_t extension_length;
+    const char *content_type;
+};
+
+const char *get_extension_content_type(string_view_t extension);
+
+#endif //COMP30023_2022_PROJECT_2_MIME_H
@@ -0,0 +1,200 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "mime_table_gen.h"
+
+static bool add_extension(mime_extension_t *extensions, size_t *num_extensions, const char *extension,
+                          char *content_type);
+
+// Turns a mime.types file into mime_table.h, the server's table of content types by file extension. The table is a
+// perfect hash: a seed for hash_extension is searched for which puts every extension in a slot of its own, so the
+// server finds a content type with one hash and one comparison, without ever probing past a collision. The table is
+// written under a temporary name and renamed into place, so a failed run never leaves half a table behind for the
+// build to pick up.
+int main(int argc, char **argv) {
+    if(argc != NUM_ARGS) {
+        fprintf(stderr, "Usage: %s <mime.types path> <output header path>\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    FILE *file = fopen(argv[1], "r");
+    if(file == NULL) {
+        perror("fopen");
+        exit(EXIT_FAILURE);
+    }
+    mime_extension_t *extensions = (mime_extension_t *) calloc (MAX_EXTENSIONS, sizeof(mime_extension_t));
+    if(extensions == NULL) {
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    size_t num_extensions = 0;
+    bool read = read_mime_types(file, extensions, &num_extensions);
+    fclose(file);
+    if(!read) {
+        exit(EXIT_FAILURE);
+    }
+
+    int table_bits = 1;
+    while(((size_t) 1 << table_bits) < num_extensions * MIN_SLOTS_PER_EXTENSION) {
+        table_bits++;
+    }
+    for(; table_bits <= MAX_TABLE_BITS; table_bits++) {
+        int *slots = (int *) malloc (((size_t) 1 << table_bits) * sizeof(int));
+        if(slots == NULL) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        for(uint64_t seed = 0; seed < MAX_SEED_ATTEMPTS; seed++) {
+            if(place_extensions(extensions, num_extensions, table_bits, seed, slots)) {
+                if(!write_mime_table(argv[2], extensions, num_extensions, table_bits, seed, slots)) {
+                    exit(EXIT_FAILURE);
+                }
+                return 0;
+            }
+        }
+        free(slots);
+    }
+    fprintf(stderr, "No perfect hash found for the %zu extensions in %s.\n", num_extensions, argv[1]);
+    exit(EXIT_FAILURE);
+}
+
+// Reads every extension out of a file in the format of /etc/mime.types: lines of a content type followed by the
+// extensions which have it, with everything after a '#' left out. Returns false if an extension is too long, is
+// listed twice, or there are too many of them, or if a line has something that cannot go in a C string as it is.
+bool read_mime_types(FILE *file, mime_extension_t *extensions, size_t *num_extensions) {
+    char line[LINE_BUFFER_SIZE];
+
+    while(fgets(line, LINE_BUFFER_SIZE, file) != NULL) {
+        char *comment = strchr(line, COMMENT_CHARACTER);
+        if(comment != NULL) {
+            *comment = '\0';
+        }
+        if(strpbrk(line, UNQUOTABLE_CHARACTERS) != NULL) {
+            fprintf(stderr, "Quotes and backslashes are not allowed in mime.types: %s\n", line);
+            return false;
+        }
+        char *content_type = strtok(line, FIELD_DELIMITERS);
+        if(content_type == NULL) {
+            continue;
+        }
+        // The content type has to outlive the line buffer, which is about to be read over.
+        content_type = strdup(content_type);
+        if(content_type == NULL) {
+            perror("strdup");
+            return false;
+        }
+        char *extension;
+        while((extension = strtok(NULL, FIELD_DELIMITERS)) != NULL) {
+            if(!add_extension(extensions, num_extensions, extension, content_type)) {
+                return false;
+            }
+        }
+    }
+    if(ferror(file)) {
+        perror("fgets");
+        return false;
+    }
+    return true;
+}
+
+// Tries to give every extension a slot of its own in a table of 2^table_bits slots, using the top bits of its hash
+// with the seed like the server does. Fills in slots with the index of the extension in each slot (or EMPTY_SLOT)
+// and returns true if it worked, or returns false as soon as two extensions want the same slot.
+bool place_extensions(mime_extension_t *extensions, size_t num_extensions, int table_bits, uint64_t seed, int *slots) {
+    for(size_t i = 0; i < ((size_t) 1 << table_bits); i++) {
+        slots[i] = EMPTY_SLOT;
+    }
+    for(size_t i = 0; i < num_extensions; i++) {
+        string_view_t extension = {.data = extensions[i].extension, .length = extensions[i].extension_length};
+        size_t slot = hash_extension(extension, seed) >> (HASH_BITS - table_bits);
+        if(slots[slot] != EMPTY_SLOT) {
+            return false;
+        }
+        slots[slot] = (int) i;
+    }
+    return true;
+}
+
+// Writes the table out as a C header, with an initialiser for every slot so that the table is laid out exactly as
+// the hash expects. Returns false if the file could not be written.
+bool write_mime_table(const char *output_path, mime_extension_t *extensions, size_t num_extensions, int table_bits,
+                      uint64_t seed, int *slots) {
+    char temporary_path[PATH_MAX];
+    if(snprintf(temporary_path, PATH_MAX, "%s%s", output_path, TEMPORARY_SUFFIX) >= PATH_MAX) {
+        fprintf(stderr, "Output path is too long.\n");
+        return false;
+    }
+    FILE *file = fopen(temporary_path, "w");
+    if(file == NULL) {
+        perror("fopen");
+        return false;
+    }
+
+    size_t max_extension_length = 0;
+    for(size_t i = 0; i < num_extensions; i++) {
+        if(extensions[i].extension_length > max_extension_length) {
+            max_extension_length = extensions[i].extension_length;
+        }
+    }
+
+    fprintf(file, "//\n// Generated from mime.types by mime_table_gen. Do not edit, edit mime.types instead.\n//\n\n");
+    fprintf(file, "#ifndef COMP30023_2022_PROJECT_2_MIME_TABLE_H\n#define COMP30023_2022_PROJECT_2_MIME_TABLE_H\n\n");
+    fprintf(file, "#define MIME_TABLE_SEED %luULL\n", (unsigned long) seed);
+    fprintf(file, "#define MIME_TABLE_BITS %d\n", table_bits);
+    fprintf(file, "#define MIME_EXTENSION_MAX_LENGTH %zu\n\n", max_extension_length);
+    fprintf(file, "static const mime_table_entry_t mime_table[%zu] = {\n", (size_t) 1 << table_bits);
+    for(size_t i = 0; i < ((size_t) 1 << table_bits); i++) {
+        if(slots[i] == EMPTY_SLOT) {
+            fprintf(file, "    {NULL, 0, NULL},\n");
+        } else {
+            mime_extension_t *extension = &extensions[slots[i]];
+            fprintf(file, "    {\"%s\", %zu, \"%s\"},\n", extension->extension, extension->extension_length,
+                    extension->content_type);
+        }
+    }
+    fprintf(file, "};\n\n#endif //COMP30023_2022_PROJECT_2_MIME_TABLE_H\n");
+
+    if(fclose(file) != 0) {
+        perror("fclose");
+        unlink(temporary_path);
+        return false;
+    }
+    if(rename(temporary_path, output_path) < 0) {
+        perror("rename");
+        unlink(temporary_path);
+        return false;
+    }
+    return true;
+}
+
+// Adds an extension to the list in lower case, after checking that it fits and has not been listed already.
+static bool add_extension(mime_extension_t *extensions, size_t *num_extensions, const char *extension,
+                          char *content_type) {
+    size_t extension_length = strlen(extension);
+    if(extension_length > MAX_EXTENSION_LENGTH) {
+        fprintf(stderr, "Extension %s is longer than %d characters.\n", extension, MAX_EXTENSION_LENGTH);
+        return false;
+    }
+    if(*num_extensions == MAX_EXTENSIONS) {
+        fprintf(stderr, "More than %d extensions.\n", MAX_EXTENSIONS);
+        return false;
+    }
+
+    mime_extension_t *added = &extensions[*num_extensions];
+    for(size_t i = 0; i < extension_length; i++) {
+        char character = extension[i];
+        added->extension[i] = character >= 'A' && character <= 'Z' ? character + ('a' - 'A') : character;
+    }
+    added->extension[extension_length] = '\0';
+    added->extension_length = extension_length;
+    added->content_type = content_type;
+
+    for(size_t i = 0; i < *num_extensions; i++) {
+        if(strcmp(extensions[i].extension, added->extension) == SAME_STRING) {
+            fprintf(stderr, "Extension %s is listed more than once.\n", added->extension);
+            return false;
+        }
+    }
+    (*num_extensions)++;
+    return true;
+}
@@ -0,0 +1,51 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_MIME_TABLE_GEN_H
+#define COMP30023_2022_PROJECT_2_MIME_TABLE_GEN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+
+#include "parse.h"
+
+#define NUM_ARGS 3
+#define LINE_BUFFER_SIZE 1024
+#define COMMENT_CHARACTER '#'
+#define FIELD_DELIMITERS " \t\r\n"
+// Characters which would need escaping in the C strings the table is written as.
+#define UNQUOTABLE_CHARACTERS "\"\\"
+#define TEMPORARY_SUFFIX ".tmp"
+#define HASH_BITS 64
+
+#define MAX_EXTENSIONS 4096
+#define MAX_EXTENSION_LENGTH 32
+// The table starts out with at least twice as many slots as there are extensions, and doubles in size whenever no
+// seed out of MAX_SEED_ATTEMPTS gives every extension a slot of its own, up to MAX_TABLE_BITS (65536 slots).
+#define MIN_SLOTS_PER_EXTENSION 2
+#define MAX_TABLE_BITS 16
+#define MAX_SEED_ATTEMPTS 1000000
+#define EMPTY_SLOT -1
+
+// An extension from mime.types, in lower case, and the content type it was listed under.
+typedef struct mime_extension mime_extension_t;
+struct mime_extension {
+    char extension[MAX_EXTENSION_LENGTH + NULL_TERMINATOR_SPACE];
+    size_t extension_length;
+    char *content_type;
+};
+
+bool read_mime_types(FILE *file, mime_extension_t *extensions, size_t *num_extensions);
+
+bool place_extensions(mime_extension_t *extensions, size_t num_extensions, int table_bits, uint64_t seed, int *slots);
+
+bool write_mime_table(const char *output_path, mime_extension_t *extensions, size_t num_extensions, int table_bits,
+                      uint64_t seed, int *slots);
+
+#endif //COMP30023_2022_PROJECT_2_MIME_TABLE_GEN_H
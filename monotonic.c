@@ -0,0 +1,19 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "monotonic.h"
+
+// Returns the number of seconds on a clock which is not affected by changes to the system time. Used for timeouts and
+// cache revalidation. https://man7.org/linux/man-pages/man2/clock_gettime.2.html
+time_t monotonic_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec;
+}
+
+// Returns the time on the same clock in nanoseconds, for measuring how long things take.
+long monotonic_nanoseconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * NANOSECONDS_PER_SECOND + now.tv_nsec;
+}
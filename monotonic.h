@@ -0,0 +1,16 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_MONOTONIC_H
+#define COMP30023_2022_PROJECT_2_MONOTONIC_H
+
+#include <time.h>
+
+#define NANOSECONDS_PER_SECOND 1000000000L
+
+time_t monotonic_seconds(void);
+
+long monotonic_nanoseconds(void);
+
+#endif //COMP30023_2022_PROJECT_2_MONOTONIC_H
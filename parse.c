@@ -1,131 +1,374 @@
-#include "parse.h"
-// Takes the request buffer read in from serve_connection and a pointer to the request_path string and then extracts
-// the request_path and places it into the request_path string variable. Also does checks to make sure that the format
-// of the HTTP request is appropriate. Return true if all checks are passed, return false if there is an issue
-// with the request.
-bool parse_request_path(char *request_buffer, char **request_path) {
-    // Note: From https://man7.org/linux/man-pages/man3/strtok_r.3.html, if the delimiter isn't found, then strtok will
-    // scan forward until the null terminator byte, so it will return the whole string. This will then be caught
-    // by the checks below. This function should only accept requests which are in the form "GET path HTTP/1.0\r\n\r\n"
-    // and indicate an error in any other case.
-
-    // Declare pointers used by strtok_r to internally store where to continue from between successive calls
-    // on the same string. https://man7.org/linux/man-pages/man3/strtok_r.3.html
-    char *buffer_saveptr;
-    char *request_line_saveptr;
-
-    // If something has gone wrong with getting the request line, then we return false to indicate unsuccessful
-    // parsing of the request path as well. This also catches the case where a request is an empty string "" as
-    // strtok will give NULL back.
-    char *request_line = strtok_r(request_buffer, "\r\n", &buffer_saveptr);
-    if(request_line == NULL) {
-        return false;
-    }
-    size_t request_line_size = strlen(request_line);
-
-    // Consume the GET which is the first token of strtok_r. If it's not GET then this function returns false.
-    char *HTTP_method = strtok_r(request_line, " ", &request_line_saveptr);
-    if(HTTP_method == NULL) {
-        return false;
-    }
-    if(strcmp(HTTP_method, GET_REQUEST) != SAME_STRING) {
-        return false;
-    }
-
-    // Call strtok_r again using NULL as first argument to get the second token which is the supposed file path from
-    // the request and return it. If this is not a valid file path (like say this was the method or the protocol
-    // version instead), this issue will be caught by the checks later in the program.
-    *request_path = strtok_r(NULL, " ", &request_line_saveptr);
-    if(*request_path == NULL) {
-        return false;
-    }
-
-    // Call strtok_r once again to get the HTTP protocol version of the request. If it's not HTTP/1.0, then this
-    // function returns false as well.
-    char *req_protocol_version = strtok_r(NULL, " ", &request_line_saveptr);
-    if(req_protocol_version == NULL) {
-        return false;
-    }
-    if(strcmp(req_protocol_version, PROTOCOL_VER) != SAME_STRING) {
-        return false;
-    }
-
-    // At this point, we know that the protocol version field is not empty, but we have to make sure that nothing else
-    // comes between the protocol version "HTTP/1.0" and "\r\n", the "\r\n" character was stripped away by the first
-    // strtok_r in order to get the request line. Call strlen on all the 3 tokens and add 2 more spaces
-    // (to count the space delimiters that were disposed of) and compare that to the strlen of request_line saved at
-    // the start. If the combined string length of the tokens is less than that of the request line,
-    // that means there was something between the protocol version and "\r\n" and the request is invalid.
-    size_t combined_token_size = strlen(HTTP_method) + strlen(*request_path) +
-            strlen(req_protocol_version) + TWO_SPACES;
-
-    if(combined_token_size < request_line_size) {
-        return false;
-    }
-
-    // Otherwise, at this point, everything is fine, so we return true
-    return true;
-}
-
-// Function which calls parse_request_path to obtain the request file path and then form the absolute file path
-// using the web root path passed in as a command line argument and the request file path. Returns true if no issues
-// are encountered when doing so; false otherwise.
-bool get_file_path(char **file_path, char *web_path_root, char *request_buffer) {
-    char *request_path;
-
-    // If nothing has gone wrong in parsing the request path, then also check that the request_path does not contain
-    // any escape components before creating the full file path.
-    if (parse_request_path(request_buffer, &request_path) && web_path_root != NULL) {
-        if(check_escape_request_path(request_path)) {
-            return false;
-        }
-        // Nothing is wrong with the request_path, proceed with forming the full file path.
-        size_t file_path_length = strlen(web_path_root) + strlen(request_path) + NULL_TERMINATOR_SPACE;
-
-        *file_path = (char *) malloc (file_path_length * sizeof(char));
-
-        /* Concatenate both the web_path_root and request_path into a new string variable. I was looking for a way
-           concatenate them into a new string variable with enough space instead of just concatenating request_path to
-           web_path_root and came across this code from a stackoverflow post.
-           https://stackoverflow.com/questions/8465006/how-do-i-concatenate-two-strings-in-c
-           and used it as reference. While the rest of the code is fairly similar, I wrote it before coming across the
-           post. */
-
-        // At this point, web_path_root has been verified to not be NULL (through the check above) and request_path
-        // has been checked in parse_request_path.
-        // Copy web_path_root to file_path first since it has enough space to store both strings.
-        strcpy(*file_path, web_path_root);
-        //Then concatenate the request_path to file_path which should already contain web_path_root.
-        strcat(*file_path, request_path);
-        return true;
-    // If something has gone wrong, then we indicate that we were unable to successfully create an
-    // absolute file path.
-    } else {
-        return false;
-    }
-}
-
-// Function which checks whether there is an escape component within the request path. Returns true if there is; false
-// otherwise.
-bool check_escape_request_path(char *request_path) {
-    // Check that the request path is not NULL. It shouldn't be by this point, but nothing wrong with checking again.
-    if(request_path != NULL) {
-        // Check if the request path contains "/../" at any point. strstr() returns NULL when there is no occurrences
-        // of the specified substring in the string. https://man7.org/linux/man-pages/man3/strstr.3.html
-        if(strstr(request_path, "/../") != NULL) {
-            return true;
-        }
-        // Use pointer arithmetic on request_path to get the last 3 characters and check if it's "/.." which means that
-        // it's an escape component. Before that, also check that the length of the file path has more than 3
-        // characters (strlen does not count null terminator character '\0') so the program doesn't access memory
-        // addresses illegally.
-        if(strlen(request_path) >= 3) {
-            char *last_3_char = request_path + strlen(request_path) - 3;
-            if(strcmp(last_3_char, "/..") == SAME_STRING) {
-                return true;
-            }
-        }
-    }
-    return false;
-}
-
+#include "parse.h"
+
+static bool next_line(const char **position, const char *end, string_view_t *line);
+static bool parse_header_line(string_view_t header_line, http_request_t *request);
+static void parse_connection_header(string_view_t header_value, http_request_t *request);
+static string_view_t trim_whitespace(string_view_t view);
+#ifdef SCAN_VECTOR_SIZE
+static uint32_t end_of_request_mask(const char *data);
+static uint32_t byte_mask(const char *data, char byte);
+#endif
+
+// Gets a parser ready to scan a buffer from the start, for a new connection or after the buffer has been moved.
+void http_parser_reset(http_parser_t *parser) {
+    parser->scan_offset = 0;
+}
+
+// Takes a buffer holding the bytes read from a connection so far and returns the length of the first complete request
+// in it, including the "\r\n\r\n" which ends it. Anything in the buffer after that length belongs to the next
+// request. Returns NO_COMPLETE_REQUEST if the request has not been completely read in yet, in which case the parser
+// remembers how far it got so that the next call, after more has been read in, carries on from there instead of
+// scanning the whole buffer again. A slow client sending a request a few bytes at a time would otherwise cost a scan
+// of everything it had sent so far on every read. Once a request is found the parser starts again from the beginning
+// of the buffer, since that is where the next request will be once this one has been moved out of the way.
+size_t find_request_end(http_parser_t *parser, const char *buffer, size_t length) {
+    size_t position = parser->scan_offset;
+
+#ifdef SCAN_VECTOR_SIZE
+    // Check a whole vector's worth of starting positions at a time, as long as there are enough bytes after them
+    // for all four bytes of "\r\n\r\n" to be loaded.
+    while(position + SCAN_VECTOR_SIZE + END_OF_REQUEST_LENGTH - 1 <= length) {
+        uint32_t matches = end_of_request_mask(buffer + position);
+        if(matches != 0) {
+            http_parser_reset(parser);
+            return position + __builtin_ctz(matches) + END_OF_REQUEST_LENGTH;
+        }
+        position += SCAN_VECTOR_SIZE;
+    }
+#endif
+    for(; position + END_OF_REQUEST_LENGTH <= length; position++) {
+        if(memcmp(buffer + position, END_OF_REQUEST, END_OF_REQUEST_LENGTH) == SAME_STRING) {
+            http_parser_reset(parser);
+            return position + END_OF_REQUEST_LENGTH;
+        }
+    }
+    // The end of the request cannot start anywhere before position, but the last few bytes in the buffer could still
+    // turn out to be the start of it once more has been read in.
+    parser->scan_offset = position;
+    return NO_COMPLETE_REQUEST;
+}
+
+// Takes a single complete request (as found by find_request_end) and fills in the http_request struct passed in. The
+// request line is checked by parse_request_line and the header lines after it are split into names and values, with
+// the Connection header deciding whether the connection is kept open once the response has been sent. Nothing is
+// copied out of the buffer and nothing in it is changed, so the request can be parsed in place without having to
+// null-terminate it first. Return true if all checks are passed, return false if there is an issue with the request.
+bool parse_request(const char *request_buffer, size_t request_length, http_request_t *request) {
+    const char *position = request_buffer;
+    const char *end = request_buffer + request_length;
+    string_view_t line;
+
+    // Servers should ignore empty lines before the request line, but if there is nothing but empty lines then there
+    // is no request, and it is invalid. https://datatracker.ietf.org/doc/html/rfc9112#section-2.2
+    do {
+        if(!next_line(&position, end, &line)) {
+            return false;
+        }
+    } while(line.length == 0);
+    if(!parse_request_line(line, request)) {
+        return false;
+    }
+
+    // Every line after that is a header line, up until the empty line that ends the request.
+    request->num_headers = 0;
+    while(next_line(&position, end, &line) && line.length != 0) {
+        if(!parse_header_line(line, request)) {
+            return false;
+        }
+    }
+
+    // HTTP/1.1 connections are persistent unless the client says otherwise, while HTTP/1.0 connections are closed
+    // after one response unless the client asks for them to be kept alive.
+    // https://datatracker.ietf.org/doc/html/rfc9112#section-9.3
+    request->keep_alive = strcmp(request->protocol_version, PROTOCOL_VER_1_1) == SAME_STRING;
+    for(int i = 0; i < request->num_headers; i++) {
+        if(string_view_case_equals(request->headers[i].name, CONNECTION_HEADER)) {
+            parse_connection_header(request->headers[i].value, request);
+        }
+    }
+    return true;
+}
+
+// Takes the request line (without its line ending) and extracts the method, request path and protocol version into
+// the http_request struct. This function should only accept request lines which are in the form "GET path HTTP/1.0"
+// or "GET path HTTP/1.1", with exactly one space between each part, and indicate an error in any other case. Return
+// true if all checks are passed, return false if there is an issue with the request line.
+bool parse_request_line(string_view_t request_line, http_request_t *request) {
+    const char *line_end = request_line.data + request_line.length;
+
+    // The method is everything up to the first space. If it's not GET then this function returns false.
+    const char *method_end = scan_for_byte(request_line.data, request_line.length, ' ');
+    if(method_end == NULL) {
+        return false;
+    }
+    request->method = (string_view_t) {request_line.data, method_end - request_line.data};
+    if(!string_view_equals(request->method, GET_REQUEST)) {
+        return false;
+    }
+
+    // The request path is everything up to the next space, and has to start with a slash, since files are opened
+    // relative to the web root and a path like "../etc/passwd" would otherwise be looked up from outside of it. A
+    // null byte in it would cut the file path short once it is handed to open(), so the request is rejected rather
+    // than serving some other file.
+    const char *path_start = method_end + 1;
+    const char *path_end = scan_for_byte(path_start, line_end - path_start, ' ');
+    if(path_end == NULL || path_end == path_start || *path_start != '/') {
+        return false;
+    }
+    request->request_path = (string_view_t) {path_start, path_end - path_start};
+    if(memchr(request->request_path.data, '\0', request->request_path.length) != NULL) {
+        return false;
+    }
+
+    // The rest of the line is the protocol version, which has to be HTTP/1.0 or HTTP/1.1 exactly, so anything else
+    // between the protocol version and the end of the line also makes the request invalid.
+    string_view_t protocol_version = {path_end + 1, line_end - path_end - 1};
+    if(string_view_equals(protocol_version, PROTOCOL_VER)) {
+        request->protocol_version = PROTOCOL_VER;
+    } else if(string_view_equals(protocol_version, PROTOCOL_VER_1_1)) {
+        request->protocol_version = PROTOCOL_VER_1_1;
+    } else {
+        return false;
+    }
+
+    // Otherwise, at this point, everything is fine, so we return true
+    return true;
+}
+
+// Returns the value of the first header in the request with the given name, or NULL if the request does not have
+// one. Header names are case-insensitive. https://datatracker.ietf.org/doc/html/rfc9110#section-5.1
+string_view_t *find_header(http_request_t *request, char *name) {
+    for(int i = 0; i < request->num_headers; i++) {
+        if(string_view_case_equals(request->headers[i].name, name)) {
+            return &request->headers[i].value;
+        }
+    }
+    return NULL;
+}
+
+// Returns true if the view holds exactly the same characters as the null terminated string.
+bool string_view_equals(string_view_t view, char *string) {
+    return view.length == strlen(string) && memcmp(view.data, string, view.length) == SAME_STRING;
+}
+
+// Same as string_view_equals, but ignoring case. https://man7.org/linux/man-pages/man3/strcasecmp.3.html
+bool string_view_case_equals(string_view_t view, char *string) {
+    return view.length == strlen(string) && strncasecmp(view.data, string, view.length) == SAME_STRING;
+}
+
+// Returns a pointer to the first occurrence of byte in the length bytes starting at data, or NULL if there is none,
+// in the same way as memchr(). Where the CPU has vector instructions, a whole vector of bytes is compared against the
+// byte at once and the position of the first match is read off the resulting bit mask.
+// https://www.intel.com/content/www/us/en/docs/intrinsics-guide/index.html
+const char *scan_for_byte(const char *data, size_t length, char byte) {
+#ifdef SCAN_VECTOR_SIZE
+    size_t position = 0;
+    for(; position + SCAN_VECTOR_SIZE <= length; position += SCAN_VECTOR_SIZE) {
+        uint32_t matches = byte_mask(data + position, byte);
+        if(matches != 0) {
+            return data + position + __builtin_ctz(matches);
+        }
+    }
+    // The last few bytes do not fill a whole vector.
+    return memchr(data + position, byte, length - position);
+#else
+    return memchr(data, byte, length);
+#endif
+}
+
+// Hands out the next line between position and end, without its line ending, and moves position past it. Lines end
+// with "\r\n", but a bare "\n" is accepted as well. https://datatracker.ietf.org/doc/html/rfc9112#section-2.2
+// Returns false if there is no complete line left.
+static bool next_line(const char **position, const char *end, string_view_t *line) {
+    const char *line_end = scan_for_byte(*position, end - *position, '\n');
+    if(line_end == NULL) {
+        return false;
+    }
+    line->data = *position;
+    line->length = line_end - *position;
+    if(line->length > 0 && line->data[line->length - 1] == '\r') {
+        line->length--;
+    }
+    *position = line_end + 1;
+    return true;
+}
+
+// Splits a header line into its name and value and adds it to the request. The name cannot be empty or have
+// whitespace between it and the colon, and whitespace around the value is not part of it.
+// https://datatracker.ietf.org/doc/html/rfc9112#section-5
+// Returns false if the header line is invalid or the request has more headers than there is room for.
+static bool parse_header_line(string_view_t header_line, http_request_t *request) {
+    const char *colon = scan_for_byte(header_line.data, header_line.length, ':');
+    if(colon == NULL || colon == header_line.data || request->num_headers == MAX_REQUEST_HEADERS) {
+        return false;
+    }
+
+    http_header_t *header = &request->headers[request->num_headers];
+    header->name = (string_view_t) {header_line.data, colon - header_line.data};
+    char last_name_char = header->name.data[header->name.length - 1];
+    if(last_name_char == ' ' || last_name_char == '\t') {
+        return false;
+    }
+    header->value = trim_whitespace((string_view_t) {colon + 1, header_line.data + header_line.length - colon - 1});
+    request->num_headers++;
+    return true;
+}
+
+// Function which goes through the comma separated options of a Connection header and updates whether the connection
+// should be kept alive. Unknown options are ignored.
+static void parse_connection_header(string_view_t header_value, http_request_t *request) {
+    const char *position = header_value.data;
+    const char *end = header_value.data + header_value.length;
+
+    while(position < end) {
+        const char *option_end = scan_for_byte(position, end - position, ',');
+        if(option_end == NULL) {
+            option_end = end;
+        }
+        string_view_t option = trim_whitespace((string_view_t) {position, option_end - position});
+        if(string_view_case_equals(option, CLOSE_OPTION)) {
+            request->keep_alive = false;
+        } else if(string_view_case_equals(option, KEEP_ALIVE_OPTION)) {
+            request->keep_alive = true;
+        }
+        position = option_end + 1;
+    }
+}
+
+// Returns the view without any spaces or tabs at either end.
+static string_view_t trim_whitespace(string_view_t view) {
+    while(view.length > 0 && (view.data[0] == ' ' || view.data[0] == '\t')) {
+        view.data++;
+        view.length--;
+    }
+    while(view.length > 0 && (view.data[view.length - 1] == ' ' || view.data[view.length - 1] == '\t')) {
+        view.length--;
+    }
+    return view;
+}
+
+#ifdef SCAN_VECTOR_SIZE
+// Returns a bit mask with bit i set if "\r\n\r\n" starts at data + i, for each of the SCAN_VECTOR_SIZE positions
+// starting at data. Four overlapping loads are compared against each byte of "\r\n\r\n" and the results are
+// combined, so the end of the request is found without going through the buffer one byte at a time. Reads
+// SCAN_VECTOR_SIZE + 3 bytes.
+static uint32_t end_of_request_mask(const char *data) {
+#if defined(__AVX2__)
+    __m256i carriage_returns = _mm256_set1_epi8('\r');
+    __m256i line_feeds = _mm256_set1_epi8('\n');
+    __m256i matches = _mm256_and_si256(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) data), carriage_returns),
+            _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (data + 1)), line_feeds));
+    matches = _mm256_and_si256(matches, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (data + 2)),
+                                                          carriage_returns));
+    matches = _mm256_and_si256(matches, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (data + 3)),
+                                                          line_feeds));
+    return (uint32_t) _mm256_movemask_epi8(matches);
+#else
+    __m128i carriage_returns = _mm_set1_epi8('\r');
+    __m128i line_feeds = _mm_set1_epi8('\n');
+    __m128i matches = _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) data), carriage_returns),
+                                    _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (data + 1)), line_feeds));
+    matches = _mm_and_si128(matches, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (data + 2)), carriage_returns));
+    matches = _mm_and_si128(matches, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (data + 3)), line_feeds));
+    return (uint32_t) _mm_movemask_epi8(matches);
+#endif
+}
+
+// Returns a bit mask with bit i set if data[i] is byte, for the SCAN_VECTOR_SIZE bytes starting at data.
+static uint32_t byte_mask(const char *data, char byte) {
+#if defined(__AVX2__)
+    return (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) data),
+                                                             _mm256_set1_epi8(byte)));
+#else
+    return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) data), _mm_set1_epi8(byte)));
+#endif
+}
+#endif
+
+// Function which forms the path of the requested file relative to the web root, which is the request path without
+// its leading slashes, in the file_path buffer passed in (which must hold FILE_PATH_BUFFER_SIZE characters) so that no
+// memory has to be allocated for it on every request. Files are opened relative to the web root's directory (see
+// web_root_open_file), so the web root path itself is not needed here, and the kernel would refuse an absolute path
+// anyway. Callers have already ruled out escape components with check_escape_request_path, since both caches are
+// looked up before getting here. Returns true if no issues are encountered when doing so; false otherwise, including
+// when the path is too long to be a file path at all.
+bool get_file_path(char *file_path, string_view_t request_path) {
+    if(request_path.data == NULL) {
+        return false;
+    }
+    // "//index.html" is the same file as "/index.html", as it was when the web root path was put in front of it.
+    size_t slashes = 0;
+    while(slashes < request_path.length && request_path.data[slashes] == '/') {
+        slashes++;
+    }
+    size_t relative_path_length = request_path.length - slashes;
+    if(relative_path_length + NULL_TERMINATOR_SPACE > FILE_PATH_BUFFER_SIZE) {
+        return false;
+    }
+
+    // The request path is not null terminated since it still sits in the request buffer, so the null terminator is
+    // added by hand.
+    memcpy(file_path, request_path.data + slashes, relative_path_length);
+    file_path[relative_path_length] = '\0';
+    return true;
+}
+
+// Function which checks whether there is an escape component within the request path. Returns true if there is; false
+// otherwise. parse_request_line only accepts paths starting with a slash, but a leading "../" or a path of just ".."
+// is rejected here too, so that the check does not rely on that.
+bool check_escape_request_path(string_view_t request_path) {
+    // Check that the request path is not NULL. It shouldn't be by this point, but nothing wrong with checking again.
+    if(request_path.data != NULL) {
+        if(string_view_equals(request_path, "..") ||
+                (request_path.length >= 3 && memcmp(request_path.data, "../", 3) == SAME_STRING)) {
+            return true;
+        }
+        // Check if the request path contains "/../" at any point. memmem() returns NULL when there is no occurrences
+        // of the specified substring in the string. https://man7.org/linux/man-pages/man3/memmem.3.html
+        if(memmem(request_path.data, request_path.length, "/../", 4) != NULL) {
+            return true;
+        }
+        // Check if the last 3 characters are "/.." which means that it's an escape component. Before that, also check
+        // that the request path has at least 3 characters so the program doesn't access memory addresses illegally.
+        if(request_path.length >= 3) {
+            string_view_t last_3_char = {request_path.data + request_path.length - 3, 3};
+            if(string_view_equals(last_3_char, "/..")) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Returns the 64-bit FNV-1a hash of the request path, used to look it up in the caches.
+// http://www.isthe.com/chongo/tech/comp/fnv/index.html
+uint64_t hash_request_path(string_view_t request_path) {
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for(size_t i = 0; i < request_path.length; i++) {
+        hash ^= (unsigned char) request_path.data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// The same hash for a file extension, but with upper case letters folded to lower case so that extensions match
+// whatever their case, and mixed with seed before it starts. mime_table_gen tries seeds until it finds one which
+// gives every extension in mime.types a slot of its own in the MIME table, and the server hashes with that seed. The
+// table picks slots by the top bits of the hash, which FNV hardly changes for a short extension when only the seed
+// is different, so the hash is mixed once more at the end.
+uint64_t hash_extension(string_view_t extension, uint64_t seed) {
+    uint64_t hash = FNV_OFFSET_BASIS ^ seed;
+    for(size_t i = 0; i < extension.length; i++) {
+        unsigned char character = (unsigned char) extension.data[i];
+        if(character >= 'A' && character <= 'Z') {
+            character += 'a' - 'A';
+        }
+        hash ^= character;
+        hash *= FNV_PRIME;
+    }
+    hash ^= hash >> HASH_MIX_SHIFT;
+    hash *= HASH_MIX_MULTIPLIER;
+    hash ^= hash >> HASH_MIX_SHIFT;
+    return hash;
+}
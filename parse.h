@@ -1,26 +1,118 @@
-//
-// Created by User on 14/5/2022.
-//
-
-#ifndef COMP30023_2022_PROJECT_2_PARSE_H
-#define COMP30023_2022_PROJECT_2_PARSE_H
-
-#include <stdlib.h>
-#include <string.h>
-#include <stdbool.h>
-
-#define NULL_TERMINATOR_SPACE 1
-#define TWO_SPACES 2
-
-#define SAME_STRING 0
-
-#define GET_REQUEST "GET"
-#define PROTOCOL_VER "HTTP/1.0"
-
-bool parse_request_path(char *request_buffer, char **request_path);
-
-bool get_file_path(char **file_path, char *web_path_root, char *request_buffer);
-
-bool check_escape_request_path(char *request_path);
-
-#endif //COMP30023_2022_PROJECT_2_PARSE_H
+//
+// Created by User on 14/5/2022.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_PARSE_H
+#define COMP30023_2022_PROJECT_2_PARSE_H
+
+// memmem() is a GNU extension. https://man7.org/linux/man-pages/man3/memmem.3.html
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
+
+// SSE2 is part of the x86-64 baseline, so the vectorised scans are always available there. AVX2 is only used when the
+// compiler is told the target has it (-mavx2 or -march=native), otherwise the server would not run on older CPUs.
+// Other architectures fall back to memchr(), which the C library already vectorises.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SCAN_VECTOR_SIZE 32
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SCAN_VECTOR_SIZE 16
+#endif
+
+#define REQUEST_MAX_BUFFER_SIZE 2000
+// Room for the longest path the kernel will open. https://man7.org/linux/man-pages/man3/realpath.3.html
+#define FILE_PATH_BUFFER_SIZE PATH_MAX
+#define NULL_TERMINATOR_SPACE 1
+
+#define SAME_STRING 0
+
+#define GET_REQUEST "GET"
+#define PROTOCOL_VER "HTTP/1.0"
+#define PROTOCOL_VER_1_1 "HTTP/1.1"
+
+#define END_OF_REQUEST "\r\n\r\n"
+#define END_OF_REQUEST_LENGTH 4
+#define NO_COMPLETE_REQUEST 0
+
+#define MAX_REQUEST_HEADERS 64
+
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+// The last step of MurmurHash3's 64-bit hash, which spreads every bit of its input across all of its output.
+// https://github.com/aappleby/smhasher/blob/master/src/MurmurHash3.cpp
+#define HASH_MIX_SHIFT 33
+#define HASH_MIX_MULTIPLIER 0xff51afd7ed558ccdULL
+
+#define CONNECTION_HEADER "Connection"
+#define KEEP_ALIVE_OPTION "keep-alive"
+#define CLOSE_OPTION "close"
+
+// A string that is not null terminated, given by where it starts and how long it is. The parser hands these out so
+// that nothing has to be copied out of (or written into) the buffer the request was read into.
+typedef struct string_view string_view_t;
+struct string_view {
+    const char *data;
+    size_t length;
+};
+
+typedef struct http_header http_header_t;
+struct http_header {
+    string_view_t name;
+    string_view_t value;
+};
+
+// The state find_request_end keeps between reads on the same connection, so that each call only has to look at the
+// bytes which have arrived since the last one. It has to be reset whenever the buffer it was scanning is moved.
+typedef struct http_parser http_parser_t;
+struct http_parser {
+    size_t scan_offset;
+};
+
+// A struct which contains the parts of a request that the server cares about. The views point into the request
+// buffer that was parsed, so they are only valid for as long as that buffer is left alone. The protocol version
+// points at PROTOCOL_VER or PROTOCOL_VER_1_1 rather than into the buffer, so it can be printed straight back out.
+typedef struct http_request http_request_t;
+struct http_request {
+    string_view_t method;
+    string_view_t request_path;
+    char *protocol_version;
+    http_header_t headers[MAX_REQUEST_HEADERS];
+    int num_headers;
+    bool keep_alive;
+};
+
+void http_parser_reset(http_parser_t *parser);
+
+size_t find_request_end(http_parser_t *parser, const char *buffer, size_t length);
+
+bool parse_request(const char *request_buffer, size_t request_length, http_request_t *request);
+
+bool parse_request_line(string_view_t request_line, http_request_t *request);
+
+string_view_t *find_header(http_request_t *request, char *name);
+
+bool string_view_equals(string_view_t view, char *string);
+
+bool string_view_case_equals(string_view_t view, char *string);
+
+const char *scan_for_byte(const char *data, size_t length, char byte);
+
+bool get_file_path(char *file_path, string_view_t request_path);
+
+bool check_escape_request_path(string_view_t request_path);
+
+uint64_t hash_request_path(string_view_t request_path);
+
+uint64_t hash_extension(string_view_t extension, uint64_t seed);
+
+#endif //COMP30023_2022_PROJECT_2_PARSE_H
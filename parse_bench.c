@@ -0,0 +1,198 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "parse_bench.h"
+
+static size_t legacy_find_request_end(char *request_buffer);
+static bool legacy_parse_request(char *request_buffer, legacy_http_request_t *request);
+static bool legacy_parse_request_line(char *request_line, legacy_http_request_t *request);
+static void legacy_parse_connection_header(char *header_value, legacy_http_request_t *request);
+static long legacy_whole(const char *request, size_t length, int iterations);
+static long legacy_fragmented(const char *request, size_t length, int iterations);
+static long incremental_whole(const char *request, size_t length, int iterations);
+static long incremental_fragmented(const char *request, size_t length, int iterations);
+static void run_benchmark(char *name, const char *request);
+static long elapsed_nanoseconds(struct timespec *start);
+
+// Counts the requests each parser accepted, so that the compiler cannot throw the parsing away.
+static volatile long requests_parsed;
+
+// Microbenchmark comparing the request parser with the strstr/strtok_r one it replaced. Each request is copied into a
+// read buffer (as read() would) and then found and parsed, either arriving all at once or FRAGMENT_SIZE bytes at a
+// time like it would from a slow client. The old parser has to look for the end of the request from the start of the
+// buffer after every read, and null-terminates and splits up the buffer as it goes, while the new one only looks at
+// the bytes that have just arrived and leaves the buffer alone.
+// Build with "make parse_bench" and run ./parse_bench.
+int main(int argc, char **argv) {
+    run_benchmark("short request", SHORT_REQUEST);
+    run_benchmark("browser request", BROWSER_REQUEST);
+    return 0;
+}
+
+// Runs both parsers over the request, arriving whole and in fragments, and prints the time taken per request.
+static void run_benchmark(char *name, const char *request) {
+    size_t length = strlen(request);
+    long legacy_whole_time = legacy_whole(request, length, WHOLE_REQUEST_ITERATIONS);
+    long incremental_whole_time = incremental_whole(request, length, WHOLE_REQUEST_ITERATIONS);
+    long legacy_fragmented_time = legacy_fragmented(request, length, FRAGMENTED_REQUEST_ITERATIONS);
+    long incremental_fragmented_time = incremental_fragmented(request, length, FRAGMENTED_REQUEST_ITERATIONS);
+
+    printf("%s (%zu bytes)\n", name, length);
+    printf("  whole:      strtok_r %7.1f ns/request, incremental %7.1f ns/request (%.2fx)\n",
+           (double) legacy_whole_time / WHOLE_REQUEST_ITERATIONS,
+           (double) incremental_whole_time / WHOLE_REQUEST_ITERATIONS,
+           (double) legacy_whole_time / incremental_whole_time);
+    printf("  %d-byte reads: strtok_r %7.1f ns/request, incremental %7.1f ns/request (%.2fx)\n", FRAGMENT_SIZE,
+           (double) legacy_fragmented_time / FRAGMENTED_REQUEST_ITERATIONS,
+           (double) incremental_fragmented_time / FRAGMENTED_REQUEST_ITERATIONS,
+           (double) legacy_fragmented_time / incremental_fragmented_time);
+}
+
+static long legacy_whole(const char *request, size_t length, int iterations) {
+    char buffer[REQUEST_MAX_BUFFER_SIZE + NULL_TERMINATOR_SPACE];
+    legacy_http_request_t parsed_request;
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int i = 0; i < iterations; i++) {
+        memcpy(buffer, request, length);
+        buffer[length] = '\0';
+        size_t request_length = legacy_find_request_end(buffer);
+        buffer[request_length] = '\0';
+        requests_parsed += legacy_parse_request(buffer, &parsed_request);
+    }
+    return elapsed_nanoseconds(&start);
+}
+
+static long legacy_fragmented(const char *request, size_t length, int iterations) {
+    char buffer[REQUEST_MAX_BUFFER_SIZE + NULL_TERMINATOR_SPACE];
+    legacy_http_request_t parsed_request;
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int i = 0; i < iterations; i++) {
+        size_t bytes_read_so_far = 0;
+        size_t request_length;
+        buffer[0] = '\0';
+        while((request_length = legacy_find_request_end(buffer)) == NO_COMPLETE_REQUEST) {
+            size_t n = length - bytes_read_so_far < FRAGMENT_SIZE ? length - bytes_read_so_far : FRAGMENT_SIZE;
+            memcpy(buffer + bytes_read_so_far, request + bytes_read_so_far, n);
+            bytes_read_so_far += n;
+            buffer[bytes_read_so_far] = '\0';
+        }
+        buffer[request_length] = '\0';
+        requests_parsed += legacy_parse_request(buffer, &parsed_request);
+    }
+    return elapsed_nanoseconds(&start);
+}
+
+static long incremental_whole(const char *request, size_t length, int iterations) {
+    char buffer[REQUEST_MAX_BUFFER_SIZE];
+    http_parser_t parser;
+    http_request_t parsed_request;
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int i = 0; i < iterations; i++) {
+        http_parser_reset(&parser);
+        memcpy(buffer, request, length);
+        size_t request_length = find_request_end(&parser, buffer, length);
+        requests_parsed += parse_request(buffer, request_length, &parsed_request);
+    }
+    return elapsed_nanoseconds(&start);
+}
+
+static long incremental_fragmented(const char *request, size_t length, int iterations) {
+    char buffer[REQUEST_MAX_BUFFER_SIZE];
+    http_parser_t parser;
+    http_request_t parsed_request;
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(int i = 0; i < iterations; i++) {
+        size_t bytes_read_so_far = 0;
+        size_t request_length;
+        http_parser_reset(&parser);
+        while((request_length = find_request_end(&parser, buffer, bytes_read_so_far)) == NO_COMPLETE_REQUEST) {
+            size_t n = length - bytes_read_so_far < FRAGMENT_SIZE ? length - bytes_read_so_far : FRAGMENT_SIZE;
+            memcpy(buffer + bytes_read_so_far, request + bytes_read_so_far, n);
+            bytes_read_so_far += n;
+        }
+        requests_parsed += parse_request(buffer, request_length, &parsed_request);
+    }
+    return elapsed_nanoseconds(&start);
+}
+
+static long elapsed_nanoseconds(struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * NANOSECONDS_PER_SECOND + (end.tv_nsec - start->tv_nsec);
+}
+
+// The parser as it was before the incremental one replaced it, kept here to compare against.
+static size_t legacy_find_request_end(char *request_buffer) {
+    char *request_end = strstr(request_buffer, END_OF_REQUEST);
+    if(request_end == NULL) {
+        return NO_COMPLETE_REQUEST;
+    }
+    return (request_end - request_buffer) + END_OF_REQUEST_LENGTH;
+}
+
+static bool legacy_parse_request(char *request_buffer, legacy_http_request_t *request) {
+    char *buffer_saveptr;
+    char *request_line = strtok_r(request_buffer, "\r\n", &buffer_saveptr);
+    if(request_line == NULL) {
+        return false;
+    }
+    if(!legacy_parse_request_line(request_line, request)) {
+        return false;
+    }
+
+    request->keep_alive = strcmp(request->protocol_version, PROTOCOL_VER_1_1) == SAME_STRING;
+    char *header_line;
+    while((header_line = strtok_r(NULL, "\r\n", &buffer_saveptr)) != NULL) {
+        if(strncasecmp(header_line, LEGACY_CONNECTION_HEADER, strlen(LEGACY_CONNECTION_HEADER)) == SAME_STRING) {
+            legacy_parse_connection_header(header_line + strlen(LEGACY_CONNECTION_HEADER), request);
+        }
+    }
+    return true;
+}
+
+static bool legacy_parse_request_line(char *request_line, legacy_http_request_t *request) {
+    char *request_line_saveptr;
+    size_t request_line_size = strlen(request_line);
+
+    char *HTTP_method = strtok_r(request_line, " ", &request_line_saveptr);
+    if(HTTP_method == NULL || strcmp(HTTP_method, GET_REQUEST) != SAME_STRING) {
+        return false;
+    }
+    request->request_path = strtok_r(NULL, " ", &request_line_saveptr);
+    if(request->request_path == NULL) {
+        return false;
+    }
+    request->protocol_version = strtok_r(NULL, " ", &request_line_saveptr);
+    if(request->protocol_version == NULL) {
+        return false;
+    }
+    if(strcmp(request->protocol_version, PROTOCOL_VER) != SAME_STRING &&
+            strcmp(request->protocol_version, PROTOCOL_VER_1_1) != SAME_STRING) {
+        return false;
+    }
+    size_t combined_token_size = strlen(HTTP_method) + strlen(request->request_path) +
+            strlen(request->protocol_version) + TWO_SPACES;
+    return combined_token_size >= request_line_size;
+}
+
+static void legacy_parse_connection_header(char *header_value, legacy_http_request_t *request) {
+    char *value_saveptr;
+    char *option = strtok_r(header_value, LEGACY_HEADER_VALUE_DELIMITERS, &value_saveptr);
+
+    while(option != NULL) {
+        if(strcasecmp(option, CLOSE_OPTION) == SAME_STRING) {
+            request->keep_alive = false;
+        } else if(strcasecmp(option, KEEP_ALIVE_OPTION) == SAME_STRING) {
+            request->keep_alive = true;
+        }
+        option = strtok_r(NULL, LEGACY_HEADER_VALUE_DELIMITERS, &value_saveptr);
+    }
+}
@@ -0,0 +1,55 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_PARSE_BENCH_H
+#define COMP30023_2022_PROJECT_2_PARSE_BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "parse.h"
+
+#define WHOLE_REQUEST_ITERATIONS 1000000
+#define FRAGMENTED_REQUEST_ITERATIONS 100000
+#define FRAGMENT_SIZE 8
+#define NANOSECONDS_PER_SECOND 1000000000L
+
+#define LEGACY_CONNECTION_HEADER "Connection:"
+#define LEGACY_HEADER_VALUE_DELIMITERS " ,\t"
+#define TWO_SPACES 2
+
+// A request of the sort curl sends, and one of the sort a browser sends.
+#define SHORT_REQUEST "GET /index.html HTTP/1.1\r\n" \
+        "Host: localhost:8080\r\n" \
+        "User-Agent: curl/8.5.0\r\n" \
+        "Accept: */*\r\n" \
+        "\r\n"
+#define BROWSER_REQUEST "GET /assets/images/photo.jpg HTTP/1.1\r\n" \
+        "Host: www.example.com\r\n" \
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:125.0) Gecko/20100101 Firefox/125.0\r\n" \
+        "Accept: image/avif,image/webp,image/png,image/svg+xml,image/*;q=0.8,*/*;q=0.5\r\n" \
+        "Accept-Language: en-AU,en;q=0.7,en-US;q=0.3\r\n" \
+        "Accept-Encoding: gzip, deflate, br, zstd\r\n" \
+        "Referer: https://www.example.com/gallery/index.html\r\n" \
+        "Connection: keep-alive\r\n" \
+        "Cookie: session=4f2a9c1e8b7d6a5f3e2d1c0b9a8f7e6d; theme=dark\r\n" \
+        "Sec-Fetch-Dest: image\r\n" \
+        "Sec-Fetch-Mode: no-cors\r\n" \
+        "Sec-Fetch-Site: same-origin\r\n" \
+        "If-Modified-Since: Tue, 14 May 2022 10:00:00 GMT\r\n" \
+        "\r\n"
+
+// What the strtok_r parser used to fill in.
+typedef struct legacy_http_request legacy_http_request_t;
+struct legacy_http_request {
+    char *request_path;
+    char *protocol_version;
+    bool keep_alive;
+};
+
+#endif //COMP30023_2022_PROJECT_2_PARSE_BENCH_H
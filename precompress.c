@@ -0,0 +1,230 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "precompress.h"
+
+static int visit_file(const char *file_path, const struct stat *file_stat, int type, struct FTW *walk);
+static bool is_compressible(const char *file_path);
+static bool has_suffix(const char *file_path, const char *suffix);
+static bool read_file(const char *file_path, unsigned char *contents, size_t length);
+static bool write_file(const char *file_path, const unsigned char *contents, size_t length);
+
+static const struct option long_options[] = {
+    {"force", no_argument, NULL, FORCE_OPTION},
+    {NULL, 0, NULL, 0}
+};
+
+// Set from the command line before the walk starts. nftw gives its callback no way to pass anything else in.
+static bool force = false;
+static int num_written = 0;
+static int num_failed = 0;
+
+// Writes a Brotli (.br) and a gzip (.gz) copy next to every HTML, CSS and JavaScript file in the web root, for the
+// server to send with --precompressed so that it never has to compress anything while serving. A copy is only
+// rewritten if it is older than its file (or --force is given), and is left out if it would be no smaller than the
+// file. Copies are written under a temporary name and renamed into place, so the server never sees half of one. Run
+// it again whenever files in the web root change, or the server keeps sending the old copies.
+int main(int argc, char **argv) {
+    int option;
+
+    while((option = getopt_long(argc, argv, "", long_options, NULL)) != -1) {
+        switch(option) {
+            case FORCE_OPTION:
+                force = true;
+                break;
+            default:
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if(argc - optind < NUM_POSITIONAL_ARGS) {
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    // Symbolic links are not followed, so that nothing outside the web root is compressed.
+    // https://man7.org/linux/man-pages/man3/nftw.3.html
+    if(nftw(argv[optind], visit_file, MAX_OPEN_DIRECTORIES, FTW_PHYS) < 0) {
+        perror("nftw");
+        exit(EXIT_FAILURE);
+    }
+    printf("%d compressed copies written, %d files failed\n", num_written, num_failed);
+    return num_failed == 0 ? 0 : EXIT_FAILURE;
+}
+
+// Writes both compressed copies of a file, reading it in just once. Returns false if either could not be written.
+bool precompress_file(const char *file_path, const struct stat *file_stat) {
+    size_t length = file_stat->st_size;
+    // One byte more than the file, so that an empty file still gets a buffer.
+    unsigned char *contents = (unsigned char *) malloc (length + 1);
+    if(contents == NULL) {
+        perror("malloc");
+        return false;
+    }
+    if(!read_file(file_path, contents, length)) {
+        free(contents);
+        return false;
+    }
+
+    precompress_result_t brotli_result = write_compressed_copy(file_path, file_stat, contents, BROTLI_SUFFIX,
+                                                               brotli_compress);
+    precompress_result_t gzip_result = write_compressed_copy(file_path, file_stat, contents, GZIP_SUFFIX,
+                                                             gzip_compress);
+    num_written += (brotli_result == PRECOMPRESS_WRITTEN) + (gzip_result == PRECOMPRESS_WRITTEN);
+    free(contents);
+    return brotli_result != PRECOMPRESS_FAILED && gzip_result != PRECOMPRESS_FAILED;
+}
+
+// Writes the copy of a file with the suffix on the end of its name, compressed with compress. A copy which would be
+// no smaller than the file is not worth sending, so any old copy is removed instead.
+precompress_result_t write_compressed_copy(const char *file_path, const struct stat *file_stat,
+                                           const unsigned char *contents, const char *suffix,
+                                           compress_function_t compress) {
+    size_t path_length = strlen(file_path) + strlen(suffix) + strlen(TEMPORARY_SUFFIX) + NULL_TERMINATOR_SPACE;
+    char copy_path[path_length];
+    char temporary_path[path_length];
+    struct stat copy_stat;
+    snprintf(copy_path, path_length, "%s%s", file_path, suffix);
+    snprintf(temporary_path, path_length, "%s%s", copy_path, TEMPORARY_SUFFIX);
+
+    if(!force && stat(copy_path, &copy_stat) == 0 &&
+            (copy_stat.st_mtim.tv_sec > file_stat->st_mtim.tv_sec ||
+             (copy_stat.st_mtim.tv_sec == file_stat->st_mtim.tv_sec &&
+              copy_stat.st_mtim.tv_nsec >= file_stat->st_mtim.tv_nsec))) {
+        return PRECOMPRESS_UP_TO_DATE;
+    }
+
+    size_t compressed_length = file_stat->st_size;
+    unsigned char *compressed = (unsigned char *) malloc (compressed_length + 1);
+    if(compressed == NULL) {
+        perror("malloc");
+        return PRECOMPRESS_FAILED;
+    }
+    if(!compress(contents, file_stat->st_size, compressed, &compressed_length) ||
+            compressed_length >= (size_t) file_stat->st_size) {
+        free(compressed);
+        if(unlink(copy_path) < 0 && errno != ENOENT) {
+            perror("unlink");
+            return PRECOMPRESS_FAILED;
+        }
+        return PRECOMPRESS_NOT_SMALLER;
+    }
+
+    bool written = write_file(temporary_path, compressed, compressed_length);
+    free(compressed);
+    if(!written) {
+        unlink(temporary_path);
+        return PRECOMPRESS_FAILED;
+    }
+    // https://man7.org/linux/man-pages/man2/rename.2.html
+    if(rename(temporary_path, copy_path) < 0) {
+        perror("rename");
+        unlink(temporary_path);
+        return PRECOMPRESS_FAILED;
+    }
+    return PRECOMPRESS_WRITTEN;
+}
+
+// Compresses into the gzip format with zlib, in one go since the whole file is in memory. The output buffer is no
+// bigger than the input, so Z_STREAM_END is only reached if the result is smaller than the file.
+// https://www.zlib.net/manual.html#Basic
+bool gzip_compress(const unsigned char *input, size_t length, unsigned char *output, size_t *output_length) {
+    z_stream stream;
+    memset(&stream, 0, sizeof stream);
+    if(deflateInit2(&stream, GZIP_LEVEL, Z_DEFLATED, GZIP_WINDOW_BITS, GZIP_MEMORY_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+        fprintf(stderr, "deflateInit2 failed\n");
+        return false;
+    }
+    stream.next_in = (unsigned char *) input;
+    stream.avail_in = length;
+    stream.next_out = output;
+    stream.avail_out = *output_length;
+    int result = deflate(&stream, Z_FINISH);
+    *output_length = stream.total_out;
+    deflateEnd(&stream);
+    return result == Z_STREAM_END;
+}
+
+// Compresses into the Brotli format with the one-shot encoder, which fails rather than writing past the end of the
+// output. https://github.com/google/brotli/blob/master/c/include/brotli/encode.h
+bool brotli_compress(const unsigned char *input, size_t length, unsigned char *output, size_t *output_length) {
+    return BrotliEncoderCompress(BROTLI_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, length, input,
+                                 output_length, output) == BROTLI_TRUE;
+}
+
+// Prints out how the tool is supposed to be run.
+void print_usage(char *program_name) {
+    fprintf(stderr, "Usage: %s [--force] <web root path>\n", program_name);
+    fprintf(stderr, "  Writes .br and .gz copies of the HTML, CSS and JavaScript files in the web root.\n");
+    fprintf(stderr, "      --force    rewrite copies even if they are newer than their files\n");
+}
+
+// Called by nftw for everything in the web root. Compresses regular files of the right types and carries on with the
+// walk whatever happens, so one bad file does not stop the rest from being done.
+static int visit_file(const char *file_path, const struct stat *file_stat, int type, struct FTW *walk) {
+    if(type == FTW_F && S_ISREG(file_stat->st_mode) && is_compressible(file_path)) {
+        if(!precompress_file(file_path, file_stat)) {
+            fprintf(stderr, "could not compress %s\n", file_path);
+            num_failed++;
+        }
+    }
+    return 0;
+}
+
+// Returns true if the file is one of the types the server sends precompressed copies of.
+static bool is_compressible(const char *file_path) {
+    return has_suffix(file_path, HTML_EXTENSION) || has_suffix(file_path, CSS_EXTENSION) ||
+           has_suffix(file_path, JAVA_SCRIPT_EXTENSION);
+}
+
+static bool has_suffix(const char *file_path, const char *suffix) {
+    size_t file_path_length = strlen(file_path);
+    size_t suffix_length = strlen(suffix);
+    return file_path_length >= suffix_length &&
+           strcmp(file_path + file_path_length - suffix_length, suffix) == SAME_STRING;
+}
+
+// Reads exactly length bytes of the file into contents.
+static bool read_file(const char *file_path, unsigned char *contents, size_t length) {
+    int fd = open(file_path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        perror("open");
+        return false;
+    }
+    size_t bytes_read = 0;
+    while(bytes_read < length) {
+        ssize_t n = read(fd, contents + bytes_read, length - bytes_read);
+        if(n <= 0) {
+            // The file got shorter while it was being read.
+            if(n < 0) {
+                perror("read");
+            }
+            close(fd);
+            return false;
+        }
+        bytes_read += n;
+    }
+    close(fd);
+    return true;
+}
+
+// Writes the whole of contents to a new file at file_path, replacing anything that was there.
+static bool write_file(const char *file_path, const unsigned char *contents, size_t length) {
+    int fd = open(file_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, COMPRESSED_FILE_MODE);
+    if(fd < 0) {
+        perror("open");
+        return false;
+    }
+    size_t written = 0;
+    while(written < length) {
+        ssize_t n = write(fd, contents + written, length - written);
+        if(n < 0) {
+            perror("write");
+            close(fd);
+            return false;
+        }
+        written += n;
+    }
+    close(fd);
+    return true;
+}
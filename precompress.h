@@ -0,0 +1,81 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_PRECOMPRESS_H
+#define COMP30023_2022_PROJECT_2_PRECOMPRESS_H
+
+// nftw() needs this for FTW_PHYS and friends. https://man7.org/linux/man-pages/man3/nftw.3.html
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <zlib.h>
+#include <brotli/encode.h>
+
+#define NUM_POSITIONAL_ARGS 1
+#define SAME_STRING 0
+#define NULL_TERMINATOR_SPACE 1
+
+// The files the server sends precompressed copies of, which are the text types it knows the content type of.
+#define HTML_EXTENSION ".html"
+#define CSS_EXTENSION ".css"
+#define JAVA_SCRIPT_EXTENSION ".js"
+#define BROTLI_SUFFIX ".br"
+#define GZIP_SUFFIX ".gz"
+#define TEMPORARY_SUFFIX ".tmp"
+
+// Both at their slowest and smallest, since compressing only ever happens once per file.
+#define GZIP_LEVEL Z_BEST_COMPRESSION
+#define BROTLI_QUALITY BROTLI_MAX_QUALITY
+// Adding 16 to the window size makes deflate write a gzip header and trailer instead of a zlib one.
+// https://www.zlib.net/manual.html#Advanced
+#define GZIP_WINDOW_BITS (MAX_WBITS + 16)
+#define GZIP_MEMORY_LEVEL 9
+
+// nftw keeps up to this many directories open at once while it walks.
+#define MAX_OPEN_DIRECTORIES 32
+#define COMPRESSED_FILE_MODE 0644
+
+// Options which only have a long form.
+enum long_only_option {
+    FORCE_OPTION = 256
+};
+
+// How a compressed copy of one file turned out.
+typedef enum precompress_result {
+    PRECOMPRESS_WRITTEN,
+    PRECOMPRESS_UP_TO_DATE,
+    PRECOMPRESS_NOT_SMALLER,
+    PRECOMPRESS_FAILED
+} precompress_result_t;
+
+// Compresses length bytes from input into output (which has room for *output_length bytes), setting *output_length
+// to the size of the result. Returns false if it did not fit or could not be done.
+typedef bool (*compress_function_t)(const unsigned char *input, size_t length, unsigned char *output,
+                                    size_t *output_length);
+
+bool precompress_file(const char *file_path, const struct stat *file_stat);
+
+precompress_result_t write_compressed_copy(const char *file_path, const struct stat *file_stat,
+                                           const unsigned char *contents, const char *suffix,
+                                           compress_function_t compress);
+
+bool gzip_compress(const unsigned char *input, size_t length, unsigned char *output, size_t *output_length);
+
+bool brotli_compress(const unsigned char *input, size_t length, unsigned char *output, size_t *output_length);
+
+void print_usage(char *program_name);
+
+#endif //COMP30023_2022_PROJECT_2_PRECOMPRESS_H
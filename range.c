@@ -0,0 +1,101 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "range.h"
+
+static const char *skip_whitespace(const char *position, const char *end);
+static const char *parse_position(const char *position, const char *end, off_t *value);
+
+// Parses the value of a Range header against a file of file_size bytes, filling ranges (which has room for
+// MAX_BYTE_RANGES) with the satisfiable ones in the order they were asked for. Each range is either "first-last",
+// "first-" for everything from first on, or "-length" for the last length bytes. Ranges which run past the end of the
+// file are cut short, and ranges which start past it are left out. Any syntax error means the whole header is
+// ignored. https://datatracker.ietf.org/doc/html/rfc9110#section-14.1.2
+range_result_t parse_range(string_view_t value, off_t file_size, byte_range_t *ranges, int *num_ranges) {
+    const char *position = value.data;
+    const char *end = value.data + value.length;
+    size_t unit_length = strlen(BYTES_RANGE_UNIT);
+    int num_specs = 0;
+
+    *num_ranges = 0;
+    if(value.length < unit_length || strncasecmp(position, BYTES_RANGE_UNIT, unit_length) != SAME_STRING) {
+        return RANGE_IGNORED;
+    }
+    position += unit_length;
+
+    while(true) {
+        off_t first;
+        off_t last;
+        position = skip_whitespace(position, end);
+
+        if(position < end && *position == '-') {
+            // A suffix range: the last "last" bytes of the file.
+            if((position = parse_position(position + 1, end, &last)) == NULL) {
+                return RANGE_IGNORED;
+            }
+            if(last > 0 && file_size > 0) {
+                first = last < file_size ? file_size - last : 0;
+                last = file_size - 1;
+            } else {
+                first = file_size;
+            }
+        } else {
+            if((position = parse_position(position, end, &first)) == NULL || position == end || *position != '-') {
+                return RANGE_IGNORED;
+            }
+            position++;
+            if(position < end && *position >= '0' && *position <= '9') {
+                if((position = parse_position(position, end, &last)) == NULL || last < first) {
+                    return RANGE_IGNORED;
+                }
+            } else {
+                last = file_size - 1;
+            }
+            if(last >= file_size) {
+                last = file_size - 1;
+            }
+        }
+
+        if(++num_specs > MAX_BYTE_RANGES) {
+            return RANGE_IGNORED;
+        }
+        if(first < file_size) {
+            ranges[*num_ranges].first = first;
+            ranges[*num_ranges].last = last;
+            (*num_ranges)++;
+        }
+
+        position = skip_whitespace(position, end);
+        if(position == end) {
+            break;
+        }
+        if(*position != ',') {
+            return RANGE_IGNORED;
+        }
+        position++;
+    }
+    return *num_ranges > 0 ? RANGE_SATISFIABLE : RANGE_NOT_SATISFIABLE;
+}
+
+// Returns the position of the first character from position on which is not a space or a tab.
+static const char *skip_whitespace(const char *position, const char *end) {
+    while(position < end && (*position == ' ' || *position == '\t')) {
+        position++;
+    }
+    return position;
+}
+
+// Reads the decimal number starting at position into value, and returns the position just past it. Returns NULL if
+// there is no number there or it is too big to be an offset into any file.
+static const char *parse_position(const char *position, const char *end, off_t *value) {
+    const char *start = position;
+    *value = 0;
+    while(position < end && *position >= '0' && *position <= '9') {
+        if(*value > (INT64_MAX - (*position - '0')) / DECIMAL_BASE) {
+            return NULL;
+        }
+        *value = *value * DECIMAL_BASE + (*position - '0');
+        position++;
+    }
+    return position == start ? NULL : position;
+}
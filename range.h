@@ -0,0 +1,40 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_RANGE_H
+#define COMP30023_2022_PROJECT_2_RANGE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "parse.h"
+
+#define RANGE_HEADER "Range"
+#define BYTES_RANGE_UNIT "bytes="
+// Requests with more ranges than this are answered with the whole file, which RFC 9110 allows, rather than making
+// the server send a response with hundreds of tiny parts.
+#define MAX_BYTE_RANGES 16
+#define DECIMAL_BASE 10
+
+// An inclusive range of byte offsets into a file, like the ones in a Range or Content-Range header.
+typedef struct byte_range byte_range_t;
+struct byte_range {
+    off_t first;
+    off_t last;
+};
+
+// What a Range header asks for. RANGE_IGNORED means the header was malformed, used a unit other than bytes or had too
+// many ranges, and the whole file is sent as if there was no header. RANGE_NOT_SATISFIABLE means that none of the
+// ranges overlap the file, which gets a 416.
+typedef enum range_result {
+    RANGE_IGNORED,
+    RANGE_SATISFIABLE,
+    RANGE_NOT_SATISFIABLE
+} range_result_t;
+
+range_result_t parse_range(string_view_t value, off_t file_size, byte_range_t *ranges, int *num_ranges);
+
+#endif //COMP30023_2022_PROJECT_2_RANGE_H
@@ -1,152 +1,875 @@
-//
-// Created by User on 14/5/2022.
-//
-#include "respond.h"
-
-// A function which has an argument representing the socket to send a message to and the message. Calls syscall write()
-// to send the message to the socket. Returns false in the case of an error; returns true otherwise.
-// The if(write_message() == WRITE_ERROR) statement is used across functions in this module to check if an error
-// occurred in write_message. In which case, the thread returns immediately back up to the serve_connection() function
-// which will then close the socket (drop the connection), free all memory and terminate itself.
-bool write_message(int sockfd_to_send, char *message) {
-    // Write message back
-    int n = write(sockfd_to_send, message, strlen(message));
-    if (n < 0) {
-        perror("write");
-        return WRITE_ERROR;
-    }
-    return WRITE_SUCCESSFUL;
-}
-
-// Function which has an argument representing the socket to send the HTTP response back to as well as the file_path
-// derived from the incoming HTTP request. This function does several checks to determine that the file_path is
-// valid and then writes an appropriate HTTP response depending on the circumstances. If a write error occurs or a
-// sendfile error occurs, this function will immediately exit by returning and have serve_connection close the socket
-// and free the memory as usual.
-void send_http_response(int sockfd_to_send, char *file_path) {
-    int file_path_fd;
-
-    // stat struct from standard library which will allow access to the file size
-    struct stat file_stat;
-
-    // If the file we're trying to read from does not exist, open will return -1 as per the linux manual located at
-    // https://man7.org/linux/man-pages/man2/open.2.html. Hence, if we cannot open what is located at the file path
-    // then we return a 404.
-    if((file_path_fd = open(file_path, O_RDONLY)) < 0 ) {
-        if(write_message(sockfd_to_send, "HTTP/1.0 404 Not Found\r\n\r\n") == WRITE_ERROR) {
-            return;
-        }
-        // Otherwise, the file exists, and we can use fstat to get the statistics of it.
-    } else {
-        /* Call fstat on file_path to get the statistics of the file located at file_path and then store it in the
-           stat struct file_stat declared earlier. */
-        fstat(file_path_fd, &file_stat);
-
-        // Test that the file_path leads to a regular file and not something else like a directory. The S_ISREG macro
-        // comes from the linux manual page, https://man7.org/linux/man-pages/man7/inode.7.html
-        if(S_ISREG(file_stat.st_mode)) {
-            // Write to indicate a successful get response.
-            if(write_message(sockfd_to_send, "HTTP/1.0 200 OK\r\n") == WRITE_ERROR) {
-                return;
-            }
-
-            // Write the Content-Type header first without sending the actual MIME content type
-            if(write_message(sockfd_to_send, "Content-Type: ") == WRITE_ERROR) {
-                return;
-            }
-
-            if(write_content_type(sockfd_to_send, file_path) == WRITE_ERROR) {
-                return;
-            }
-
-            // CRLF to terminate the Content-Type header line and then another CRLF to indicate the end of the headers.
-            if(write_message(sockfd_to_send, "\r\n\r\n") == WRITE_ERROR) {
-                return;
-            }
-
-            off_t file_to_send_size = file_stat.st_size;
-            off_t total_num_bytes_sent = 0;
-            off_t bytes_successfully_sent = 0;
-
-            // Benefits of sendfile(): sendfile() does it's copying from file to file in the kernel instead of the user
-            // space which is more efficient. User space operations such as read() and write() are I/O operations which
-            // require a system call as we were taught in the earlier weeks of the subject. Furthermore, as we were
-            // taught before (or explored during a tute with the tutor), doing a system call is quite expensive and
-            // hence why sendfile() is faster. This is reflected in the Linux manual page
-            // https://man7.org/linux/man-pages/man2/sendfile.2.html. Furthermore, in terms of code
-            // simplicity, there is no need to do separate calls to read the file and write the contents to the socket.
-            // There would also be no need to declare or size a buffer with consideration of the file size and to
-            // concatenate the file contents to the buffer if the approach was to have everything in a buffer and
-            // write it all at once.
-
-            // Track the bytes sent by sendfile() and make sure that all bytes are sent.
-            while(total_num_bytes_sent < file_to_send_size) {
-                // sendfile returns -1 in the case of an error or the number of bytes successfully sent as per the
-                // linux manual located at https://man7.org/linux/man-pages/man2/sendfile.2.html.
-                bytes_successfully_sent = sendfile(sockfd_to_send, file_path_fd,
-                                                   &total_num_bytes_sent, file_to_send_size);
-                // If there was no error, then we increment the total number of bytes sent.
-                if(bytes_successfully_sent >= 0) {
-                    total_num_bytes_sent += bytes_successfully_sent;
-                } else if (bytes_successfully_sent < 0) {
-                    return;
-                }
-            }
-        // Otherwise, we send back a 404 not found response as well if the file_path does not lead to a regular file.
-        } else {
-            if(write_message(sockfd_to_send, "HTTP/1.0 404 Not Found\r\n\r\n") == WRITE_ERROR) {
-                return;
-            }
-        }
-
-    }
-
-}
-
-// A function that is responsible for determining the content type and calling write_message to write it. If at any
-// point a write error occurs, then the function propagates the write error up the call stack to send_http_response.
-bool write_content_type(int sockfd_to_send, char *file_path) {
-    char *extension;
-
-    // Use strrchr to get the last occurrence of the FILE_EXTENSION_DELIMITER which is the '.' character. This deals
-    // with "false" extensions in the file_path. Handling '.' characters that are not associated with an extension
-    // is handled below.
-    extension = strrchr(file_path, FILE_EXTENSION_DELIMITER);
-
-    // If there is a '.' character found in the file_path
-    if(extension != NULL) {
-        // Among the four MIME content type the server identifies, if any of them are found, then return the MIME
-        // content type as specified by https://mimetype.io/all-types/.
-        if(strcmp(extension, HTML_EXTENSION) == SAME_STRING) {
-            if(write_message(sockfd_to_send, "text/html") == WRITE_ERROR) {
-                return WRITE_ERROR;
-            }
-        } else if (strcmp(extension, JPEG_EXTENSION) == SAME_STRING) {
-            if(write_message(sockfd_to_send, "image/jpeg") == WRITE_ERROR) {
-                return WRITE_ERROR;
-            }
-        } else if (strcmp(extension, JAVA_SCRIPT_EXTENSION) == SAME_STRING) {
-            if(write_message(sockfd_to_send, "text/javascript") == WRITE_ERROR) {
-                return WRITE_ERROR;
-            }
-        } else if (strcmp(extension, CSS_EXTENSION) == SAME_STRING) {
-            if(write_message(sockfd_to_send, "text/css") == WRITE_ERROR) {
-                return WRITE_ERROR;
-            }
-        // If there is a '.' character found in the file path, but it's either a file extension not part of
-        // the four or part of something else in the file path which is not
-        // a file extension (which we don't care about).
-        } else {
-            if(write_message(sockfd_to_send, "application/octet-stream") == WRITE_ERROR) {
-                return WRITE_ERROR;
-            }
-        }
-    // If there is no '.' character found which means no file extension.
-    } else {
-        if(write_message(sockfd_to_send, "application/octet-stream") == WRITE_ERROR) {
-            return WRITE_ERROR;
-        }
-    }
-    return WRITE_SUCCESSFUL;
-}
-
+//
+// Created by User on 14/5/2022.
+//
+#include "respond.h"
+
+static bool send_response_part(int sockfd_to_send, http_response_t *response);
+static void report_send_error(const char *function_name);
+static void reset_http_response(http_response_t *response, http_request_t *request);
+static void add_response_buffer(http_response_t *response, const void *data, size_t length);
+static void format_response_headers(http_response_t *response, char *protocol_version, char *status,
+                                    const char *content_type, off_t content_length, const char *extra_headers);
+static void prepare_file_body(http_response_t *response, http_request_t *request, off_t file_size);
+static void send_body_from_mapping(http_response_t *response, const char *mapping);
+static void prepare_not_modified_response(http_response_t *response, http_request_t *request);
+static void prepare_multipart_body(http_response_t *response, http_request_t *request,
+                                   const char *representation_headers);
+static size_t format_part_headers(http_response_t *response, int part);
+static void start_next_part(http_response_t *response);
+static void format_representation_headers(char *buffer, http_response_t *response, bool include_encoding);
+static bool prepare_encoded_response(http_response_t *response, http_request_t *encoded_request,
+                                     content_encoding_t content_encoding, server_config_t *config);
+
+// Numbers the boundaries of multipart/byteranges bodies.
+static atomic_ulong next_boundary = 1;
+
+// A function which has an argument representing the socket to send a message to and the message. Calls syscall write()
+// to send the message to the socket. Returns false in the case of an error; returns true otherwise.
+// The if(write_message() == WRITE_ERROR) statement is used across functions in this module to check if an error
+// occurred in write_message. In which case, the thread returns immediately back up to the serve_connection() function
+// which will then close the socket (drop the connection), free all memory and terminate itself.
+bool write_message(int sockfd_to_send, char *message) {
+    // Write message back
+    int n = write(sockfd_to_send, message, strlen(message));
+    if (n < 0) {
+        perror("write");
+        return WRITE_ERROR;
+    }
+    return WRITE_SUCCESSFUL;
+}
+
+// Function which has an argument representing the socket to send the HTTP response back to as well as a response
+// prepared by prepare_http_response. It writes the headers and then sends the body of the file (if any) with
+// sendfile, blocking until everything has been sent. Returns false if a write error or a sendfile error occurs, in
+// which case the caller drops the connection by closing the socket and frees the memory as usual.
+bool send_http_response(int sockfd_to_send, http_response_t *response) {
+    bool file_body = response->file_fd != NO_FILE_DESCRIPTOR;
+
+    // A multipart body goes round once for each of its parts.
+    do {
+        if(!send_response_part(sockfd_to_send, response)) {
+            return WRITE_ERROR;
+        }
+    } while(response_next_part(response));
+    if(file_body) {
+        record_body_sent(response);
+    }
+    return WRITE_SUCCESSFUL;
+}
+
+// Sends the response's buffers and then its range of the file, blocking until everything has been sent. For most
+// responses that is the whole response; for a multipart body it is one part. Returns false if a write error or a
+// sendfile error occurs.
+static bool send_response_part(int sockfd_to_send, http_response_t *response) {
+    // The headers were all formatted into one buffer, write them out in full first (along with the body if it is in
+    // memory).
+    while(!response_buffers_sent(response)) {
+        if(write_response_buffers(sockfd_to_send, response) < 0) {
+            report_send_error("sendmsg");
+            return WRITE_ERROR;
+        }
+    }
+    record_headers_sent(response);
+
+    // Benefits of sendfile(): sendfile() does it's copying from file to file in the kernel instead of the user
+    // space which is more efficient. User space operations such as read() and write() are I/O operations which
+    // require a system call as we were taught in the earlier weeks of the subject. Furthermore, as we were
+    // taught before (or explored during a tute with the tutor), doing a system call is quite expensive and
+    // hence why sendfile() is faster. This is reflected in the Linux manual page
+    // https://man7.org/linux/man-pages/man2/sendfile.2.html. Furthermore, in terms of code
+    // simplicity, there is no need to do separate calls to read the file and write the contents to the socket.
+    // There would also be no need to declare or size a buffer with consideration of the file size and to
+    // concatenate the file contents to the buffer if the approach was to have everything in a buffer and
+    // write it all at once.
+
+    // Track the bytes sent by sendfile() and make sure that all bytes are sent. sendfile advances body_offset by
+    // the number of bytes it sent by itself, so there is no need to add them on separately.
+    while(response_file_body_pending(response)) {
+        // sendfile returns -1 in the case of an error or the number of bytes successfully sent as per the
+        // linux manual located at https://man7.org/linux/man-pages/man2/sendfile.2.html.
+        ssize_t bytes_successfully_sent = sendfile(sockfd_to_send, response->file_fd, &response->body_offset,
+                                                   response->body_end - response->body_offset);
+        if(bytes_successfully_sent < 0) {
+            report_send_error("sendfile");
+            return WRITE_ERROR;
+        }
+        // The file got shorter after it was opened. The Content-Length has already gone out, so the connection has
+        // to be dropped.
+        if(bytes_successfully_sent == 0) {
+            return WRITE_ERROR;
+        }
+        stats_count(STATS_FILE_BYTES_SENT, bytes_successfully_sent);
+    }
+    return WRITE_SUCCESSFUL;
+}
+
+// A blocking socket whose send timeout runs out fails the write with EAGAIN, which means the client stopped taking
+// the response rather than that something went wrong, so it is counted instead of being printed.
+static void report_send_error(const char *function_name) {
+    if(errno == EAGAIN || errno == EWOULDBLOCK) {
+        stats_count(STATS_CONNECTIONS_TIMED_OUT, 1);
+    } else {
+        perror(function_name);
+    }
+}
+
+// Writes as much of the response's buffers as the socket will take with a single sendmsg call, skipping over whatever
+// has already been sent, and advances buffers_sent past whatever was written. Replaces the separate write() calls for
+// each piece of the headers, which cost a system call (and often a TCP segment) each. If a body is going to follow
+// from a file, MSG_MORE tells the kernel to hold on to the headers so that they leave in the same segment as the
+// first bytes sent by sendfile instead of in a tiny segment of their own. Returns the number of bytes written, or -1
+// with errno set by sendmsg. https://man7.org/linux/man-pages/man2/sendmsg.2.html
+ssize_t write_response_buffers(int sockfd_to_send, http_response_t *response) {
+    struct iovec unsent_buffers[MAX_RESPONSE_BUFFERS];
+    int num_unsent_buffers = get_unsent_response_buffers(response, unsent_buffers);
+
+    struct msghdr message = {.msg_iov = unsent_buffers, .msg_iovlen = num_unsent_buffers};
+    int flags = MSG_NOSIGNAL;
+    if(response_file_body_pending(response)) {
+        flags |= MSG_MORE;
+    }
+
+    ssize_t n = sendmsg(sockfd_to_send, &message, flags);
+    if(n > 0) {
+        response->buffers_sent += n;
+    }
+    return n;
+}
+
+// Fills in unsent_buffers (which has room for MAX_RESPONSE_BUFFERS) with the parts of the response's buffers that
+// have not been sent yet, and returns how many of them there are.
+int get_unsent_response_buffers(http_response_t *response, struct iovec *unsent_buffers) {
+    int num_unsent_buffers = 0;
+    size_t bytes_to_skip = response->buffers_sent;
+
+    for(int i = 0; i < response->num_buffers; i++) {
+        if(bytes_to_skip >= response->buffers[i].iov_len) {
+            bytes_to_skip -= response->buffers[i].iov_len;
+            continue;
+        }
+        unsent_buffers[num_unsent_buffers].iov_base = (char *) response->buffers[i].iov_base + bytes_to_skip;
+        unsent_buffers[num_unsent_buffers].iov_len = response->buffers[i].iov_len - bytes_to_skip;
+        num_unsent_buffers++;
+        bytes_to_skip = 0;
+    }
+    return num_unsent_buffers;
+}
+
+// Returns true if some of the response's body still has to be sent from its file.
+bool response_file_body_pending(http_response_t *response) {
+    return response->file_fd != NO_FILE_DESCRIPTOR && response->body_offset < response->body_end;
+}
+
+// Returns true once the response's buffers have been written in full. A body that is sent from a file is not covered
+// by this.
+bool response_buffers_sent(http_response_t *response) {
+    return response->buffers_sent == response->buffers_length;
+}
+
+// Returns how many bytes of the response have been sent so far, headers included.
+off_t response_bytes_sent(http_response_t *response) {
+    return response->earlier_parts_sent + (off_t) response->buffers_sent + response->body_offset - response->body_start;
+}
+
+// Called once everything the response has to send has been sent. If the response is a multipart body with parts
+// still to go, sets up the next one (or the closing boundary) to be sent in the same way and returns true. Returns
+// false once the response is done.
+bool response_next_part(http_response_t *response) {
+    if(response->next_range == 0 || response->next_range > response->num_ranges) {
+        return false;
+    }
+    response->earlier_parts_sent = response_bytes_sent(response);
+    response->num_buffers = 0;
+    response->buffers_length = 0;
+    response->buffers_sent = 0;
+    start_next_part(response);
+    stats_count(STATS_MEMORY_BYTES_SENT, response->buffers_length);
+    return true;
+}
+
+// Called once the response's buffers have all been sent, which may be more than once for the same response. The
+// first time, counts the bytes and records how long it took since the response was prepared, and starts timing the
+// body.
+void record_headers_sent(http_response_t *response) {
+    if(response->headers_timed) {
+        return;
+    }
+    response->headers_timed = true;
+    stats_count(STATS_MEMORY_BYTES_SENT, response->buffers_length);
+    response->stage_started_at = stats_record(STATS_STAGE_HEADER_WRITE, response->stage_started_at);
+}
+
+// Called once the body of a response from a file has been sent, to record how long that took. The bytes are counted
+// as they are sent.
+void record_body_sent(http_response_t *response) {
+    stats_record(STATS_STAGE_BODY_SEND, response->stage_started_at);
+}
+
+// A function that works out the MIME content type of the file located at file_path from its extension and returns
+// it as a string constant. content_encoding is how the file is being sent: a precompressed copy picked for a client
+// has the content type of the file it is a copy of, so the suffix of its encoding is left off and the extension before
+// it is the one that counts. Anything sent as it is keeps its whole name, so "archive.tar.gz" is a gzip file.
+const char *get_content_type(char *file_path, content_encoding_t content_encoding) {
+    char *extension = NULL;
+    char *path_end = file_path + strlen(file_path) - strlen(get_encoding_suffix(content_encoding));
+
+    // Find the last occurrence of the FILE_EXTENSION_DELIMITER which is the '.' character. This deals with "false"
+    // extensions in the file_path. Handling '.' characters that are not associated with an extension is handled
+    // below.
+    for(char *position = file_path; position < path_end; position++) {
+        if(*position == FILE_EXTENSION_DELIMITER) {
+            extension = position;
+        }
+    }
+
+    // If there is a '.' character found in the file_path, the content type for what comes after it is looked up in
+    // the MIME table generated from mime.types. Something after a '.' which is not a file extension (like the rest
+    // of a path with a '.' in a directory name) is never in the table, and gets DEFAULT_CONTENT_TYPE like a path
+    // with no '.' at all.
+    if(extension != NULL) {
+        string_view_t extension_view = {.data = extension + FILE_EXTENSION_DELIMITER_LENGTH,
+                                        .length = path_end - extension - FILE_EXTENSION_DELIMITER_LENGTH};
+        return get_extension_content_type(extension_view);
+    }
+    return DEFAULT_CONTENT_TYPE;
+}
+
+// Returns true if responses with the content type can be sent precompressed, and so depend on the request's
+// Accept-Encoding. Only text is worth compressing, since images like JPEGs are already compressed.
+bool response_varies_by_encoding(const char *content_type) {
+    if(!encoding_enabled() || content_type == NULL) {
+        return false;
+    }
+    return strcmp(content_type, HTML_CONTENT_TYPE) == SAME_STRING ||
+           strcmp(content_type, CSS_CONTENT_TYPE) == SAME_STRING ||
+           strcmp(content_type, JAVA_SCRIPT_CONTENT_TYPE) == SAME_STRING;
+}
+
+// Function which takes a single complete request (as found by find_request_end) and prepares the response to it. If
+// the request is invalid or cannot be turned into a file path, it gets a 404 like in the original server. Otherwise
+// the caches are tried first, and if the response cannot be made from them, the file is opened (through the file
+// cache when it is enabled) and small files are rendered into the response cache.
+void prepare_response_to_request(http_response_t *response, const char *request_buffer, size_t request_length,
+                                 server_config_t *config) {
+    http_request_t request;
+    char file_path_buffer[FILE_PATH_BUFFER_SIZE];
+    char *file_path = NULL;
+
+    if(!parse_request_with_stats(request_buffer, request_length, &request)) {
+        prepare_http_response(response, NULL, NULL);
+        return;
+    }
+    if(prepare_precompressed_response(response, &request, config)) {
+        return;
+    }
+    if(prepare_response_from_caches(response, &request, config)) {
+        return;
+    }
+
+    if(config->file_cache != NULL) {
+        file_cache_entry_t *entry = file_cache_acquire(config->file_cache, request.request_path,
+                                                       CONTENT_ENCODING_IDENTITY);
+        prepare_cached_http_response(response, &request, entry);
+        file_path = entry == NULL ? NULL : entry->file_path;
+    } else {
+        // prepare_http_response turns a NULL file path into a 404.
+        if(get_file_path(file_path_buffer, request.request_path)) {
+            file_path = file_path_buffer;
+        }
+        prepare_http_response(response, &request, file_path);
+    }
+
+    add_response_to_cache(response, &request, file_path, config);
+}
+
+// Same as parse_request, but counts the request (and whether it was invalid) and times the parsing.
+bool parse_request_with_stats(const char *request_buffer, size_t request_length, http_request_t *request) {
+    long start_time = stats_now();
+    bool valid = parse_request(request_buffer, request_length, request);
+    stats_record(STATS_STAGE_PARSE, start_time);
+    stats_count(STATS_REQUESTS, 1);
+    if(!valid) {
+        stats_count(STATS_INVALID_REQUESTS, 1);
+    }
+    return valid;
+}
+
+// Prepares the response to a parsed request without opening anything, if that can be done. Requests with escape
+// components get a 404, and so do requests for paths which are not in the index when the web root is indexed.
+// Requests for the stats endpoint (when stats are enabled) get the stats. When the response cache is enabled, a
+// rendered response is used if there is one. When the file cache is enabled, a file that is already open in it is
+// used. Returns false if none of these apply and the
+// file has to be opened, in which case nothing has been prepared.
+bool prepare_response_from_caches(http_response_t *response, http_request_t *request, server_config_t *config) {
+    if(stats_enabled()) {
+        if(string_view_equals(request->request_path, STATS_PATH)) {
+            prepare_stats_http_response(response, request, false);
+            return true;
+        }
+        if(string_view_equals(request->request_path, STATS_JSON_PATH)) {
+            prepare_stats_http_response(response, request, true);
+            return true;
+        }
+    }
+
+    // Both caches are keyed by request path, so escape components have to be ruled out before looking them up.
+    if(check_escape_request_path(request->request_path)) {
+        prepare_http_response(response, request, NULL);
+        return true;
+    }
+    // With the web root indexed, a path that is not in the index is known to have no file without looking any
+    // further, which keeps requests for missing files from costing a failed open each.
+    if(web_index_enabled() && !web_index_contains(request->request_path)) {
+        prepare_http_response(response, request, NULL);
+        return true;
+    }
+
+    // The response cache only holds whole files, so requests for ranges are served from the file instead.
+    if(config->response_cache != NULL && find_header(request, RANGE_HEADER) == NULL) {
+        response_cache_entry_t *rendered_response = response_cache_acquire(config->response_cache,
+                                                                           request->request_path,
+                                                                           CONTENT_ENCODING_IDENTITY);
+        if(rendered_response != NULL) {
+            stats_count(STATS_RESPONSE_CACHE_HITS, 1);
+            prepare_memory_http_response(response, request, rendered_response);
+            return true;
+        }
+        stats_count(STATS_RESPONSE_CACHE_MISSES, 1);
+    }
+
+    if(config->file_cache != NULL) {
+        file_cache_entry_t *entry = file_cache_find(config->file_cache, request->request_path,
+                                                    CONTENT_ENCODING_IDENTITY);
+        if(entry != NULL) {
+            stats_count(STATS_FILE_CACHE_HITS, 1);
+            prepare_cached_http_response(response, request, entry);
+            add_response_to_cache(response, request, entry->file_path, config);
+            return true;
+        }
+        stats_count(STATS_FILE_CACHE_MISSES, 1);
+    }
+    return false;
+}
+
+// Renders the response to a file that had to be opened into the response cache, if it is enabled and the file is
+// small enough. Only requests which looked the response cache up and missed get here with something to add: requests
+// for ranges never look it up, so they leave it alone rather than rendering the whole file again on every one.
+void add_response_to_cache(http_response_t *response, http_request_t *request, char *file_path,
+                           server_config_t *config) {
+    if(config->response_cache != NULL && response->file_fd != NO_FILE_DESCRIPTOR &&
+            find_header(request, RANGE_HEADER) == NULL) {
+        response_cache_store(config->response_cache, request->request_path, file_path, response->file_fd,
+                             &response->file_stat, response->content_type, response->content_encoding);
+    }
+}
+
+// Prepares the response to a request for a text file from a precompressed copy of it (made by the precompress tool)
+// when serving them is turned on, the client accepts the copy's encoding and the copy exists. The copies go through
+// the caches under the request path with the encoding's suffix added on, along with the encoding, so they are never
+// mixed up with a request for the copy itself, which is sent as it is. Returns false if there
+// is no copy to send, in which case nothing has been prepared and the file itself is sent instead. The uring workers
+// call this too, so for them a copy which is not cached yet is opened with a blocking open().
+bool prepare_precompressed_response(http_response_t *response, http_request_t *request, server_config_t *config) {
+    content_encoding_t encodings[NUM_PRECOMPRESSED_ENCODINGS];
+    char encoded_path[ENCODED_REQUEST_PATH_BUFFER_SIZE];
+    string_view_t request_path = request->request_path;
+
+    if(!encoding_enabled() || request_path.length + ENCODING_SUFFIX_MAX_LENGTH >= ENCODED_REQUEST_PATH_BUFFER_SIZE) {
+        return false;
+    }
+    memcpy(encoded_path, request_path.data, request_path.length);
+    encoded_path[request_path.length] = '\0';
+    if(!response_varies_by_encoding(get_content_type(encoded_path, CONTENT_ENCODING_IDENTITY))) {
+        return false;
+    }
+
+    int num_encodings = get_accepted_encodings(request, encodings);
+    for(int i = 0; i < num_encodings; i++) {
+        const char *suffix = get_encoding_suffix(encodings[i]);
+        strcpy(encoded_path + request_path.length, suffix);
+        // The request is pointed at the copy just while its response is prepared, rather than copying the whole
+        // request. The response goes back to logging the path that was asked for.
+        request->request_path.data = encoded_path;
+        request->request_path.length = request_path.length + strlen(suffix);
+        bool prepared = prepare_encoded_response(response, request, encodings[i], config);
+        request->request_path = request_path;
+        if(prepared) {
+            response->request_path = request_path;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Prepares the response to a request whose path has been pointed at a precompressed copy of a file, which is sent
+// with content_encoding, in the same way as prepare_response_to_request but without a 404 when the copy does not
+// exist. Returns false in that case.
+static bool prepare_encoded_response(http_response_t *response, http_request_t *encoded_request,
+                                     content_encoding_t content_encoding, server_config_t *config) {
+    if(check_escape_request_path(encoded_request->request_path)) {
+        return false;
+    }
+    if(web_index_enabled() && !web_index_contains(encoded_request->request_path)) {
+        return false;
+    }
+
+    if(config->response_cache != NULL && find_header(encoded_request, RANGE_HEADER) == NULL) {
+        response_cache_entry_t *rendered_response = response_cache_acquire(config->response_cache,
+                                                                           encoded_request->request_path,
+                                                                           content_encoding);
+        if(rendered_response != NULL) {
+            stats_count(STATS_RESPONSE_CACHE_HITS, 1);
+            prepare_memory_http_response(response, encoded_request, rendered_response);
+            return true;
+        }
+        stats_count(STATS_RESPONSE_CACHE_MISSES, 1);
+    }
+
+    if(config->file_cache != NULL) {
+        file_cache_entry_t *entry = file_cache_acquire(config->file_cache, encoded_request->request_path,
+                                                       content_encoding);
+        if(entry == NULL) {
+            return false;
+        }
+        prepare_cached_http_response(response, encoded_request, entry);
+        add_response_to_cache(response, encoded_request, entry->file_path, config);
+        return true;
+    }
+
+    char file_path[FILE_PATH_BUFFER_SIZE];
+    struct stat file_stat;
+    if(!get_file_path(file_path, encoded_request->request_path)) {
+        return false;
+    }
+    long start_time = stats_now();
+    int file_fd = web_root_open_file(file_path);
+    bool opened = file_fd >= 0 && fstat(file_fd, &file_stat) == 0;
+    stats_record(STATS_STAGE_OPEN, start_time);
+    if(!opened || !S_ISREG(file_stat.st_mode)) {
+        if(file_fd >= 0) {
+            close(file_fd);
+        }
+        return false;
+    }
+    prepare_opened_http_response(response, encoded_request, file_path, file_fd, &file_stat, content_encoding);
+    add_response_to_cache(response, encoded_request, file_path, config);
+    return true;
+}
+
+// Function which works out the response to a request for the file located at file_path without sending anything.
+// This function opens the file and then hands it to prepare_opened_http_response, which leaves it open so the body
+// can be sent later. A NULL file_path means the request could not be turned into a file path, and a NULL request
+// means the request itself was invalid, in which case the connection is closed after the response.
+void prepare_http_response(http_response_t *response, http_request_t *request, char *file_path) {
+    // stat struct from standard library which will allow access to the file size
+    struct stat file_stat;
+    int file_fd = NO_FILE_DESCRIPTOR;
+
+    // If the file we're trying to read from does not exist (or is outside the web root), open will return -1 as per the
+    // linux manual located at https://man7.org/linux/man-pages/man2/open.2.html. Hence, if we cannot open what is
+    // located at the file path then we return a 404.
+    long start_time = stats_now();
+    if(request != NULL && file_path != NULL && (file_fd = web_root_open_file(file_path)) >= 0) {
+        if(fstat(file_fd, &file_stat) < 0) {
+            close(file_fd);
+            file_fd = NO_FILE_DESCRIPTOR;
+        }
+    }
+    if(request != NULL && file_path != NULL) {
+        stats_record(STATS_STAGE_OPEN, start_time);
+    }
+    prepare_opened_http_response(response, request, file_path, file_fd, &file_stat, CONTENT_ENCODING_IDENTITY);
+}
+
+// Same as prepare_http_response, but for a file which has already been opened and stat'ed (or failed to open, in
+// which case file_fd is NO_FILE_DESCRIPTOR). This does several checks to determine that the file is valid and then
+// formats the headers of an appropriate HTTP response into the headers buffer of the response struct. The response
+// takes over the file descriptor, which is closed straight away if the file cannot be served. content_encoding is
+// how the body is sent, which is CONTENT_ENCODING_IDENTITY unless the file is a precompressed copy picked for the
+// client.
+void prepare_opened_http_response(http_response_t *response, http_request_t *request, char *file_path, int file_fd,
+                                  struct stat *file_stat, content_encoding_t content_encoding) {
+    reset_http_response(response, request);
+    if(request == NULL) {
+        if(file_fd != NO_FILE_DESCRIPTOR) {
+            close(file_fd);
+        }
+        return;
+    }
+
+    if(file_fd != NO_FILE_DESCRIPTOR) {
+        // Test that the file_path leads to a regular file and not something else like a directory. The S_ISREG macro
+        // comes from the linux manual page, https://man7.org/linux/man-pages/man7/inode.7.html
+        if(S_ISREG(file_stat->st_mode)) {
+            response->file_fd = file_fd;
+            response->file_stat = *file_stat;
+            response->content_type = get_content_type(file_path, content_encoding);
+            response->content_encoding = content_encoding;
+            prepare_file_body(response, request, file_stat->st_size);
+            return;
+        }
+        close(file_fd);
+    }
+
+    // Otherwise, we send back a 404 not found response as well if the file_path does not lead to a regular file.
+    format_response_headers(response, request->protocol_version, NOT_FOUND_STATUS, NULL, 0, NULL);
+}
+
+// Same as prepare_http_response, but for a file that has been looked up in the file cache. The response holds on to
+// the cache entry until it is released, which keeps the file open even if the entry is evicted in the meantime. A
+// NULL entry means that there is no regular file for the request, which gets a 404.
+void prepare_cached_http_response(http_response_t *response, http_request_t *request, file_cache_entry_t *entry) {
+    reset_http_response(response, request);
+    if(request == NULL) {
+        return;
+    }
+
+    if(entry == NULL) {
+        format_response_headers(response, request->protocol_version, NOT_FOUND_STATUS, NULL, 0, NULL);
+        return;
+    }
+    response->cache_entry = entry;
+    response->file_fd = entry->fd;
+    response->file_stat = entry->file_stat;
+    response->content_type = entry->content_type;
+    response->content_encoding = entry->content_encoding;
+    prepare_file_body(response, request, entry->file_stat.st_size);
+    // A body that comes from one range of a mapped file (the whole file, or a single range of it) goes out from the
+    // mapping along with the headers. Multipart bodies are still sent a part at a time with sendfile.
+    if(entry->mapping != NULL && response->num_ranges == 0 && response_file_body_pending(response)) {
+        send_body_from_mapping(response, entry->mapping);
+    }
+}
+
+// Same as prepare_http_response, but for a response that was found already rendered in the response cache. Nothing
+// needs to be formatted or opened: the headers for the request's protocol version and connection handling are picked
+// out of the entry and the body is sent straight from memory. The response holds on to the entry until it is
+// released.
+void prepare_memory_http_response(http_response_t *response, http_request_t *request,
+                                  response_cache_entry_t *entry) {
+    reset_http_response(response, request);
+
+    int variant = 0;
+    if(strcmp(request->protocol_version, PROTOCOL_VER_1_1) == SAME_STRING) {
+        variant |= HEADER_VARIANT_HTTP_1_1;
+    }
+    if(response->keep_alive) {
+        variant |= HEADER_VARIANT_KEEP_ALIVE;
+    }
+
+    response->response_cache_entry = entry;
+    response->file_stat = entry->file_stat;
+    response->content_type = entry->content_type;
+    response->content_encoding = entry->content_encoding;
+    // Revalidations are answered from the entry too, without touching the file.
+    if(request_not_modified(request, &entry->file_stat)) {
+        prepare_not_modified_response(response, request);
+        return;
+    }
+    stats_count(STATS_RESPONSES_2XX, 1);
+    response->status_code = HTTP_OK;
+
+    // The Date line changes every second, so it is the one part of the headers that cannot be rendered up front. It
+    // goes in right after the status line.
+    char *variant_headers = entry->headers[variant];
+    size_t status_line_length = entry->status_line_length[variant];
+    char *remaining_headers = variant_headers + status_line_length;
+    size_t remaining_headers_length = entry->headers_length[variant] - status_line_length;
+
+    get_date_line(response->date_line);
+    add_response_buffer(response, variant_headers, status_line_length);
+    add_response_buffer(response, response->date_line, strlen(response->date_line));
+    // The most common variant sits right in front of the body, so the two can go out as one buffer.
+    if(remaining_headers + remaining_headers_length == entry->body) {
+        add_response_buffer(response, remaining_headers, remaining_headers_length + entry->body_length);
+    } else {
+        add_response_buffer(response, remaining_headers, remaining_headers_length);
+        add_response_buffer(response, entry->body, entry->body_length);
+    }
+}
+
+// Prepares a response with the server's stats (as rendered by render_stats) as its body, which is sent from memory.
+// If the stats could not be rendered, the response is a 404 instead.
+void prepare_stats_http_response(http_response_t *response, http_request_t *request, bool json) {
+    size_t body_length;
+
+    reset_http_response(response, request);
+    response->generated_body = render_stats(json, &body_length);
+    if(response->generated_body == NULL) {
+        format_response_headers(response, request->protocol_version, NOT_FOUND_STATUS, NULL, 0, NULL);
+        return;
+    }
+    response->content_type = json ? JSON_CONTENT_TYPE : TEXT_CONTENT_TYPE;
+    format_response_headers(response, request->protocol_version, OK_STATUS, response->content_type, body_length,
+                            NULL);
+    add_response_buffer(response, response->generated_body, body_length);
+}
+
+// Sets up the body of a response for a regular file, which has been put in the response, and formats its headers.
+// A client which already has this version of the file gets a 304 with no body. Otherwise, without a Range header (or
+// with one that is ignored or whose If-Range condition fails) the whole file is sent with a 200. A single range is
+// sent with a 206 and a Content-Range header, and several ranges as a multipart/byteranges body. If none of the
+// ranges are in the file, the response is a 416 with nothing from the file in it. Every response with (part of) the
+// file in it carries its ETag and Last-Modified validators, along with how it is encoded.
+// https://datatracker.ietf.org/doc/html/rfc9110#section-15.3.7
+static void prepare_file_body(http_response_t *response, http_request_t *request, off_t file_size) {
+    char extra_headers[EXTRA_HEADERS_BUFFER_SIZE];
+    char representation_headers[REPRESENTATION_HEADERS_BUFFER_SIZE];
+    string_view_t *range_header = find_header(request, RANGE_HEADER);
+    range_result_t range_result = RANGE_IGNORED;
+
+    if(request_not_modified(request, &response->file_stat)) {
+        prepare_not_modified_response(response, request);
+        return;
+    }
+    format_representation_headers(representation_headers, response, true);
+    if(range_header != NULL && range_condition_holds(request, &response->file_stat)) {
+        range_result = parse_range(*range_header, file_size, response->ranges, &response->num_ranges);
+    }
+    switch(range_result) {
+        case RANGE_IGNORED:
+            response->num_ranges = 0;
+            response->body_end = file_size;
+            snprintf(extra_headers, EXTRA_HEADERS_BUFFER_SIZE, "%s%s", representation_headers, ACCEPT_RANGES_HEADER);
+            format_response_headers(response, request->protocol_version, OK_STATUS, response->content_type,
+                                    file_size, extra_headers);
+            break;
+        case RANGE_NOT_SATISFIABLE:
+            snprintf(extra_headers, EXTRA_HEADERS_BUFFER_SIZE, UNSATISFIED_CONTENT_RANGE_FORMAT, (long long) file_size);
+            format_response_headers(response, request->protocol_version, RANGE_NOT_SATISFIABLE_STATUS, NULL, 0,
+                                    extra_headers);
+            break;
+        case RANGE_SATISFIABLE:
+            if(response->num_ranges > 1) {
+                prepare_multipart_body(response, request, representation_headers);
+                break;
+            }
+            // sendfile starts from body_offset, so a single range only needs the offsets changing.
+            response->num_ranges = 0;
+            response->body_start = response->ranges[0].first;
+            response->body_offset = response->ranges[0].first;
+            response->body_end = response->ranges[0].last + 1;
+            int length = snprintf(extra_headers, EXTRA_HEADERS_BUFFER_SIZE, "%s", representation_headers);
+            snprintf(extra_headers + length, EXTRA_HEADERS_BUFFER_SIZE - length, CONTENT_RANGE_FORMAT,
+                     (long long) response->ranges[0].first, (long long) response->ranges[0].last,
+                     (long long) file_size);
+            format_response_headers(response, request->protocol_version, PARTIAL_CONTENT_STATUS,
+                                    response->content_type, response->body_end - response->body_start,
+                                    extra_headers);
+            break;
+    }
+}
+
+// Moves the response's range of the file into its buffers, from the file's mapping, so that it is sent along with the
+// headers instead of with sendfile. The range is marked as already sent from the file, which leaves nothing for
+// sendfile to do and keeps the body from being counted twice in the bytes sent. The mapping stays put for as long
+// as the response holds on to its file cache entry.
+static void send_body_from_mapping(http_response_t *response, const char *mapping) {
+    add_response_buffer(response, mapping + response->body_offset, response->body_end - response->body_offset);
+    response->body_start = response->body_end;
+    response->body_offset = response->body_end;
+}
+
+// Sets up a multipart/byteranges body for the response's ranges. The Content-Length has to cover every part, so
+// each part's headers are formatted once here just to find out how long they are. The first part then goes out with
+// the response's headers, and response_next_part moves on to the others.
+static void prepare_multipart_body(http_response_t *response, http_request_t *request,
+                                   const char *representation_headers) {
+    char content_type[MULTIPART_CONTENT_TYPE_BUFFER_SIZE];
+    off_t content_length = 0;
+
+    snprintf(response->boundary, BOUNDARY_BUFFER_SIZE, BOUNDARY_FORMAT, atomic_fetch_add(&next_boundary, 1));
+    for(int part = 0; part < response->num_ranges; part++) {
+        content_length += format_part_headers(response, part);
+        content_length += response->ranges[part].last - response->ranges[part].first + 1;
+    }
+    content_length += format_part_headers(response, response->num_ranges);
+
+    snprintf(content_type, MULTIPART_CONTENT_TYPE_BUFFER_SIZE, MULTIPART_CONTENT_TYPE_FORMAT, response->boundary);
+    format_response_headers(response, request->protocol_version, PARTIAL_CONTENT_STATUS, content_type,
+                            content_length, representation_headers);
+    start_next_part(response);
+}
+
+// Prepares a 304 for the file in the response, with the same validators (and Vary) a 200 would have had but no body.
+// The Content-Length is the one the 200 would have had, which RFC 9110 allows and which is what format_headers always
+// sends anyway. https://datatracker.ietf.org/doc/html/rfc9110#section-15.4.5
+static void prepare_not_modified_response(http_response_t *response, http_request_t *request) {
+    char representation_headers[REPRESENTATION_HEADERS_BUFFER_SIZE];
+    format_representation_headers(representation_headers, response, false);
+    response->body_end = response->body_offset;
+    format_response_headers(response, request->protocol_version, NOT_MODIFIED_STATUS, NULL,
+                            response->file_stat.st_size, representation_headers);
+}
+
+// Formats the validators of the file in the response into buffer, which must hold REPRESENTATION_HEADERS_BUFFER_SIZE
+// characters, followed by its Content-Encoding if include_encoding is set and Vary if it could have been sent
+// encoded differently.
+static void format_representation_headers(char *buffer, http_response_t *response, bool include_encoding) {
+    format_validator_headers(buffer, &response->file_stat);
+    format_encoding_headers(buffer + strlen(buffer),
+                            include_encoding ? response->content_encoding : CONTENT_ENCODING_IDENTITY,
+                            response_varies_by_encoding(response->content_type));
+}
+
+// Formats the headers of one part of a multipart body into the response's part headers buffer and returns their
+// length. The part after the last range is the closing boundary.
+static size_t format_part_headers(http_response_t *response, int part) {
+    int length;
+    if(part == response->num_ranges) {
+        length = snprintf(response->part_headers, PART_HEADERS_BUFFER_SIZE, CLOSING_BOUNDARY_FORMAT,
+                          response->boundary);
+    } else {
+        length = snprintf(response->part_headers, PART_HEADERS_BUFFER_SIZE, PART_HEADERS_FORMAT, response->boundary,
+                          response->content_type, (long long) response->ranges[part].first,
+                          (long long) response->ranges[part].last, (long long) response->file_stat.st_size);
+    }
+    return (size_t) length;
+}
+
+// Adds the headers of the next part of a multipart body to the response's buffers and points the body at the part's
+// range of the file. The closing boundary has no range.
+static void start_next_part(http_response_t *response) {
+    int part = response->next_range;
+    add_response_buffer(response, response->part_headers, format_part_headers(response, part));
+    if(part < response->num_ranges) {
+        response->body_start = response->ranges[part].first;
+        response->body_end = response->ranges[part].last + 1;
+    } else {
+        response->body_start = response->body_end;
+    }
+    response->body_offset = response->body_start;
+    response->next_range++;
+}
+
+// Puts a response back into its starting state, with nothing to send yet. If there is no request, the response is
+// set up as the canned 404 which closes the connection.
+static void reset_http_response(http_response_t *response, http_request_t *request) {
+    response->num_buffers = 0;
+    response->buffers_length = 0;
+    response->buffers_sent = 0;
+    response->file_fd = NO_FILE_DESCRIPTOR;
+    response->content_type = NULL;
+    response->content_encoding = CONTENT_ENCODING_IDENTITY;
+    response->cache_entry = NULL;
+    response->response_cache_entry = NULL;
+    response->body_offset = 0;
+    response->body_end = 0;
+    response->body_start = 0;
+    response->num_ranges = 0;
+    response->next_range = 0;
+    response->earlier_parts_sent = 0;
+    response->generated_body = NULL;
+    response->stage_started_at = stats_now();
+    response->headers_timed = false;
+    response->status_code = NO_STATUS_CODE;
+
+    if(request == NULL) {
+        response->request_path = (string_view_t) {NULL, 0};
+        response->protocol_version = NULL;
+        response->keep_alive = false;
+        format_response_headers(response, PROTOCOL_VER, NOT_FOUND_STATUS, NULL, 0, NULL);
+        return;
+    }
+    response->request_path = request->request_path;
+    response->protocol_version = request->protocol_version;
+    // A server that is draining closes every connection once its current response is sent, and says so in the
+    // response, so that the client sends its next request to whichever server is taking over.
+    response->keep_alive = request->keep_alive && !draining();
+}
+
+// Adds a buffer to the end of the list of buffers to send for a response. Empty buffers are left out.
+static void add_response_buffer(http_response_t *response, const void *data, size_t length) {
+    if(length == 0) {
+        return;
+    }
+    response->buffers[response->num_buffers].iov_base = (void *) data;
+    response->buffers[response->num_buffers].iov_len = length;
+    response->num_buffers++;
+    response->buffers_length += length;
+}
+
+// Formats the status line and the whole header block of a response (Date included) into its headers buffer, to be
+// sent as one buffer.
+static void format_response_headers(http_response_t *response, char *protocol_version, char *status,
+                                    const char *content_type, off_t content_length, const char *extra_headers) {
+    // Status codes are counted by their first digit.
+    response->status_code = atoi(status);
+    switch(status[0]) {
+        case '2':
+            stats_count(STATS_RESPONSES_2XX, 1);
+            break;
+        case '3':
+            stats_count(STATS_RESPONSES_3XX, 1);
+            break;
+        case '4':
+            stats_count(STATS_RESPONSES_4XX, 1);
+            break;
+        default:
+            stats_count(STATS_RESPONSES_5XX, 1);
+            break;
+    }
+    get_date_line(response->date_line);
+    size_t headers_length = format_headers(response->headers, RESPONSE_HEADER_BUFFER_SIZE, protocol_version,
+                                           status, response->date_line, content_type, content_length,
+                                           response->keep_alive, extra_headers);
+    add_response_buffer(response, response->headers, headers_length);
+}
+
+// Formats the status line and headers of a response into buffer and returns their length. The Date line (as made by
+// get_date_line), the Content-Type header and the extra headers (whole header lines) are left out if they are NULL.
+// The Connection header always states what will happen to the connection, since the default differs between HTTP/1.0
+// and HTTP/1.1. Also used by the response cache to render its headers.
+size_t format_headers(char *buffer, size_t buffer_size, char *protocol_version, char *status, char *date_line,
+                      const char *content_type, off_t content_length, bool keep_alive, const char *extra_headers) {
+    int length = snprintf(buffer, buffer_size, "%s %s\r\n", protocol_version, status);
+    if(date_line != NULL) {
+        length += snprintf(buffer + length, buffer_size - length, "%s", date_line);
+    }
+    if(content_type != NULL) {
+        length += snprintf(buffer + length, buffer_size - length, "Content-Type: %s\r\n", content_type);
+    }
+    if(extra_headers != NULL) {
+        length += snprintf(buffer + length, buffer_size - length, "%s", extra_headers);
+    }
+    length += snprintf(buffer + length, buffer_size - length, "Content-Length: %lld\r\nConnection: %s\r\n\r\n",
+                       (long long) content_length, keep_alive ? KEEP_ALIVE_OPTION : CLOSE_OPTION);
+    return length;
+}
+
+// Copies the Date header line for the current time into date_line, which must hold DATE_LINE_BUFFER_SIZE characters.
+// The date only changes once a second, so each thread keeps the last line it formatted and only calls gmtime_r and
+// strftime again when the second has changed. https://datatracker.ietf.org/doc/html/rfc9110#section-6.6.1
+void get_date_line(char *date_line) {
+    static __thread time_t cached_time = 0;
+    static __thread char cached_date_line[DATE_LINE_BUFFER_SIZE];
+
+    time_t now = time(NULL);
+    if(now != cached_time) {
+        struct tm now_gmt;
+        gmtime_r(&now, &now_gmt);
+        strftime(cached_date_line, DATE_LINE_BUFFER_SIZE, HTTP_DATE_FORMAT, &now_gmt);
+        cached_time = now;
+    }
+    strcpy(date_line, cached_date_line);
+}
+
+// Closes the file that was opened by prepare_http_response, if there is one, or hands the file or rendered response
+// back to the cache it came from. A generated body is freed. The response is left without a status code, which tells
+// the access log that there is nothing more to log for it.
+void release_http_response(http_response_t *response) {
+    response->status_code = NO_STATUS_CODE;
+    free(response->generated_body);
+    response->generated_body = NULL;
+    if(response->response_cache_entry != NULL) {
+        response_cache_release(response->response_cache_entry);
+        response->response_cache_entry = NULL;
+    } else if(response->cache_entry != NULL) {
+        file_cache_release(response->cache_entry);
+        response->cache_entry = NULL;
+        response->file_fd = NO_FILE_DESCRIPTOR;
+    } else if(response->file_fd != NO_FILE_DESCRIPTOR) {
+        close(response->file_fd);
+        response->file_fd = NO_FILE_DESCRIPTOR;
+    }
+}
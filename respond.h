@@ -1,40 +1,193 @@
-//
-// Created by User on 14/5/2022.
-//
-
-#ifndef COMP30023_2022_PROJECT_2_RESPOND_H
-#define COMP30023_2022_PROJECT_2_RESPOND_H
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
-#include <stdbool.h>
-
-#include <sys/sendfile.h>
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <fcntl.h>
-#include <pthread.h>
-
-#define FILE_EXTENSION_DELIMITER '.'
-#define HTML_EXTENSION ".html"
-#define JPEG_EXTENSION ".jpg"
-#define CSS_EXTENSION ".css"
-#define JAVA_SCRIPT_EXTENSION ".js"
-
-#define ZERO_OFFSET 1
-#define NULL_TERMINATOR_SPACE 1
-
-#define WRITE_ERROR 0
-#define WRITE_SUCCESSFUL 1
-
-#define SAME_STRING 0
-
-bool write_message(int sockfd_to_send, char *message);
-
-void send_http_response(int sockfd_to_send, char *file_path);
-
-bool write_content_type(int sockfd_to_send, char *file_path);
-
-#endif //COMP30023_2022_PROJECT_2_RESPOND_H
+//
+// Created by User on 14/5/2022.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_RESPOND_H
+#define COMP30023_2022_PROJECT_2_RESPOND_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "config.h"
+#include "parse.h"
+#include "file_cache.h"
+#include "response_cache.h"
+#include "stats.h"
+#include "range.h"
+#include "conditional.h"
+#include "encoding.h"
+#include "web_root.h"
+#include "mime.h"
+#include "web_index.h"
+#include "drain.h"
+
+#define FILE_EXTENSION_DELIMITER '.'
+#define FILE_EXTENSION_DELIMITER_LENGTH 1
+
+#define ZERO_OFFSET 1
+#define NULL_TERMINATOR_SPACE 1
+
+#define WRITE_ERROR 0
+#define WRITE_SUCCESSFUL 1
+
+#define SAME_STRING 0
+
+// The content types of the files that can be sent precompressed. The content type of every other file comes from the
+// MIME table.
+#define HTML_CONTENT_TYPE "text/html"
+#define CSS_CONTENT_TYPE "text/css"
+#define JAVA_SCRIPT_CONTENT_TYPE "text/javascript"
+#define TEXT_CONTENT_TYPE "text/plain"
+#define JSON_CONTENT_TYPE "application/json"
+
+#define OK_STATUS "200 OK"
+#define HTTP_OK 200
+#define PARTIAL_CONTENT_STATUS "206 Partial Content"
+#define NOT_MODIFIED_STATUS "304 Not Modified"
+#define RANGE_NOT_SATISFIABLE_STATUS "416 Range Not Satisfiable"
+// The status code of a response that has not been prepared, or has been released.
+#define NO_STATUS_CODE 0
+#define NOT_FOUND_STATUS "404 Not Found"
+
+// Canned responses for when there is no usable request to answer. Every response carries a Content-Length so that
+// clients on a persistent connection know where it ends.
+#define NOT_FOUND_RESPONSE "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"
+#define SERVICE_UNAVAILABLE_RESPONSE \
+    "HTTP/1.0 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"
+
+#define RESPONSE_HEADER_BUFFER_SIZE 512
+// Headers which only some responses have, formatted before being added to the rest.
+#define EXTRA_HEADERS_BUFFER_SIZE 320
+#define REPRESENTATION_HEADERS_BUFFER_SIZE (VALIDATOR_HEADERS_BUFFER_SIZE + ENCODING_HEADERS_BUFFER_SIZE)
+#define ACCEPT_RANGES_HEADER "Accept-Ranges: bytes\r\n"
+#define CONTENT_RANGE_FORMAT "Content-Range: bytes %lld-%lld/%lld\r\n"
+#define UNSATISFIED_CONTENT_RANGE_FORMAT "Content-Range: bytes */%lld\r\n"
+// A multipart/byteranges body is made of a part for each range, each with its own headers, and ends with a closing
+// boundary. Boundaries are numbered, so no two responses share one.
+// https://datatracker.ietf.org/doc/html/rfc9110#section-14.6
+#define MULTIPART_CONTENT_TYPE_FORMAT "multipart/byteranges; boundary=%s"
+#define MULTIPART_CONTENT_TYPE_BUFFER_SIZE 64
+#define PART_HEADERS_FORMAT "\r\n--%s\r\nContent-Type: %s\r\nContent-Range: bytes %lld-%lld/%lld\r\n\r\n"
+#define CLOSING_BOUNDARY_FORMAT "\r\n--%s--\r\n"
+#define PART_HEADERS_BUFFER_SIZE 256
+#define BOUNDARY_FORMAT "%020lu"
+#define BOUNDARY_BUFFER_SIZE 24
+#define DATE_LINE_BUFFER_SIZE 48
+#define HTTP_DATE_FORMAT "Date: %a, %d %b %Y %H:%M:%S GMT\r\n"
+#define NO_FILE_DESCRIPTOR -1
+#define MAX_RESPONSE_BUFFERS 4
+
+// A struct which holds a response that has been worked out but not necessarily sent yet. Everything that is sent from
+// memory is described by a short list of buffers: normally just the headers, which are formatted into a single buffer,
+// but for a response cache hit the pre-rendered headers and body with this response's Date line spliced in after the
+// status line. All of the buffers go out together in a single sendmsg call where possible. A body sent from a file is
+// described by an open file descriptor and the range of offsets that still need to be sent. This lets non-blocking
+// callers send the response a piece at a time as the socket becomes writable instead of blocking until everything has
+// gone out. A body that was generated for this response alone (the stats) is owned by it and freed when it is released.
+// A body made of several ranges of a file (a multipart/byteranges body) is sent one part at a time: the part's headers
+// go out as the buffers and then its range of the file as the body, until next_range has gone past the closing
+// boundary. body_start is where the range being sent starts, and earlier_parts_sent counts the bytes of the parts
+// before it. stage_started_at is when the stage of sending the response that is being timed started. The status code
+// and the request's path and protocol version are kept for the access log, with the path pointing into the request's
+// buffer, so they are only valid until the next request is read into it.
+typedef struct http_response http_response_t;
+struct http_response {
+    char headers[RESPONSE_HEADER_BUFFER_SIZE];
+    char date_line[DATE_LINE_BUFFER_SIZE];
+    struct iovec buffers[MAX_RESPONSE_BUFFERS];
+    int num_buffers;
+    size_t buffers_length;
+    size_t buffers_sent;
+    int file_fd;
+    off_t body_offset;
+    off_t body_end;
+    bool keep_alive;
+    struct stat file_stat;
+    const char *content_type;
+    content_encoding_t content_encoding;
+    file_cache_entry_t *cache_entry;
+    response_cache_entry_t *response_cache_entry;
+    char *generated_body;
+    long stage_started_at;
+    bool headers_timed;
+    int status_code;
+    string_view_t request_path;
+    const char *protocol_version;
+    off_t body_start;
+    byte_range_t ranges[MAX_BYTE_RANGES];
+    int num_ranges;
+    int next_range;
+    char boundary[BOUNDARY_BUFFER_SIZE];
+    char part_headers[PART_HEADERS_BUFFER_SIZE];
+    off_t earlier_parts_sent;
+};
+
+bool write_message(int sockfd_to_send, char *message);
+
+bool send_http_response(int sockfd_to_send, http_response_t *response);
+
+ssize_t write_response_buffers(int sockfd_to_send, http_response_t *response);
+
+int get_unsent_response_buffers(http_response_t *response, struct iovec *unsent_buffers);
+
+bool response_file_body_pending(http_response_t *response);
+
+bool response_buffers_sent(http_response_t *response);
+
+off_t response_bytes_sent(http_response_t *response);
+
+bool response_next_part(http_response_t *response);
+
+void record_headers_sent(http_response_t *response);
+
+void record_body_sent(http_response_t *response);
+
+size_t format_headers(char *buffer, size_t buffer_size, char *protocol_version, char *status, char *date_line,
+                      const char *content_type, off_t content_length, bool keep_alive, const char *extra_headers);
+
+void get_date_line(char *date_line);
+
+const char *get_content_type(char *file_path, content_encoding_t content_encoding);
+
+bool response_varies_by_encoding(const char *content_type);
+
+void prepare_response_to_request(http_response_t *response, const char *request_buffer, size_t request_length,
+                                 server_config_t *config);
+
+bool parse_request_with_stats(const char *request_buffer, size_t request_length, http_request_t *request);
+
+bool prepare_response_from_caches(http_response_t *response, http_request_t *request, server_config_t *config);
+
+bool prepare_precompressed_response(http_response_t *response, http_request_t *request, server_config_t *config);
+
+void add_response_to_cache(http_response_t *response, http_request_t *request, char *file_path,
+                           server_config_t *config);
+
+void prepare_http_response(http_response_t *response, http_request_t *request, char *file_path);
+
+void prepare_opened_http_response(http_response_t *response, http_request_t *request, char *file_path, int file_fd,
+                                  struct stat *file_stat, content_encoding_t content_encoding);
+
+void prepare_cached_http_response(http_response_t *response, http_request_t *request, file_cache_entry_t *entry);
+
+void prepare_memory_http_response(http_response_t *response, http_request_t *request,
+                                  response_cache_entry_t *entry);
+
+void prepare_stats_http_response(http_response_t *response, http_request_t *request, bool json);
+
+void release_http_response(http_response_t *response);
+
+#endif //COMP30023_2022_PROJECT_2_RESPOND_H
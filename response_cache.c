@@ -0,0 +1,299 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "response_cache.h"
+#include "respond.h"
+#include "file_cache.h"
+
+static response_cache_entry_t *find_entry(response_cache_shard_t *shard, string_view_t request_path,
+                                          content_encoding_t content_encoding, uint64_t hash);
+static bool revalidate_entry(response_cache_t *cache, response_cache_entry_t *entry);
+static response_cache_entry_t *render_entry(string_view_t request_path, char *file_path, int fd, struct stat *file_stat,
+                                            const char *content_type, content_encoding_t content_encoding,
+                                            uint64_t hash);
+static void insert_entry(response_cache_shard_t *shard, response_cache_entry_t *entry);
+static void remove_entry(response_cache_shard_t *shard, response_cache_entry_t *entry);
+static void move_to_front(response_cache_shard_t *shard, response_cache_entry_t *entry);
+static void unlink_from_lru(response_cache_shard_t *shard, response_cache_entry_t *entry);
+
+// Sets up a response cache which holds up to memory_budget bytes of rendered responses, split evenly between the
+// shards. A file is never stored if its entry could not fit in one shard, so max_entry_size is lowered to what fits
+// rather than having every request for such a file read and render it only to throw it away. Returns false if a shard
+// lock could not be set up.
+bool response_cache_init(response_cache_t *cache, size_t memory_budget, size_t max_entry_size,
+                         int revalidate_interval) {
+    size_t shard_budget = memory_budget / RESPONSE_CACHE_NUM_SHARDS;
+    size_t largest_fitting_entry = shard_budget > MAX_RESPONSE_CACHE_ENTRY_OVERHEAD ?
+            shard_budget - MAX_RESPONSE_CACHE_ENTRY_OVERHEAD : 0;
+    cache->max_entry_size = max_entry_size < largest_fitting_entry ? max_entry_size : largest_fitting_entry;
+    cache->revalidate_interval = revalidate_interval;
+
+    for(int i = 0; i < RESPONSE_CACHE_NUM_SHARDS; i++) {
+        response_cache_shard_t *shard = &cache->shards[i];
+        memset(shard->buckets, 0, sizeof(shard->buckets));
+        shard->lru_head = NULL;
+        shard->lru_tail = NULL;
+        shard->memory_used = 0;
+        shard->memory_budget = shard_budget;
+        if(pthread_mutex_init(&shard->lock, NULL) != 0) {
+            perror("pthread_mutex_init");
+            return false;
+        }
+    }
+    return true;
+}
+
+// Looks up the rendered response for request_path sent with content_encoding and returns it with a reference taken on
+// behalf of the caller, who must hand it back with response_cache_release once it has been sent. Returns NULL on a
+// miss, including when the cached file has changed on disk since it was rendered.
+response_cache_entry_t *response_cache_acquire(response_cache_t *cache, string_view_t request_path,
+                                               content_encoding_t content_encoding) {
+    uint64_t hash = hash_request_path(request_path);
+    response_cache_shard_t *shard = &cache->shards[hash % RESPONSE_CACHE_NUM_SHARDS];
+
+    pthread_mutex_lock(&shard->lock);
+    response_cache_entry_t *entry = find_entry(shard, request_path, content_encoding, hash);
+    if(entry != NULL) {
+        atomic_fetch_add_explicit(&entry->reference_count, 1, memory_order_relaxed);
+        move_to_front(shard, entry);
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    // The stat done to revalidate an entry happens outside the lock so that it does not hold up the rest of the
+    // shard.
+    if(entry != NULL && !revalidate_entry(cache, entry)) {
+        pthread_mutex_lock(&shard->lock);
+        remove_entry(shard, entry);
+        pthread_mutex_unlock(&shard->lock);
+        response_cache_release(entry);
+        entry = NULL;
+    }
+    return entry;
+}
+
+// Renders the response for a file that has just been opened to serve a cache miss and adds it to the cache, as long as
+// the file is small enough. Since max_entry_size leaves room for the most the headers can take up, a file that passes
+// that check always fits in its shard. The file is read with pread so the caller's sendfile offsets are not
+// disturbed. Failing to store a response is not an error, the next request for it will simply miss again.
+void response_cache_store(response_cache_t *cache, string_view_t request_path, char *file_path, int fd,
+                          struct stat *file_stat, const char *content_type, content_encoding_t content_encoding) {
+    if(file_stat->st_size > (off_t) cache->max_entry_size) {
+        return;
+    }
+
+    uint64_t hash = hash_request_path(request_path);
+    response_cache_shard_t *shard = &cache->shards[hash % RESPONSE_CACHE_NUM_SHARDS];
+    // A response which is already cached is left as it is rather than read and rendered all over again. Entries for
+    // files which have changed are removed when they are looked up, so the one found here is still current.
+    pthread_mutex_lock(&shard->lock);
+    bool cached = find_entry(shard, request_path, content_encoding, hash) != NULL;
+    pthread_mutex_unlock(&shard->lock);
+    if(cached) {
+        return;
+    }
+
+    response_cache_entry_t *entry = render_entry(request_path, file_path, fd, file_stat, content_type,
+                                                 content_encoding, hash);
+    if(entry == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&shard->lock);
+    // Another thread may have stored the same response while this one was rendering it, in which case that one is
+    // kept and this one thrown away.
+    if(find_entry(shard, request_path, content_encoding, hash) != NULL) {
+        pthread_mutex_unlock(&shard->lock);
+        response_cache_release(entry);
+        return;
+    }
+    while(shard->memory_used + entry->memory_size > shard->memory_budget) {
+        remove_entry(shard, shard->lru_tail);
+    }
+    insert_entry(shard, entry);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+// Hands back a reference taken by response_cache_acquire. The entry is freed once nothing refers to it anymore.
+void response_cache_release(response_cache_entry_t *entry) {
+    if(atomic_fetch_sub_explicit(&entry->reference_count, 1, memory_order_acq_rel) == 1) {
+        free(entry->request_path);
+        free(entry->file_path);
+        free(entry);
+    }
+}
+
+// Finds the entry for request_path sent with content_encoding in the shard. The shard must be locked.
+static response_cache_entry_t *find_entry(response_cache_shard_t *shard, string_view_t request_path,
+                                          content_encoding_t content_encoding, uint64_t hash) {
+    response_cache_entry_t *entry =
+            shard->buckets[(hash / RESPONSE_CACHE_NUM_SHARDS) % RESPONSE_CACHE_BUCKETS_PER_SHARD];
+    while(entry != NULL) {
+        if(entry->hash == hash && entry->content_encoding == content_encoding &&
+                entry->request_path_length == request_path.length &&
+                memcmp(entry->request_path, request_path.data, request_path.length) == SAME_STRING) {
+            return entry;
+        }
+        entry = entry->next_in_bucket;
+    }
+    return NULL;
+}
+
+// Checks the entry against the file on disk if it has not been checked within the revalidate interval. Returns false
+// if the file has been changed, replaced or removed since the response was rendered.
+static bool revalidate_entry(response_cache_t *cache, response_cache_entry_t *entry) {
+    time_t now = monotonic_seconds();
+    if(now - atomic_load_explicit(&entry->last_validated, memory_order_relaxed) < cache->revalidate_interval) {
+        return true;
+    }
+
+    struct stat current_stat;
+    if(web_root_stat_file(entry->file_path, &current_stat) < 0 || !file_unchanged(&entry->file_stat, &current_stat)) {
+        return false;
+    }
+    atomic_store_explicit(&entry->last_validated, now, memory_order_relaxed);
+    return true;
+}
+
+// Builds an entry holding every header variant and the body of the file, with one reference for the caller. The
+// headers are rendered into a scratch buffer first since their lengths are only known once they have been formatted.
+// Returns NULL if memory could not be allocated or the file could not be read in full.
+static response_cache_entry_t *render_entry(string_view_t request_path, char *file_path, int fd, struct stat *file_stat,
+                                            const char *content_type, content_encoding_t content_encoding,
+                                            uint64_t hash) {
+    char rendered_headers[NUM_HEADER_VARIANTS][MAX_RENDERED_HEADERS_SIZE];
+    size_t rendered_lengths[NUM_HEADER_VARIANTS];
+    size_t total_headers_length = 0;
+    char extra_headers[VALIDATOR_HEADERS_BUFFER_SIZE + ENCODING_HEADERS_BUFFER_SIZE + sizeof ACCEPT_RANGES_HEADER];
+
+    format_validator_headers(extra_headers, file_stat);
+    format_encoding_headers(extra_headers + strlen(extra_headers), content_encoding,
+                            response_varies_by_encoding(content_type));
+    strcat(extra_headers, ACCEPT_RANGES_HEADER);
+    for(int variant = 0; variant < NUM_HEADER_VARIANTS; variant++) {
+        char *protocol_version = (variant & HEADER_VARIANT_HTTP_1_1) ? PROTOCOL_VER_1_1 : PROTOCOL_VER;
+        bool keep_alive = (variant & HEADER_VARIANT_KEEP_ALIVE) != 0;
+        rendered_lengths[variant] = format_headers(rendered_headers[variant], MAX_RENDERED_HEADERS_SIZE,
+                                                   protocol_version, OK_STATUS, NULL, content_type,
+                                                   file_stat->st_size, keep_alive, extra_headers);
+        total_headers_length += rendered_lengths[variant];
+    }
+
+    size_t memory_size = sizeof(response_cache_entry_t) + total_headers_length + file_stat->st_size;
+    response_cache_entry_t *entry = (response_cache_entry_t *) malloc (memory_size);
+    if(entry == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+
+    // Lay out the other variants first so that the contiguous variant ends exactly where the body starts.
+    char *next = entry->data;
+    for(int i = 0; i < NUM_HEADER_VARIANTS; i++) {
+        int variant = (i + CONTIGUOUS_HEADER_VARIANT + 1) % NUM_HEADER_VARIANTS;
+        memcpy(next, rendered_headers[variant], rendered_lengths[variant]);
+        entry->headers[variant] = next;
+        entry->headers_length[variant] = rendered_lengths[variant];
+        entry->status_line_length[variant] = strstr(rendered_headers[variant], "\r\n") - rendered_headers[variant] +
+                strlen("\r\n");
+        next += rendered_lengths[variant];
+    }
+    entry->body = next;
+    entry->body_length = file_stat->st_size;
+
+    // pread may return less than asked for, keep going until the whole file has been read.
+    // https://man7.org/linux/man-pages/man2/pread.2.html
+    size_t bytes_read = 0;
+    while(bytes_read < entry->body_length) {
+        ssize_t n = pread(fd, entry->body + bytes_read, entry->body_length - bytes_read, bytes_read);
+        if(n <= 0) {
+            free(entry);
+            return NULL;
+        }
+        bytes_read += n;
+    }
+
+    entry->request_path = strndup(request_path.data, request_path.length);
+    entry->request_path_length = request_path.length;
+    entry->file_path = strdup(file_path);
+    if(entry->request_path == NULL || entry->file_path == NULL) {
+        perror("strdup");
+        free(entry->request_path);
+        free(entry->file_path);
+        free(entry);
+        return NULL;
+    }
+    entry->hash = hash;
+    entry->file_stat = *file_stat;
+    entry->content_type = content_type;
+    entry->content_encoding = content_encoding;
+    entry->memory_size = memory_size;
+    atomic_init(&entry->reference_count, 1);
+    atomic_init(&entry->last_validated, monotonic_seconds());
+    entry->lru_prev = NULL;
+    entry->lru_next = NULL;
+    entry->next_in_bucket = NULL;
+    return entry;
+}
+
+// Adds an entry to the front of the shard, taking over the caller's reference as the cache's own. The shard must be
+// locked and have room for the entry.
+static void insert_entry(response_cache_shard_t *shard, response_cache_entry_t *entry) {
+    response_cache_entry_t **bucket =
+            &shard->buckets[(entry->hash / RESPONSE_CACHE_NUM_SHARDS) % RESPONSE_CACHE_BUCKETS_PER_SHARD];
+    entry->next_in_bucket = *bucket;
+    *bucket = entry;
+
+    entry->lru_prev = NULL;
+    entry->lru_next = shard->lru_head;
+    if(shard->lru_head != NULL) {
+        shard->lru_head->lru_prev = entry;
+    } else {
+        shard->lru_tail = entry;
+    }
+    shard->lru_head = entry;
+    shard->memory_used += entry->memory_size;
+}
+
+// Takes an entry out of the shard and drops the cache's reference to it. Does nothing if the entry has already been
+// removed by another thread. The shard must be locked.
+static void remove_entry(response_cache_shard_t *shard, response_cache_entry_t *entry) {
+    response_cache_entry_t **link =
+            &shard->buckets[(entry->hash / RESPONSE_CACHE_NUM_SHARDS) % RESPONSE_CACHE_BUCKETS_PER_SHARD];
+    while(*link != NULL && *link != entry) {
+        link = &(*link)->next_in_bucket;
+    }
+    if(*link == NULL) {
+        return;
+    }
+    *link = entry->next_in_bucket;
+    unlink_from_lru(shard, entry);
+    shard->memory_used -= entry->memory_size;
+    response_cache_release(entry);
+}
+
+// Marks the entry as the most recently used one in the shard. The shard must be locked.
+static void move_to_front(response_cache_shard_t *shard, response_cache_entry_t *entry) {
+    if(shard->lru_head == entry) {
+        return;
+    }
+    unlink_from_lru(shard, entry);
+    entry->lru_prev = NULL;
+    entry->lru_next = shard->lru_head;
+    shard->lru_head->lru_prev = entry;
+    shard->lru_head = entry;
+}
+
+// Takes the entry out of the shard's least recently used list. The shard must be locked.
+static void unlink_from_lru(response_cache_shard_t *shard, response_cache_entry_t *entry) {
+    if(entry->lru_prev != NULL) {
+        entry->lru_prev->lru_next = entry->lru_next;
+    } else {
+        shard->lru_head = entry->lru_next;
+    }
+    if(entry->lru_next != NULL) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    } else {
+        shard->lru_tail = entry->lru_prev;
+    }
+    entry->lru_prev = NULL;
+    entry->lru_next = NULL;
+}
@@ -0,0 +1,103 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_RESPONSE_CACHE_H
+#define COMP30023_2022_PROJECT_2_RESPONSE_CACHE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <pthread.h>
+
+#include "parse.h"
+#include "encoding.h"
+#include "web_root.h"
+
+#define RESPONSE_CACHE_NUM_SHARDS 16
+#define RESPONSE_CACHE_BUCKETS_PER_SHARD 1024
+#define RESPONSE_CACHE_DISABLED 0
+
+// A response can be for either protocol version and can either keep the connection alive or close it, which changes
+// the status line and the Connection header. Every combination is rendered up front. The HTTP/1.1 keep-alive variant
+// is by far the most common, so it is the one placed directly in front of the body.
+#define NUM_HEADER_VARIANTS 4
+#define HEADER_VARIANT_HTTP_1_1 2
+#define HEADER_VARIANT_KEEP_ALIVE 1
+#define CONTIGUOUS_HEADER_VARIANT (HEADER_VARIANT_HTTP_1_1 | HEADER_VARIANT_KEEP_ALIVE)
+#define MAX_RENDERED_HEADERS_SIZE 384
+// The most an entry can take up on top of the file itself, which is what is checked against a shard's budget before
+// the file is read and rendered.
+#define MAX_RESPONSE_CACHE_ENTRY_OVERHEAD \
+        (sizeof(response_cache_entry_t) + NUM_HEADER_VARIANTS * MAX_RENDERED_HEADERS_SIZE)
+
+// A fully rendered 200 response for a small file. The header variants and the body all live in one allocation (data),
+// laid out as the three other variants followed by the contiguous variant and then the body, so the most common
+// response can go out in a single system call straight from the cache. The headers leave out the Date line, which
+// is added when the response is sent, so the length of each status line is kept to know where it goes. Entries are
+// reference counted like file cache entries so that one being sent is never freed under the sender.
+typedef struct response_cache_entry response_cache_entry_t;
+struct response_cache_entry {
+    char *request_path;
+    size_t request_path_length;
+    char *file_path;
+    uint64_t hash;
+    struct stat file_stat;
+    const char *content_type;
+    content_encoding_t content_encoding;
+    atomic_int reference_count;
+    _Atomic time_t last_validated;
+    size_t memory_size;
+    char *headers[NUM_HEADER_VARIANTS];
+    size_t headers_length[NUM_HEADER_VARIANTS];
+    size_t status_line_length[NUM_HEADER_VARIANTS];
+    char *body;
+    size_t body_length;
+    response_cache_entry_t *lru_prev;
+    response_cache_entry_t *lru_next;
+    response_cache_entry_t *next_in_bucket;
+    char data[];
+};
+
+// One shard of the response cache. Entries are kept in least recently used order and evicted from the back of the
+// list whenever the shard goes over its share of the memory budget.
+typedef struct response_cache_shard response_cache_shard_t;
+struct response_cache_shard {
+    pthread_mutex_t lock;
+    response_cache_entry_t *buckets[RESPONSE_CACHE_BUCKETS_PER_SHARD];
+    response_cache_entry_t *lru_head;
+    response_cache_entry_t *lru_tail;
+    size_t memory_used;
+    size_t memory_budget;
+};
+
+// A cache of complete responses for small files, keyed by request path and the encoding the body is sent with. Files
+// larger than max_entry_size are never stored. Entries are checked against the file on disk with stat at most once
+// every revalidate_interval seconds and dropped if the file has changed.
+typedef struct response_cache response_cache_t;
+struct response_cache {
+    response_cache_shard_t shards[RESPONSE_CACHE_NUM_SHARDS];
+    size_t max_entry_size;
+    int revalidate_interval;
+};
+
+bool response_cache_init(response_cache_t *cache, size_t memory_budget, size_t max_entry_size,
+                         int revalidate_interval);
+
+response_cache_entry_t *response_cache_acquire(response_cache_t *cache, string_view_t request_path,
+                                               content_encoding_t content_encoding);
+
+void response_cache_store(response_cache_t *cache, string_view_t request_path, char *file_path, int fd,
+                          struct stat *file_stat, const char *content_type, content_encoding_t content_encoding);
+
+void response_cache_release(response_cache_entry_t *entry);
+
+#endif //COMP30023_2022_PROJECT_2_RESPONSE_CACHE_H
@@ -7,112 +7,175 @@
 // found at https://gitlab.eng.unimelb.edu.au/comp30023-2022-projects/practicals/-/blob/main/week9-sockets/server.c.
 #include "server.h"
 
+static size_t read_request(int newsockfd, char *buffer, int *bytes_read_so_far, http_parser_t *parser,
+                           long *accepted_at, read_deadline_t *deadline);
+static bool set_socket_timeout(int sockfd, int option, long timeout);
+
 int main(int argc, char** argv) {
-	int sockfd, newsockfd, s;
-	struct addrinfo hints, *res, *p;
+	int sockfd, newsockfd;
     struct sockaddr_storage client_addr;
     socklen_t client_addr_size;
 
-	if (argc < 4) {
-		fprintf(stderr, "ERROR, not enough arguments provided.\n");
-		exit(EXIT_FAILURE);
-	}
-
-    char *web_root_path = argv[3];
-
-	// Create address we're going to listen on (with given port number)
-	memset(&hints, 0, sizeof hints);
-
-    if(strcmp(argv[1], IPV4_ARG) == SAME_STRING) {
-        hints.ai_family = AF_INET; // IPv4
-    } else if (strcmp(argv[1], IPV6_ARG) == SAME_STRING) {
-        hints.ai_family = AF_INET6; // IPv6
-    }
-	hints.ai_socktype = SOCK_STREAM; // TCP
-	hints.ai_flags = AI_PASSIVE;     // for bind, listen, accept
-
-	// node (NULL means any interface), service (port), hints, res. Note: argv[2] is the port_number
-	s = getaddrinfo(NULL, argv[2], &hints, &res);
-	if (s != 0) {
-		fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(s));
-		exit(EXIT_FAILURE);
-	}
-
-    // The code used in the if statement was referenced and modified from COMP30023 Week 8 Lecture 2 Lecture Slide 13
-    // "Create IPv6 Socket". getaddrinfo returns multiple addresses in a linked list as mentioned in COMP30023
-    // Week 8 Lecture 2. Hence, if we want a IPv6 address, we need to use a for loop to step through the
-    // linked list returned (res) and find a valid IPv6 address to use to create a socket.
-    for (p = res; p != NULL; p = p->ai_next) {
-        // hints.ai_family contains the IP address type that we want (AF_INET or AF_INET6). Check that the current
-        // address in this node of the linked list corresponds to the address family stored in hints.ai_family.
-        if (p->ai_family == hints.ai_family) {
-            // We attempt to create a socket from this address. If socket creation was successful, we can use
-            // this socket, so we break out of the loop. Otherwise, we keep trying with remaining addresses until
-            // we run out.
-            if ((sockfd = socket(p->ai_family, p->ai_socktype, p->ai_protocol)) >= 0) {
-                break;
-            }
-        }
+    server_config_t config;
+    if (!parse_server_config(argc, argv, &config)) {
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    // Before anything starts a thread, so that only the upgrade thread ever takes the upgrade signal.
+    if (!upgrade_init(argv, config.drain_timeout)) {
+        exit(EXIT_FAILURE);
+    }
+    if (config.pin_workers && !affinity_init()) {
+        exit(EXIT_FAILURE);
     }
 
-    // If no sockets were successfully created (either IPv6 or IPv4)
-    if (sockfd < 0) {
-        perror("socket");
+    // Every file is opened relative to the web root, which is opened once here for the lifetime of the server.
+    if (!web_root_open(config.web_root_path)) {
+        exit(EXIT_FAILURE);
+    }
+    if (config.index_web_root && !web_index_build(config.web_root_path)) {
         exit(EXIT_FAILURE);
     }
 
-	// Reuse port if possible. This piece of code was provided in COMP30023 Project 2 Spec. Similar code was included
-    // in server.c from COMP30023 Week 9 Practicals but was replaced with this.
-    int enable = 1;
-    if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(int)) < 0) {
-        perror("setsockopt");
+    // The file cache, which is only used if given a size, is shared by every thread for the lifetime of the server.
+    file_cache_t file_cache;
+    if (config.file_cache_size != FILE_CACHE_DISABLED) {
+        if (!file_cache_init(&file_cache, config.file_cache_size, config.file_cache_revalidate_interval,
+                             config.mmap_max_size)) {
+            exit(EXIT_FAILURE);
+        }
+        config.file_cache = &file_cache;
+    }
+    // As is the response cache, which is only used if given a memory budget. Changes to files are picked up on the
+    // same interval as the file cache.
+    response_cache_t response_cache;
+    if (config.response_cache_size != RESPONSE_CACHE_DISABLED) {
+        if (!response_cache_init(&response_cache, config.response_cache_size, config.response_cache_max_entry_size,
+                                 config.file_cache_revalidate_interval)) {
+            exit(EXIT_FAILURE);
+        }
+        config.response_cache = &response_cache;
+    }
+    if (config.stats) {
+        stats_enable();
+    }
+    if (config.precompressed) {
+        encoding_enable();
+    }
+    if (config.access_log_path != NULL && !access_log_init(config.access_log_path)) {
+        exit(EXIT_FAILURE);
+    }
+    if (!admission_init(config.max_connections, config.max_connections_per_client)) {
         exit(EXIT_FAILURE);
     }
 
-    // Bind address to the socket
-	if (bind(sockfd, res->ai_addr, res->ai_addrlen) < 0) {
-		perror("bind");
-		exit(EXIT_FAILURE);
-	}
-	freeaddrinfo(res);
+    // Writing to a socket that the client has already closed raises SIGPIPE, which would terminate the whole server
+    // rather than just the connection. Ignore it so that write() and sendfile() return EPIPE instead and the
+    // connection is dropped like any other write error. https://man7.org/linux/man-pages/man7/signal.7.html
+    signal(SIGPIPE, SIG_IGN);
 
-    // Listen on socket - means we're ready to accept connections,
-    // incoming connection requests will be queued, man 3 listen
-    if (listen(sockfd, 5) < 0) {
-        perror("listen");
+    // In reuseport mode every worker opens its own listening socket, so there is no shared one to open here.
+    sockfd = NO_LISTENER;
+    if (config.serving_mode != SERVING_MODE_REUSEPORT && (sockfd = open_listener(&config, false)) == NO_LISTENER) {
+        exit(EXIT_FAILURE);
+    }
+
+    // In epoll mode a fixed number of workers serve every connection from their own event loops, so the main thread
+    // has nothing left to do once they are running. Reuseport mode is the same apart from the listening sockets.
+    if (config.serving_mode == SERVING_MODE_EPOLL || config.serving_mode == SERVING_MODE_REUSEPORT) {
+        if (!run_event_loop(sockfd, &config)) {
+            exit(EXIT_FAILURE);
+        }
+        return 0;
+    }
+
+    // In uring mode the workers are driven by io_uring rather than epoll, but otherwise work the same way.
+    if (config.serving_mode == SERVING_MODE_URING) {
+        if (!run_uring_loop(sockfd, &config)) {
+            exit(EXIT_FAILURE);
+        }
+        return 0;
+    }
+
+    // In pool mode the main thread keeps accepting connections, but hands them to pre-spawned workers instead of
+    // creating a thread for each of them.
+    if (config.serving_mode == SERVING_MODE_POOL) {
+        if (!run_thread_pool(sockfd, &config)) {
+            exit(EXIT_FAILURE);
+        }
+        return 0;
+    }
+
+    // The arguments (and request buffer) of every connection thread come from here, and go back once the connection
+    // is closed, so that the next connection can reuse them instead of allocating its own.
+    slab_t connection_slab;
+    slab_init(&connection_slab, sizeof(serve_connection_args_t), true);
+    // The threads' stacks are reused the same way by glibc, as long as they are small enough for it to keep.
+    pthread_attr_t connection_thread_attr;
+    pthread_attr_init(&connection_thread_attr);
+    pthread_attr_setstacksize(&connection_thread_attr, CONNECTION_THREAD_STACK_SIZE);
+    if (!upgrade_start()) {
         exit(EXIT_FAILURE);
     }
 
     while(true) {
         // Accept a connection - blocks until a connection is ready to be accepted
         // Get back a new file descriptor to communicate on
+        upgrade_wait_for_connection(sockfd);
         client_addr_size = sizeof client_addr;
         newsockfd =
-                accept(sockfd, (struct sockaddr*)&client_addr, &client_addr_size);
+                accept4(sockfd, (struct sockaddr*)&client_addr, &client_addr_size, SOCK_CLOEXEC);
         if (newsockfd < 0) {
-            perror("accept");
-            close(newsockfd);
+            // EAGAIN means the server this one replaced (or the one replacing it) took the connection first.
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("accept4");
+            }
+            continue;
+        }
+        stats_count(STATS_CONNECTIONS_ACCEPTED, 1);
+        // Connections over the limits are turned away before a thread is started for them.
+        if (!admission_admit(&client_addr)) {
+            reject_connection(newsockfd);
+            continue;
         }
 
         // Create a struct that contains the arguments needed to run the serve_connection function as per linux
         // manual and Ed thread #845 https://edstem.org/au/courses/7916/discussion/857869.
         serve_connection_args_t *serve_connection_args =
-                (serve_connection_args_t *)malloc(sizeof (serve_connection_args_t));
+                (serve_connection_args_t *)slab_alloc(&connection_slab);
+        if (serve_connection_args == NULL) {
+            close(newsockfd);
+            admission_release(&client_addr);
+            continue;
+        }
+        serve_connection_args->slab = &connection_slab;
         serve_connection_args->newsockfd = newsockfd;
-        serve_connection_args->web_root_path = web_root_path;
+        serve_connection_args->client_addr = client_addr;
+        serve_connection_args->config = &config;
+        serve_connection_args->accepted_at = stats_now();
 
         // Create a pthread_t variable which is used to identify the thread.
         // https://man7.org/linux/man-pages/man3/pthread_create.3.html
         pthread_t thread_id;
 
-        pthread_create(&thread_id, NULL, serve_connection, (void *)serve_connection_args);
+        // If the thread cannot be started, nothing else will close the connection or take it back off the counts,
+        // so it is dropped here the same way as when its arguments could not be allocated. pthread_create returns
+        // its error rather than setting errno.
+        int error = pthread_create(&thread_id, &connection_thread_attr, serve_connection,
+                                   (void *)serve_connection_args);
+        if (error != 0) {
+            errno = error;
+            perror("pthread_create");
+            close(newsockfd);
+            slab_free(&connection_slab, serve_connection_args);
+            admission_release(&client_addr);
+        }
     }
 	return 0;
 }
 // Function that is passed into pthread_create. This function takes a struct which contains the socket the thread
-// is supposed to serve as well as the web root path. It repeatedly reads packets from the socket and places it in a
-// buffer until the request ends. After reading the request, it then calls helper functions to send an appropriate
-// HTTP response.
+// is supposed to serve as well as the web root path, serves the connection with serve_client using the struct's
+// buffer and then hands the struct back to the slab it came from.
 void *serve_connection(void *serve_connection_args) {
     // pthread_create causes memory leaks. Call pthread_detach pthread_self (this thread) in order to mark the thread
     // automatically as detached which will automatically free the resources once it terminates. Idea was initially
@@ -123,55 +186,147 @@ void *serve_connection(void *serve_connection_args) {
     // https://man7.org/linux/man-pages/man3/pthread_self.3.html
     pthread_detach(pthread_self());
 
-    int n, bytes_read_so_far = 0;
-    // Use calloc to initialise the buffer so strstr can be called on it.
-    char *buffer = (char *) calloc ((REQUEST_MAX_BUFFER_SIZE + NULL_TERMINATOR_SPACE), sizeof(char));
-
     // Type cast the struct containing the arguments for the function and then extract them and store them in variables.
     int newsockfd = ((serve_connection_args_t *)serve_connection_args)->newsockfd;
-    char *web_root_path = ((serve_connection_args_t *)serve_connection_args)->web_root_path;
+    server_config_t *config = ((serve_connection_args_t *)serve_connection_args)->config;
+    long accepted_at = ((serve_connection_args_t *)serve_connection_args)->accepted_at;
+    slab_t *slab = ((serve_connection_args_t *)serve_connection_args)->slab;
+
+    serve_client(newsockfd, &((serve_connection_args_t *)serve_connection_args)->client_addr, config, accepted_at,
+                 ((serve_connection_args_t *)serve_connection_args)->buffer);
+    slab_free(slab, serve_connection_args);
+    return NULL;
+}
+
+// Function which serves a single connection from start to finish on the calling thread. It repeatedly reads packets
+// from the socket and places it in a buffer until a request ends, then calls helper functions to send an appropriate
+// HTTP response. Persistent connections go around again for the next request, starting with whatever was read in
+// past the end of the previous one (pipelined requests), until the client or the response closes the connection or
+// the connection sits idle for longer than the keep-alive timeout. A client which takes longer than the header timeout
+// to send a request, or stops taking a response for longer than the send timeout, is dropped. Both are enforced by
+// the kernel through the socket's timeouts, so the thread needs no timer of its own. Used by both the thread per
+// connection model and the thread pool workers. client_addr is the client's address from accept, and accepted_at is
+// when the connection was accepted, for the stats. buffer is where requests are read into, which must hold
+// REQUEST_MAX_BUFFER_SIZE characters and is owned by the caller. The connection is released from the connection
+// limits once it is closed.
+void serve_client(int newsockfd, struct sockaddr_storage *client_addr, server_config_t *config, long accepted_at,
+                  char *buffer) {
+    int bytes_read_so_far = 0;
+    size_t request_length;
+    http_parser_t parser;
+    read_deadline_t deadline = {.header_timeout = config->header_timeout * NANOSECONDS_PER_SECOND_L,
+                                .keep_alive_timeout = config->keep_alive_timeout * NANOSECONDS_PER_SECOND_L,
+                                .request_started_at = monotonic_nanoseconds(),
+                                .receive_timeout = NO_RECEIVE_TIMEOUT};
+
+    http_parser_reset(&parser);
+    // A blocking write (or sendfile) which cannot send anything for the send timeout fails with EAGAIN, and one that
+    // sends some of its data returns early with what it sent, so the timeout starts again with every bit of progress.
+    // sendfile moves the file through the socket a piece at a time and only gives up on a piece that sends nothing, so
+    // a client which stops reading part way through a large file can hold on for a few timeouts before it is dropped.
+    // https://man7.org/linux/man-pages/man7/socket.7.html
+    set_socket_timeout(newsockfd, SO_SNDTIMEO, config->send_timeout * NANOSECONDS_PER_SECOND_L);
+    // read_request returns NO_COMPLETE_REQUEST when the connection should be dropped.
+    while((request_length = read_request(newsockfd, buffer, &bytes_read_so_far, &parser, &accepted_at, &deadline))
+            != NO_COMPLETE_REQUEST) {
+        // send_http_response may fail if there is an error with write() or sendfile() that occurs which prompts the
+        // server to drop the connection. In those cases, the thread will simply move on to free all the memory used
+        // and close the socket. The request is parsed where it is, so it does not matter that the next one may
+        // already be in the buffer right behind it.
+        http_response_t response;
+        long response_started_at = access_log_start();
+        prepare_response_to_request(&response, buffer, request_length, config);
+        bool response_sent = send_http_response(newsockfd, &response);
+        access_log_response(client_addr, &response, response_started_at);
+        release_http_response(&response);
+        if (!response_sent || !response.keep_alive) {
+            break;
+        }
+
+        // Move anything read past the end of this request to the start of the buffer so it is picked up as the start
+        // of the next request. If some of it is already there, the next request has started.
+        bytes_read_so_far -= request_length;
+        memmove(buffer, buffer + request_length, bytes_read_so_far);
+        deadline.request_started_at = bytes_read_so_far > 0 ? monotonic_nanoseconds() : REQUEST_NOT_STARTED;
+    }
+
+    // Close the connection. The buffer belongs to the caller.
+    close(newsockfd);
+    admission_release(client_addr);
+}
+
+// Function which reads characters from the connection into the buffer until it holds a complete request, which we
+// check using find_request_end(). "\r\n\r\n" means end of HTTP request. The buffer may already hold some (or all) of
+// the request from a previous read, and the parser only looks at what has been read in since it last looked.
+// Returns the length of the request, or NO_COMPLETE_REQUEST if the connection should be dropped instead. The time
+// until the first bytes arrive on the connection is recorded, after which accepted_at is set to STATS_NOT_TIMED.
+// Every read waits for at most the keep-alive timeout if nothing of the request has arrived yet, and otherwise for
+// whatever is left of the header timeout, so a request that trickles in a byte at a time still runs out of time.
+static size_t read_request(int newsockfd, char *buffer, int *bytes_read_so_far, http_parser_t *parser,
+                           long *accepted_at, read_deadline_t *deadline) {
+    int n;
+    size_t request_length;
+
+    while((request_length = find_request_end(parser, buffer, *bytes_read_so_far)) == NO_COMPLETE_REQUEST) {
+        // A request which fills up the whole buffer without ending can never be completed. Answer it with a 404 like
+        // other invalid requests and drop the connection.
+        if (*bytes_read_so_far == REQUEST_MAX_BUFFER_SIZE) {
+            stats_count(STATS_RESPONSES_4XX, 1);
+            write_message(newsockfd, NOT_FOUND_RESPONSE);
+            return NO_COMPLETE_REQUEST;
+        }
+        long timeout = deadline->keep_alive_timeout;
+        if (deadline->request_started_at != REQUEST_NOT_STARTED) {
+            timeout = deadline->request_started_at + deadline->header_timeout - monotonic_nanoseconds();
+            if (timeout <= 0) {
+                stats_count(STATS_CONNECTIONS_TIMED_OUT, 1);
+                return NO_COMPLETE_REQUEST;
+            }
+        }
+        if (timeout != deadline->receive_timeout) {
+            if (!set_socket_timeout(newsockfd, SO_RCVTIMEO, timeout)) {
+                return NO_COMPLETE_REQUEST;
+            }
+            deadline->receive_timeout = timeout;
+        }
 
-    // Read characters from the connection, then process them until we encounter "\r\n\r\n" which we check using
-    // the strstr() function. "\r\n\r\n" means end of HTTP request.
-    do {
         // Pass in buffer + bytes_read_so_far to read() which tells read the offset to begin reading at as per
         // https://man7.org/linux/man-pages/man2/read.2.html. In the case of multi-packet request, read() will continue
         // reading from where it left off at before. n is number of characters read
-        n = read(newsockfd, buffer + bytes_read_so_far, REQUEST_MAX_BUFFER_SIZE - bytes_read_so_far);
-        // If there is a read error, free everything and drop the connection by closing the socket.
+        n = read(newsockfd, buffer + *bytes_read_so_far, REQUEST_MAX_BUFFER_SIZE - *bytes_read_so_far);
+        // If there is a read error (which includes the keep-alive or header timeout running out), drop the
+        // connection. If n is 0, the client has closed the connection.
         if (n < 0) {
-            perror("read");
-            // Since we can free everything here and just return and the thread will terminate, just do that instead.
-            free(serve_connection_args);
-            free(buffer);
-            close(newsockfd);
-            return NULL;
-        }
-        // Track the bytes read so far into the buffer.
-        bytes_read_so_far += n;
-    } while(strstr(buffer, "\r\n\r\n") == NULL);
-
-    // Null-terminate string
-    buffer[bytes_read_so_far] = '\0';
-
-    char *file_path;
-    // If the program successfully creates a file_path, then we continue as usual
-    if(get_file_path(&file_path, web_root_path, buffer)) {
-        // This function may terminate (return) early if there is an error with write() or sendfile() that occurs
-        // which prompts the server to drop the connection. In those cases, the thread will simply move on to free
-        // all the memory used and close the socket before terminating.
-        send_http_response(newsockfd, file_path);
-        free(file_path);
-        // Otherwise, the program will send a generic 404 Not Found response to the socket
-    } else {
-        // If the write function fails here, then the thread will still just drop the connection and free memory as
-        // usual, so no need to check whether it's successful or not.
-        write_message(newsockfd, "HTTP/1.0 404 Not Found\r\n\r\n");
-    }
-
-    // Close the connection, free everything and thread terminates.
-    close(newsockfd);
-    free(serve_connection_args);
-    free(buffer);
-    return NULL;
-}
\ No newline at end of file
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("read");
+            } else if (deadline->request_started_at != REQUEST_NOT_STARTED) {
+                stats_count(STATS_CONNECTIONS_TIMED_OUT, 1);
+            }
+            return NO_COMPLETE_REQUEST;
+        }
+        if (n == 0) {
+            return NO_COMPLETE_REQUEST;
+        }
+        // Track the bytes read so far into the buffer. The first bytes of a request start its header timeout.
+        *bytes_read_so_far += n;
+        if (deadline->request_started_at == REQUEST_NOT_STARTED) {
+            deadline->request_started_at = monotonic_nanoseconds();
+        }
+        stats_record(STATS_STAGE_FIRST_BYTE, *accepted_at);
+        *accepted_at = STATS_NOT_TIMED;
+    }
+    return request_length;
+}
+
+// Sets one of the socket's timeouts (SO_RCVTIMEO or SO_SNDTIMEO) to timeout nanoseconds, rounded up to a whole
+// microsecond since a timeout of 0 would mean waiting forever. https://man7.org/linux/man-pages/man7/socket.7.html
+static bool set_socket_timeout(int sockfd, int option, long timeout) {
+    long microseconds = (timeout + NANOSECONDS_PER_MICROSECOND_L - 1) / NANOSECONDS_PER_MICROSECOND_L;
+    struct timeval value = {.tv_sec = microseconds / MICROSECONDS_PER_SECOND_L,
+                            .tv_usec = microseconds % MICROSECONDS_PER_SECOND_L};
+    if (setsockopt(sockfd, SOL_SOCKET, option, &value, sizeof value) < 0) {
+        perror("setsockopt");
+        return false;
+    }
+    return true;
+}
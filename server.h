@@ -1,42 +1,91 @@
-//
-// Created by User on 12/5/2022.
-//
-
-#ifndef COMP30023_2022_PROJECT_2_SERVER_H
-#define COMP30023_2022_PROJECT_2_SERVER_H
-
-#define _POSIX_C_SOURCE 200112L
-#include <netdb.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
-
-#include <stdbool.h>
-#include <assert.h>
-#include <pthread.h>
-
-#include "parse.h"
-#include "respond.h"
-
-#define IMPLEMENTS_IPV6
-#define MULTITHREADED
-
-#define REQUEST_MAX_BUFFER_SIZE 2000
-#define IPV4_ARG "4"
-#define IPV6_ARG "6"
-
-#define NULL_TERMINATOR_SPACE 1
-#define ZERO_OFFSET 1
-
-// A struct which contains the arguments needed for the serve_connection function. Used in conjunction with
-// pthread_create.
-typedef struct serve_connection_args serve_connection_args_t;
-struct serve_connection_args {
-    int newsockfd;
-    char *web_root_path;
-};
-
-void *serve_connection(void *serve_connection_args);
-
-#endif //COMP30023_2022_PROJECT_2_SERVER_H
+//
+// Created by User on 12/5/2022.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_SERVER_H
+#define COMP30023_2022_PROJECT_2_SERVER_H
+
+// accept4() is a GNU extension. https://man7.org/linux/man-pages/man2/accept.2.html
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <stdbool.h>
+#include <assert.h>
+#include <pthread.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "config.h"
+#include "parse.h"
+#include "respond.h"
+#include "file_cache.h"
+#include "response_cache.h"
+#include "event_loop.h"
+#include "thread_pool.h"
+#include "listener.h"
+#include "uring_loop.h"
+#include "access_log.h"
+#include "slab.h"
+#include "admission.h"
+#include "upgrade.h"
+
+#define IMPLEMENTS_IPV6
+#define MULTITHREADED
+
+#define NULL_TERMINATOR_SPACE 1
+#define ZERO_OFFSET 1
+#define NANOSECONDS_PER_SECOND_L 1000000000L
+#define NANOSECONDS_PER_MICROSECOND_L 1000L
+#define MICROSECONDS_PER_SECOND_L 1000000L
+// Stands in for when the request being waited for started, while nothing of it has arrived yet.
+#define REQUEST_NOT_STARTED -1
+// SO_RCVTIMEO has not been set on a new socket, which means it waits forever.
+#define NO_RECEIVE_TIMEOUT 0
+// Stack size of a connection thread. glibc keeps the stacks of exited threads for new ones to reuse, but only up to
+// 40 MiB of them, which is just five of the default 8 MiB stacks. Past that, every new thread maps a fresh stack and
+// allocates its thread local storage. Nothing a connection does needs more than a few pages.
+// https://man7.org/linux/man-pages/man3/pthread_attr_setstacksize.3.html
+#define CONNECTION_THREAD_STACK_SIZE (256 * 1024)
+
+// A struct which contains the arguments needed for the serve_connection function. Used in conjunction with
+// pthread_create. It comes from a slab shared by every connection thread and carries the connection's request buffer
+// with it, so that a thread which is reused from the slab does not need to allocate anything to serve its client.
+typedef struct serve_connection_args serve_connection_args_t;
+struct serve_connection_args {
+    int newsockfd;
+    struct sockaddr_storage client_addr;
+    server_config_t *config;
+    long accepted_at;
+    slab_t *slab;
+    char buffer[REQUEST_MAX_BUFFER_SIZE];
+};
+
+// How long serve_client lets a blocking read wait, which is the keep-alive timeout while a persistent connection is
+// waiting for its next request and whatever is left of the header timeout once the request has started. Times are in
+// nanoseconds. receive_timeout is what SO_RCVTIMEO is set to at the moment, so that it is only set again when it has
+// to change.
+typedef struct read_deadline read_deadline_t;
+struct read_deadline {
+    long header_timeout;
+    long keep_alive_timeout;
+    long request_started_at;
+    long receive_timeout;
+};
+
+void *serve_connection(void *serve_connection_args);
+
+void serve_client(int newsockfd, struct sockaddr_storage *client_addr, server_config_t *config, long accepted_at,
+                  char *buffer);
+
+#endif //COMP30023_2022_PROJECT_2_SERVER_H
@@ -0,0 +1,101 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "slab.h"
+
+static bool grow_slab(slab_t *slab);
+
+// Sets up an empty slab for objects of object_size bytes, which is rounded up so that every object stays aligned for
+// anything. Nothing is allocated until the first object is.
+void slab_init(slab_t *slab, size_t object_size, bool shared) {
+    size_t alignment = sizeof(max_align_t);
+    if(object_size < sizeof(slab_object_t)) {
+        object_size = sizeof(slab_object_t);
+    }
+    slab->object_size = (object_size + alignment - 1) / alignment * alignment;
+    slab->free_list = NULL;
+    slab->chunks = NULL;
+    slab->shared = shared;
+    if(shared) {
+        pthread_mutex_init(&slab->lock, NULL);
+    }
+}
+
+// Takes an object off the free list, growing the slab by another chunk of objects first if there are none left.
+// The object's contents are whatever was left in it. Returns NULL if the slab could not grow.
+void *slab_alloc(slab_t *slab) {
+    if(slab->shared) {
+        pthread_mutex_lock(&slab->lock);
+    }
+    slab_object_t *object = NULL;
+    if(slab->free_list != NULL || grow_slab(slab)) {
+        object = slab->free_list;
+        slab->free_list = object->next_free;
+    }
+    if(slab->shared) {
+        pthread_mutex_unlock(&slab->lock);
+    }
+    return object;
+}
+
+// Grows the slab by a chunk of objects if it has none free, so that the next allocations do not have to. Workers call
+// this when they start, on their own thread (and CPU, when they are pinned), so that the first connection a worker
+// gets does not have to wait for malloc. Returns false if the slab could not grow, which just leaves it to
+// slab_alloc to try again.
+bool slab_reserve(slab_t *slab) {
+    if(slab->shared) {
+        pthread_mutex_lock(&slab->lock);
+    }
+    bool reserved = slab->free_list != NULL || grow_slab(slab);
+    if(slab->shared) {
+        pthread_mutex_unlock(&slab->lock);
+    }
+    return reserved;
+}
+
+// Puts an object that came from slab_alloc back on the free list. The most recently freed object is the next one
+// handed out, while it is still likely to be in the cache.
+void slab_free(slab_t *slab, void *object) {
+    slab_object_t *free_object = (slab_object_t *) object;
+    if(slab->shared) {
+        pthread_mutex_lock(&slab->lock);
+    }
+    free_object->next_free = slab->free_list;
+    slab->free_list = free_object;
+    if(slab->shared) {
+        pthread_mutex_unlock(&slab->lock);
+    }
+}
+
+// Frees every chunk of the slab, including any objects which are still in use.
+void slab_destroy(slab_t *slab) {
+    while(slab->chunks != NULL) {
+        slab_chunk_t *next = slab->chunks->next;
+        free(slab->chunks);
+        slab->chunks = next;
+    }
+    slab->free_list = NULL;
+    if(slab->shared) {
+        pthread_mutex_destroy(&slab->lock);
+    }
+}
+
+// Allocates another SLAB_OBJECTS_PER_CHUNK objects and puts them all on the free list. The slab must be locked if it
+// is shared.
+static bool grow_slab(slab_t *slab) {
+    slab_chunk_t *chunk = (slab_chunk_t *) malloc (sizeof(slab_chunk_t) + SLAB_OBJECTS_PER_CHUNK * slab->object_size);
+    if(chunk == NULL) {
+        perror("malloc");
+        return false;
+    }
+    chunk->next = slab->chunks;
+    slab->chunks = chunk;
+
+    char *objects = (char *) chunk->objects;
+    for(int i = SLAB_OBJECTS_PER_CHUNK - 1; i >= 0; i--) {
+        slab_object_t *object = (slab_object_t *) (objects + i * slab->object_size);
+        object->next_free = slab->free_list;
+        slab->free_list = object;
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_SLAB_H
+#define COMP30023_2022_PROJECT_2_SLAB_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+// How many objects a slab grows by at a time.
+#define SLAB_OBJECTS_PER_CHUNK 64
+
+// A free object, which holds the link to the next free one in its first bytes.
+typedef struct slab_object slab_object_t;
+struct slab_object {
+    slab_object_t *next_free;
+};
+
+// A block of objects allocated in one go. The objects are laid out one after the other in objects, which is aligned
+// for anything.
+typedef struct slab_chunk slab_chunk_t;
+struct slab_chunk {
+    slab_chunk_t *next;
+    max_align_t objects[];
+};
+
+// A pool of objects of one size, like connections or request buffers. Objects which are freed go on a free list and
+// are handed out again by the next allocation, so once the slab has grown to the most objects that are ever in use at
+// once, allocating and freeing never call malloc or free. Chunks are only given back when the slab is destroyed. A
+// slab is owned by one worker thread unless it is shared, in which case the free list is protected by the lock.
+typedef struct slab slab_t;
+struct slab {
+    size_t object_size;
+    slab_object_t *free_list;
+    slab_chunk_t *chunks;
+    bool shared;
+    pthread_mutex_t lock;
+};
+
+void slab_init(slab_t *slab, size_t object_size, bool shared);
+
+void *slab_alloc(slab_t *slab);
+
+bool slab_reserve(slab_t *slab);
+
+void slab_free(slab_t *slab, void *object);
+
+void slab_destroy(slab_t *slab);
+
+#endif //COMP30023_2022_PROJECT_2_SLAB_H
@@ -0,0 +1,317 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "stats.h"
+
+static stats_t *get_thread_stats(void);
+static void create_stats_key(void);
+static void retire_thread_stats(void *thread_stats_block);
+static void add_stats(stats_t *total, stats_t *block);
+static void add_value(_Atomic uint64_t *value, uint64_t amount);
+static int bucket_index(uint64_t value);
+static uint64_t bucket_highest_value(int index);
+static double histogram_percentile(stats_histogram_t *histogram, double percentile);
+static double histogram_max(stats_histogram_t *histogram);
+static void append(char *buffer, size_t *length, const char *format, ...);
+
+static const char *counter_names[NUM_STATS_COUNTERS] = {
+    "connections_accepted",
+    "connections_rejected",
+    "connections_timed_out",
+    "requests",
+    "invalid_requests",
+    "responses_2xx",
+    "responses_3xx",
+    "responses_4xx",
+    "responses_5xx",
+    "memory_bytes_sent",
+    "file_bytes_sent",
+    "response_cache_hits",
+    "response_cache_misses",
+    "file_cache_hits",
+    "file_cache_misses",
+    "access_log_dropped"
+};
+
+static const char *stage_names[NUM_STATS_STAGES] = {
+    "first_byte",
+    "parse",
+    "open",
+    "header_write",
+    "body_send"
+};
+
+// Set once at startup, before any worker is started.
+static bool enabled = false;
+
+// Every running thread's stats, plus the totals of threads that have exited (like the threads of the thread per
+// connection model), which are folded into retired_stats so that nothing they counted is lost. The lock is only
+// taken when a thread first records something, when it exits, and when the stats are read.
+static stats_t *stats_head = NULL;
+static stats_t retired_stats;
+// Blocks of exited threads, cleared and kept for the next thread that records something, so that in the thread per
+// connection model a new connection does not allocate (and its exit free) a block of its own. Protected by
+// stats_lock, and linked through next.
+static stats_t *idle_stats_head = NULL;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t stats_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t stats_key;
+static __thread stats_t *thread_stats = NULL;
+
+// Turns on collecting stats and the stats endpoint. While they are off, every other function here returns straight
+// away, so the only cost is a branch.
+void stats_enable(void) {
+    enabled = true;
+}
+
+bool stats_enabled(void) {
+    return enabled;
+}
+
+// Returns the time to start timing a stage from, or STATS_NOT_TIMED while stats are off so that not even the clock
+// is read.
+long stats_now(void) {
+    if(!enabled) {
+        return STATS_NOT_TIMED;
+    }
+    return monotonic_nanoseconds();
+}
+
+// Adds amount to one of the calling thread's counters.
+void stats_count(stats_counter_t counter, uint64_t amount) {
+    if(!enabled) {
+        return;
+    }
+    stats_t *stats = get_thread_stats();
+    if(stats != NULL) {
+        add_value(&stats->counters[counter], amount);
+    }
+}
+
+// Records how long a stage took, from start_time (as returned by stats_now) until now, in the calling thread's
+// histogram for the stage. Returns the current time so that the next stage can be timed from it, or STATS_NOT_TIMED
+// if the stage was not being timed.
+long stats_record(stats_stage_t stage, long start_time) {
+    if(!enabled || start_time == STATS_NOT_TIMED) {
+        return STATS_NOT_TIMED;
+    }
+    long now = monotonic_nanoseconds();
+    stats_t *stats = get_thread_stats();
+    if(stats != NULL) {
+        uint64_t elapsed = now > start_time ? (uint64_t) (now - start_time) : 0;
+        stats_histogram_t *histogram = &stats->histograms[stage];
+        add_value(&histogram->count, 1);
+        add_value(&histogram->sum, elapsed);
+        add_value(&histogram->buckets[bucket_index(elapsed)], 1);
+    }
+    return now;
+}
+
+// Adds up the stats of every thread and renders them as either plain text (one "name value" line each) or JSON.
+// Latencies are given in microseconds, with percentiles being the highest value of the bucket they fall in. Returns
+// a malloc'ed body which the caller frees, or NULL if it could not be allocated.
+char *render_stats(bool json, size_t *length) {
+    stats_t *total = (stats_t *) calloc (1, sizeof(stats_t));
+    char *body = (char *) malloc (STATS_BODY_BUFFER_SIZE);
+    if(total == NULL || body == NULL) {
+        perror("malloc");
+        free(total);
+        free(body);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&stats_lock);
+    add_stats(total, &retired_stats);
+    for(stats_t *block = stats_head; block != NULL; block = block->next) {
+        add_stats(total, block);
+    }
+    pthread_mutex_unlock(&stats_lock);
+
+    *length = 0;
+    append(body, length, json ? "{\"counters\":{" : "");
+    for(int i = 0; i < NUM_STATS_COUNTERS; i++) {
+        uint64_t value = atomic_load_explicit(&total->counters[i], memory_order_relaxed);
+        append(body, length, json ? "%s\"%s\":%llu" : "%s%s %llu\n", json && i > 0 ? "," : "", counter_names[i],
+               (unsigned long long) value);
+    }
+    append(body, length, json ? "},\"stages\":{" : "");
+    for(int i = 0; i < NUM_STATS_STAGES; i++) {
+        stats_histogram_t *histogram = &total->histograms[i];
+        uint64_t count = atomic_load_explicit(&histogram->count, memory_order_relaxed);
+        uint64_t sum = atomic_load_explicit(&histogram->sum, memory_order_relaxed);
+        double mean = count == 0 ? 0 : (double) sum / count / NANOSECONDS_PER_MICROSECOND;
+        double p50 = histogram_percentile(histogram, 0.5);
+        double p99 = histogram_percentile(histogram, 0.99);
+        double p999 = histogram_percentile(histogram, 0.999);
+        double max = histogram_max(histogram);
+        if(json) {
+            append(body, length, "%s\"%s\":{\"count\":%llu,\"mean_us\":%.3f,\"p50_us\":%.3f,\"p99_us\":%.3f,"
+                   "\"p999_us\":%.3f,\"max_us\":%.3f}", i > 0 ? "," : "", stage_names[i],
+                   (unsigned long long) count, mean, p50, p99, p999, max);
+        } else {
+            append(body, length, "%s_count %llu\n%s_mean_us %.3f\n%s_p50_us %.3f\n%s_p99_us %.3f\n"
+                   "%s_p999_us %.3f\n%s_max_us %.3f\n", stage_names[i], (unsigned long long) count,
+                   stage_names[i], mean, stage_names[i], p50, stage_names[i], p99, stage_names[i], p999,
+                   stage_names[i], max);
+        }
+    }
+    append(body, length, json ? "}}\n" : "");
+
+    free(total);
+    return body;
+}
+
+// Returns the calling thread's stats, taking an idle block or allocating one and registering it the first time. The
+// key's destructor retires them when the thread exits. Returns NULL if they could not be allocated, in which case
+// nothing is recorded.
+static stats_t *get_thread_stats(void) {
+    if(thread_stats != NULL) {
+        return thread_stats;
+    }
+    pthread_once(&stats_key_once, create_stats_key);
+
+    pthread_mutex_lock(&stats_lock);
+    stats_t *block = idle_stats_head;
+    if(block != NULL) {
+        idle_stats_head = block->next;
+    }
+    pthread_mutex_unlock(&stats_lock);
+    if(block == NULL) {
+        block = (stats_t *) calloc (1, sizeof(stats_t));
+        if(block == NULL) {
+            return NULL;
+        }
+    }
+
+    pthread_mutex_lock(&stats_lock);
+    block->prev = NULL;
+    block->next = stats_head;
+    if(stats_head != NULL) {
+        stats_head->prev = block;
+    }
+    stats_head = block;
+    pthread_mutex_unlock(&stats_lock);
+
+    pthread_setspecific(stats_key, block);
+    thread_stats = block;
+    return block;
+}
+
+// https://man7.org/linux/man-pages/man3/pthread_key_create.3p.html
+static void create_stats_key(void) {
+    pthread_key_create(&stats_key, retire_thread_stats);
+}
+
+// Called when a thread that recorded stats exits. Adds its stats to the retired totals, takes it out of the list and
+// clears it for the next thread.
+static void retire_thread_stats(void *thread_stats_block) {
+    stats_t *block = (stats_t *) thread_stats_block;
+
+    pthread_mutex_lock(&stats_lock);
+    add_stats(&retired_stats, block);
+    if(block->prev != NULL) {
+        block->prev->next = block->next;
+    } else {
+        stats_head = block->next;
+    }
+    if(block->next != NULL) {
+        block->next->prev = block->prev;
+    }
+    memset(block, 0, sizeof(stats_t));
+    block->next = idle_stats_head;
+    idle_stats_head = block;
+    pthread_mutex_unlock(&stats_lock);
+}
+
+// Adds every counter and histogram bucket of block to total. The caller holds the lock, so total is not being
+// written to by anyone else.
+static void add_stats(stats_t *total, stats_t *block) {
+    for(int i = 0; i < NUM_STATS_COUNTERS; i++) {
+        add_value(&total->counters[i], atomic_load_explicit(&block->counters[i], memory_order_relaxed));
+    }
+    for(int i = 0; i < NUM_STATS_STAGES; i++) {
+        stats_histogram_t *histogram = &block->histograms[i];
+        add_value(&total->histograms[i].count, atomic_load_explicit(&histogram->count, memory_order_relaxed));
+        add_value(&total->histograms[i].sum, atomic_load_explicit(&histogram->sum, memory_order_relaxed));
+        for(int j = 0; j < STATS_HISTOGRAM_BUCKETS; j++) {
+            add_value(&total->histograms[i].buckets[j],
+                      atomic_load_explicit(&histogram->buckets[j], memory_order_relaxed));
+        }
+    }
+}
+
+// Adds amount to a value that only the calling thread writes to. A relaxed load and store is enough for readers on
+// other threads to never see a torn value, without the cost of a locked instruction.
+static void add_value(_Atomic uint64_t *value, uint64_t amount) {
+    atomic_store_explicit(value, atomic_load_explicit(value, memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+// Works out which bucket a value goes in. Values below STATS_SUB_BUCKETS get a bucket each. Above that, the position
+// of the highest set bit picks the power of two and the next STATS_SUB_BUCKET_BITS bits pick the bucket within it.
+static int bucket_index(uint64_t value) {
+    if(value >= (1ULL << STATS_MAX_EXPONENT)) {
+        value = (1ULL << STATS_MAX_EXPONENT) - 1;
+    }
+    if(value < STATS_SUB_BUCKETS) {
+        return (int) value;
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    int sub_bucket = (int) (value >> (exponent - STATS_SUB_BUCKET_BITS)) & (STATS_SUB_BUCKETS - 1);
+    return (exponent - STATS_SUB_BUCKET_BITS + 1) * STATS_SUB_BUCKETS + sub_bucket;
+}
+
+// The reverse of bucket_index: the highest value that goes in the bucket.
+static uint64_t bucket_highest_value(int index) {
+    if(index < STATS_SUB_BUCKETS) {
+        return (uint64_t) index;
+    }
+    int shift = index / STATS_SUB_BUCKETS - 1;
+    uint64_t sub_bucket = STATS_SUB_BUCKETS + index % STATS_SUB_BUCKETS;
+    return ((sub_bucket + 1) << shift) - 1;
+}
+
+// Returns the value (in microseconds) that the given fraction of the recorded values are at or below, by nearest
+// rank.
+static double histogram_percentile(stats_histogram_t *histogram, double percentile) {
+    uint64_t count = atomic_load_explicit(&histogram->count, memory_order_relaxed);
+    if(count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t) (percentile * count);
+    if(rank < percentile * count || rank == 0) {
+        rank++;
+    }
+
+    uint64_t seen = 0;
+    for(int i = 0; i < STATS_HISTOGRAM_BUCKETS; i++) {
+        seen += atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+        if(seen >= rank) {
+            return bucket_highest_value(i) / NANOSECONDS_PER_MICROSECOND;
+        }
+    }
+    return histogram_max(histogram);
+}
+
+// Returns the highest value (in microseconds) of the highest bucket that has anything in it.
+static double histogram_max(stats_histogram_t *histogram) {
+    for(int i = STATS_HISTOGRAM_BUCKETS - 1; i >= 0; i--) {
+        if(atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed) > 0) {
+            return bucket_highest_value(i) / NANOSECONDS_PER_MICROSECOND;
+        }
+    }
+    return 0;
+}
+
+// Appends formatted text to a STATS_BODY_BUFFER_SIZE buffer, stopping at the end of the buffer.
+static void append(char *buffer, size_t *length, const char *format, ...) {
+    va_list arguments;
+    if(*length >= STATS_BODY_BUFFER_SIZE - 1) {
+        return;
+    }
+    va_start(arguments, format);
+    int n = vsnprintf(buffer + *length, STATS_BODY_BUFFER_SIZE - *length, format, arguments);
+    va_end(arguments);
+    if(n > 0) {
+        *length += (size_t) n < STATS_BODY_BUFFER_SIZE - *length ? (size_t) n : STATS_BODY_BUFFER_SIZE - 1 - *length;
+    }
+}
@@ -0,0 +1,102 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_STATS_H
+#define COMP30023_2022_PROJECT_2_STATS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "monotonic.h"
+
+// Latencies are kept in nanoseconds in log-linear buckets like an HDR histogram: every power of two is split into
+// STATS_SUB_BUCKETS equal buckets, so a bucket is never more than 1/16th (about 6%) wider than the values in it.
+// Anything from 2^STATS_MAX_EXPONENT nanoseconds (about 69 seconds) up goes in the last bucket.
+#define STATS_SUB_BUCKET_BITS 4
+#define STATS_SUB_BUCKETS (1 << STATS_SUB_BUCKET_BITS)
+#define STATS_MAX_EXPONENT 36
+#define STATS_HISTOGRAM_BUCKETS ((STATS_MAX_EXPONENT - STATS_SUB_BUCKET_BITS + 1) * STATS_SUB_BUCKETS)
+
+#define STATS_PATH "/__stats"
+#define STATS_JSON_PATH "/__stats.json"
+#define STATS_BODY_BUFFER_SIZE 8192
+#define NANOSECONDS_PER_MICROSECOND 1000.0
+// Passed as the start time of a stage that is not being timed, which is what stats_now returns while stats are off.
+#define STATS_NOT_TIMED 0
+
+// Everything that is counted. Responses are counted by the class of their status code when they are prepared.
+// Connections which are turned away for going over a connection limit are counted as accepted and rejected, and
+// connections which are dropped for taking too long to send a request or to take a response as timed out.
+typedef enum stats_counter {
+    STATS_CONNECTIONS_ACCEPTED,
+    STATS_CONNECTIONS_REJECTED,
+    STATS_CONNECTIONS_TIMED_OUT,
+    STATS_REQUESTS,
+    STATS_INVALID_REQUESTS,
+    STATS_RESPONSES_2XX,
+    STATS_RESPONSES_3XX,
+    STATS_RESPONSES_4XX,
+    STATS_RESPONSES_5XX,
+    STATS_MEMORY_BYTES_SENT,
+    STATS_FILE_BYTES_SENT,
+    STATS_RESPONSE_CACHE_HITS,
+    STATS_RESPONSE_CACHE_MISSES,
+    STATS_FILE_CACHE_HITS,
+    STATS_FILE_CACHE_MISSES,
+    STATS_ACCESS_LOG_DROPPED,
+    NUM_STATS_COUNTERS
+} stats_counter_t;
+
+// The stages of serving a request that are timed. STATS_STAGE_FIRST_BYTE runs from accepting the connection to the
+// first bytes of its first request arriving. STATS_STAGE_OPEN is opening and stat'ing a file that was not in the file
+// cache. STATS_STAGE_HEADER_WRITE runs from the response being prepared until its headers (and any body in memory)
+// have been sent, and STATS_STAGE_BODY_SEND from there until the last byte of a body from a file has been sent, so
+// both include waiting for the client to take the data.
+typedef enum stats_stage {
+    STATS_STAGE_FIRST_BYTE,
+    STATS_STAGE_PARSE,
+    STATS_STAGE_OPEN,
+    STATS_STAGE_HEADER_WRITE,
+    STATS_STAGE_BODY_SEND,
+    NUM_STATS_STAGES
+} stats_stage_t;
+
+typedef struct stats_histogram stats_histogram_t;
+struct stats_histogram {
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum;
+    _Atomic uint64_t buckets[STATS_HISTOGRAM_BUCKETS];
+};
+
+// The counters and histograms of one thread. Only the thread itself ever writes to them, so they are updated with
+// plain relaxed loads and stores instead of atomic read-modify-writes, and never shared cache lines with another
+// thread's. Readers add up every thread's stats whenever they are asked for. The blocks of all running threads are
+// kept in a list so that they can be found.
+typedef struct stats stats_t;
+struct stats {
+    _Atomic uint64_t counters[NUM_STATS_COUNTERS];
+    stats_histogram_t histograms[NUM_STATS_STAGES];
+    stats_t *prev;
+    stats_t *next;
+};
+
+void stats_enable(void);
+
+bool stats_enabled(void);
+
+long stats_now(void);
+
+void stats_count(stats_counter_t counter, uint64_t amount);
+
+long stats_record(stats_stage_t stage, long start_time);
+
+char *render_stats(bool json, size_t *length);
+
+#endif //COMP30023_2022_PROJECT_2_STATS_H
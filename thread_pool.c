@@ -0,0 +1,85 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "thread_pool.h"
+
+// Starts config->num_workers pool workers and then accepts connections on the calling thread forever, handing each
+// one to the workers through the queue. When the queue is full the connection is either rejected with a 503 or the
+// accept loop waits for a worker to free up a slot, depending on config->overload_behaviour. While the accept loop
+// is waiting, new connections simply sit in the listen backlog. Only returns if the pool could not be started.
+bool run_thread_pool(int listen_sockfd, server_config_t *config) {
+    thread_pool_t pool;
+    pool.config = config;
+
+    if(!fd_queue_init(&pool.queue, config->queue_depth)) {
+        return false;
+    }
+
+    pool.thread_ids = (pthread_t *) malloc (config->num_workers * sizeof(pthread_t));
+    if(pool.thread_ids == NULL) {
+        perror("malloc");
+        return false;
+    }
+    for(int i = 0; i < config->num_workers; i++) {
+        pthread_attr_t attributes;
+        pthread_attr_init(&attributes);
+        if(config->pin_workers && !set_worker_cpu(&attributes, i)) {
+            return false;
+        }
+        if(pthread_create(&pool.thread_ids[i], &attributes, thread_pool_worker, (void *) &pool) != 0) {
+            perror("pthread_create");
+            return false;
+        }
+        pthread_attr_destroy(&attributes);
+    }
+    if(!upgrade_start()) {
+        return false;
+    }
+
+    while(true) {
+        // Same as the thread per connection accept loop, except that nothing needs to be allocated per connection.
+        upgrade_wait_for_connection(listen_sockfd);
+        struct sockaddr_storage client_addr;
+        socklen_t client_addr_size = sizeof client_addr;
+        int newsockfd = accept4(listen_sockfd, (struct sockaddr *) &client_addr, &client_addr_size, SOCK_CLOEXEC);
+        if(newsockfd < 0) {
+            if(errno != EAGAIN && errno != EWOULDBLOCK) {
+                perror("accept4");
+            }
+            continue;
+        }
+        long accepted_at = stats_now();
+        stats_count(STATS_CONNECTIONS_ACCEPTED, 1);
+        if(!admission_admit(&client_addr)) {
+            reject_connection(newsockfd);
+            continue;
+        }
+
+        // A connection that cannot be queued, because the queue is full or could not be waited on, is turned away.
+        bool queued = config->overload_behaviour == OVERLOAD_STOP_ACCEPTING ?
+                fd_queue_push(&pool.queue, newsockfd, &client_addr, accepted_at) :
+                fd_queue_try_push(&pool.queue, newsockfd, &client_addr, accepted_at);
+        if(!queued) {
+            reject_connection(newsockfd);
+            admission_release(&client_addr);
+        }
+    }
+    return true;
+}
+
+// Function that is passed into pthread_create for each pool worker. Takes sockets off the queue one at a time and
+// serves them the same way a thread per connection thread would. The request buffer is the worker's own for as long as
+// it runs, since it only ever serves one connection at a time. A worker whose queue can no longer be waited on stops,
+// rather than going round again straight away and failing the same way forever.
+void *thread_pool_worker(void *thread_pool_args) {
+    thread_pool_t *pool = (thread_pool_t *) thread_pool_args;
+    char buffer[REQUEST_MAX_BUFFER_SIZE];
+    struct sockaddr_storage client_addr;
+    long accepted_at;
+    int newsockfd;
+
+    while(fd_queue_pop(&pool->queue, &newsockfd, &client_addr, &accepted_at)) {
+        serve_client(newsockfd, &client_addr, pool->config, accepted_at, buffer);
+    }
+    return NULL;
+}
@@ -0,0 +1,42 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_THREAD_POOL_H
+#define COMP30023_2022_PROJECT_2_THREAD_POOL_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#include <sys/socket.h>
+#include <pthread.h>
+
+#include "config.h"
+#include "fd_queue.h"
+#include "respond.h"
+#include "admission.h"
+#include "upgrade.h"
+#include "affinity.h"
+#include "server.h"
+
+// A struct which contains the arguments needed for the thread_pool_worker function. Every worker shares the same
+// queue of accepted sockets.
+typedef struct thread_pool thread_pool_t;
+struct thread_pool {
+    fd_queue_t queue;
+    server_config_t *config;
+    pthread_t *thread_ids;
+};
+
+bool run_thread_pool(int listen_sockfd, server_config_t *config);
+
+void *thread_pool_worker(void *thread_pool_args);
+
+#endif //COMP30023_2022_PROJECT_2_THREAD_POOL_H
@@ -0,0 +1,306 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "upgrade.h"
+
+static bool take_inherited_fds(void);
+static bool is_listener(int sockfd);
+static bool start_new_server(pid_t *new_server);
+static char **build_environment(char *listen_fds_variable, char *ready_fd_variable);
+static void drain_and_exit(pid_t new_server);
+
+// Set once at startup, before any worker is started. Only the upgrade thread uses them after that.
+static int drain_timeout = UPGRADES_DISABLED;
+static char **server_argv = NULL;
+static char executable_path[PATH_MAX];
+static int listeners[UPGRADE_MAX_LISTENERS];
+static int num_listeners = 0;
+static int inherited_listeners[UPGRADE_MAX_LISTENERS];
+static int num_inherited_listeners = 0;
+static int next_inherited_listener = 0;
+static int ready_fd = NO_READY_FD;
+
+// Gets the server ready to hand over to a new process on UPGRADE_SIGNAL, if drain_timeout (in seconds) is not
+// UPGRADES_DISABLED. Has to be called before any thread is started, since the signal is blocked here so that every
+// thread started from now on has it blocked too, and only the upgrade thread ever takes it, with sigwait
+// (https://man7.org/linux/man-pages/man3/sigwait.3.html). The path of the executable is read now, while it is still
+// the file this server was started from, so that it is the new file deployed over it that gets executed later. If
+// this server was itself started by an upgrade, the listening sockets it inherited are picked up here for
+// open_listener to use instead of opening new ones. Returns false if the server could not be set up for upgrades.
+bool upgrade_init(char **argv, int timeout) {
+    drain_timeout = timeout;
+    if(drain_timeout == UPGRADES_DISABLED) {
+        return true;
+    }
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, UPGRADE_SIGNAL);
+    if(pthread_sigmask(SIG_BLOCK, &signals, NULL) != 0) {
+        perror("pthread_sigmask");
+        return false;
+    }
+    ssize_t path_length = readlink("/proc/self/exe", executable_path, sizeof executable_path - 1);
+    if(path_length < 0) {
+        perror("readlink");
+        return false;
+    }
+    executable_path[path_length] = '\0';
+    server_argv = argv;
+
+    return take_inherited_fds() && drain_init();
+}
+
+bool upgrade_enabled(void) {
+    return drain_timeout != UPGRADES_DISABLED;
+}
+
+// Returns the next listening socket inherited from the server this one replaced, or NO_INHERITED_LISTENER if there
+// are none left. The new server is started with the same arguments as the old one, so it opens its listening sockets
+// in the same order and each of them gets the socket the old server had in its place. Connections waiting in a
+// socket's queue carry on waiting there until the new server accepts them, so none are refused during the handover.
+int upgrade_take_listener(void) {
+    if(next_inherited_listener == num_inherited_listeners) {
+        return NO_INHERITED_LISTENER;
+    }
+    int sockfd = inherited_listeners[next_inherited_listener++];
+    upgrade_add_listener(sockfd);
+    return sockfd;
+}
+
+// Remembers a listening socket so that it can be handed over to the next server.
+void upgrade_add_listener(int sockfd) {
+    if(drain_timeout == UPGRADES_DISABLED || num_listeners == UPGRADE_MAX_LISTENERS) {
+        return;
+    }
+    listeners[num_listeners++] = sockfd;
+}
+
+// Called once the server has opened all of its listening sockets and is about to serve. Tells the server being
+// replaced (if there is one) that this one is ready to take over, closes any inherited listening sockets this server
+// has no use for, and starts the upgrade thread. Returns false if the thread could not be started.
+bool upgrade_start(void) {
+    if(drain_timeout == UPGRADES_DISABLED) {
+        return true;
+    }
+    while(next_inherited_listener < num_inherited_listeners) {
+        close(inherited_listeners[next_inherited_listener++]);
+    }
+    if(ready_fd != NO_READY_FD) {
+        if(write(ready_fd, READY_MESSAGE, READY_MESSAGE_LENGTH) < 0) {
+            perror("write");
+        }
+        close(ready_fd);
+        ready_fd = NO_READY_FD;
+    }
+
+    pthread_t upgrade_thread_id;
+    if(pthread_create(&upgrade_thread_id, NULL, upgrade_thread, NULL) != 0) {
+        perror("pthread_create");
+        return false;
+    }
+    pthread_detach(upgrade_thread_id);
+    return true;
+}
+
+// Used by the accept loops of the thread and pool modes, which block waiting for a connection, to wait for the server
+// to start draining at the same time. Returns once there is a connection to accept, though another process may take
+// it first, which is why those loops use a non-blocking listening socket when upgrades are enabled. Once the server
+// is draining the calling thread exits instead, leaving the upgrade thread to exit the process when the connections
+// are done. https://man7.org/linux/man-pages/man2/poll.2.html
+void upgrade_wait_for_connection(int listen_sockfd) {
+    if(drain_timeout == UPGRADES_DISABLED) {
+        return;
+    }
+    struct pollfd fds[] = {{.fd = listen_sockfd, .events = POLLIN}, {.fd = drain_wake_fd(), .events = POLLIN}};
+    while(!draining()) {
+        if(poll(fds, sizeof fds / sizeof fds[0], -1) < 0) {
+            if(errno != EINTR) {
+                perror("poll");
+            }
+            continue;
+        }
+        if(fds[0].revents != 0 && !draining()) {
+            return;
+        }
+    }
+    pthread_exit(NULL);
+}
+
+// Function that is passed into pthread_create for the upgrade thread. Waits for UPGRADE_SIGNAL and starts a new server
+// when it comes. If the new server does not start, this one carries on as though nothing happened and waits for the
+// signal again. Otherwise this server drains and exits.
+void *upgrade_thread(void *upgrade_args) {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, UPGRADE_SIGNAL);
+    pid_t new_server;
+    while(true) {
+        int signal_number;
+        if(sigwait(&signals, &signal_number) != 0) {
+            continue;
+        }
+        fprintf(stderr, "upgrade: starting %s\n", executable_path);
+        if(start_new_server(&new_server)) {
+            break;
+        }
+        fprintf(stderr, "upgrade: the new server did not start, carrying on\n");
+    }
+    drain_and_exit(new_server);
+    return NULL;
+}
+
+// Picks up the listening sockets and the ready pipe from the variables the server being replaced set, and removes
+// the variables so that they are not passed on to the next server. Each file descriptor is made close-on-exec again,
+// since it was only left open for this server to inherit. Anything that is not a listening socket is ignored.
+static bool take_inherited_fds(void) {
+    char *listen_fds = getenv(UPGRADE_LISTEN_FDS_VARIABLE);
+    char *ready = getenv(UPGRADE_READY_FD_VARIABLE);
+    if(listen_fds != NULL) {
+        char *save_pointer;
+        for(char *fd = strtok_r(listen_fds, UPGRADE_FD_SEPARATOR, &save_pointer);
+                fd != NULL && num_inherited_listeners < UPGRADE_MAX_LISTENERS;
+                fd = strtok_r(NULL, UPGRADE_FD_SEPARATOR, &save_pointer)) {
+            int sockfd = atoi(fd);
+            if(!is_listener(sockfd) || fcntl(sockfd, F_SETFD, FD_CLOEXEC) < 0) {
+                fprintf(stderr, "upgrade: %s is not an inherited listening socket\n", fd);
+                continue;
+            }
+            inherited_listeners[num_inherited_listeners++] = sockfd;
+        }
+    }
+    if(ready != NULL) {
+        ready_fd = atoi(ready);
+        if(fcntl(ready_fd, F_SETFD, FD_CLOEXEC) < 0) {
+            perror("fcntl");
+            ready_fd = NO_READY_FD;
+        }
+    }
+    unsetenv(UPGRADE_LISTEN_FDS_VARIABLE);
+    unsetenv(UPGRADE_READY_FD_VARIABLE);
+    return true;
+}
+
+// Whether the file descriptor is a socket that is listening for connections.
+// https://man7.org/linux/man-pages/man7/socket.7.html
+static bool is_listener(int sockfd) {
+    int listening = 0;
+    socklen_t length = sizeof listening;
+    return sockfd >= 0 && getsockopt(sockfd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &length) == 0 && listening;
+}
+
+// Forks and executes the server's executable with the same arguments, leaving the listening sockets open across the
+// exec (by clearing their close-on-exec flags in the child only) and telling it where they are through the
+// environment. Everything the child needs is built before the fork, since only async-signal-safe functions can be
+// called between fork and exec in a process with other threads (https://man7.org/linux/man-pages/man2/fork.2.html).
+// Then waits for the new server to write to the ready pipe, which it does once it has opened its listening sockets.
+// If it exits, or does not get that far in time, it is killed and false is returned.
+static bool start_new_server(pid_t *new_server) {
+    char listen_fds_variable[UPGRADE_VARIABLE_MAX_LENGTH];
+    char ready_fd_variable[UPGRADE_VARIABLE_MAX_LENGTH];
+    int ready_pipe[2];
+    if(pipe2(ready_pipe, O_CLOEXEC) < 0) {
+        perror("pipe2");
+        return false;
+    }
+
+    int length = snprintf(listen_fds_variable, sizeof listen_fds_variable, "%s=", UPGRADE_LISTEN_FDS_VARIABLE);
+    for(int i = 0; i < num_listeners; i++) {
+        length += snprintf(listen_fds_variable + length, sizeof listen_fds_variable - length, "%s%d",
+                           i == 0 ? "" : UPGRADE_FD_SEPARATOR, listeners[i]);
+    }
+    snprintf(ready_fd_variable, sizeof ready_fd_variable, "%s=%d", UPGRADE_READY_FD_VARIABLE, ready_pipe[1]);
+    char **environment = build_environment(listen_fds_variable, ready_fd_variable);
+    if(environment == NULL) {
+        close(ready_pipe[0]);
+        close(ready_pipe[1]);
+        return false;
+    }
+
+    pid_t pid = fork();
+    if(pid == 0) {
+        for(int i = 0; i < num_listeners; i++) {
+            fcntl(listeners[i], F_SETFD, 0);
+        }
+        fcntl(ready_pipe[1], F_SETFD, 0);
+        execve(executable_path, server_argv, environment);
+        _exit(UPGRADE_EXEC_FAILED);
+    }
+    free(environment);
+    close(ready_pipe[1]);
+    if(pid < 0) {
+        perror("fork");
+        close(ready_pipe[0]);
+        return false;
+    }
+
+    // The pipe only reaches end of file without the message if the new server exits (or closes it) before it is
+    // ready.
+    struct pollfd ready = {.fd = ready_pipe[0], .events = POLLIN};
+    char message[READY_MESSAGE_LENGTH];
+    bool started = poll(&ready, 1, UPGRADE_READY_TIMEOUT_MS) > 0 &&
+            read(ready_pipe[0], message, READY_MESSAGE_LENGTH) == READY_MESSAGE_LENGTH;
+    close(ready_pipe[0]);
+    if(!started) {
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        return false;
+    }
+    *new_server = pid;
+    return true;
+}
+
+// Returns a copy of the environment with the two variables set, leaving out any values of them this server was
+// started with. Only the array is allocated, the strings are the ones already in the environment. Returns NULL if it
+// could not be allocated.
+static char **build_environment(char *listen_fds_variable, char *ready_fd_variable) {
+    size_t num_variables = 0;
+    while(environ[num_variables] != NULL) {
+        num_variables++;
+    }
+    char **environment = (char **) malloc ((num_variables + 3) * sizeof(char *));
+    if(environment == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+
+    size_t length = 0;
+    size_t listen_fds_name_length = strlen(UPGRADE_LISTEN_FDS_VARIABLE);
+    size_t ready_fd_name_length = strlen(UPGRADE_READY_FD_VARIABLE);
+    for(size_t i = 0; i < num_variables; i++) {
+        if((strncmp(environ[i], UPGRADE_LISTEN_FDS_VARIABLE, listen_fds_name_length) == SAME_STRING &&
+                environ[i][listen_fds_name_length] == '=') ||
+                (strncmp(environ[i], UPGRADE_READY_FD_VARIABLE, ready_fd_name_length) == SAME_STRING &&
+                environ[i][ready_fd_name_length] == '=')) {
+            continue;
+        }
+        environment[length++] = environ[i];
+    }
+    environment[length++] = listen_fds_variable;
+    environment[length++] = ready_fd_variable;
+    environment[length] = NULL;
+    return environment;
+}
+
+// Stops accepting connections and waits for the ones already open to finish, for at most the drain timeout, then
+// exits once everything they logged has been written out. Responses that are part way through being sent (with
+// sendfile or otherwise) carry on being sent while this waits, and the new server accepts everything that comes in
+// from now on.
+static void drain_and_exit(pid_t new_server) {
+    drain_begin();
+    fprintf(stderr, "upgrade: handed over to process %d, draining %d connections\n", (int) new_server,
+            admission_open_connections());
+
+    struct timespec interval = {.tv_sec = 0,
+                                .tv_nsec = UPGRADE_DRAIN_POLL_INTERVAL_MS * UPGRADE_NANOSECONDS_PER_MILLISECOND};
+    time_t give_up_at = monotonic_seconds() + drain_timeout;
+    while(admission_open_connections() > 0 && monotonic_seconds() < give_up_at) {
+        nanosleep(&interval, NULL);
+    }
+    if(admission_open_connections() > 0) {
+        fprintf(stderr, "upgrade: closing %d connections that did not finish in time\n",
+                admission_open_connections());
+    }
+    access_log_finish();
+    exit(EXIT_SUCCESS);
+}
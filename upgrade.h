@@ -0,0 +1,66 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_UPGRADE_H
+#define COMP30023_2022_PROJECT_2_UPGRADE_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <signal.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+
+#include "drain.h"
+#include "admission.h"
+#include "access_log.h"
+#include "monotonic.h"
+
+// Sending the server this signal starts a new server in its place.
+#define UPGRADE_SIGNAL SIGUSR2
+#define UPGRADES_DISABLED 0
+// How a server finds the listening sockets and the ready pipe it inherited from the server it is replacing.
+#define UPGRADE_LISTEN_FDS_VARIABLE "SERVER_LISTEN_FDS"
+#define UPGRADE_READY_FD_VARIABLE "SERVER_READY_FD"
+#define UPGRADE_FD_SEPARATOR ","
+#define UPGRADE_MAX_LISTENERS 1024
+// Long enough for the name of either variable, the = and every listening socket's number.
+#define UPGRADE_VARIABLE_MAX_LENGTH (UPGRADE_MAX_LISTENERS * 12 + 64)
+// How long the new server gets to start up (and fill its caches) before it is given up on.
+#define UPGRADE_READY_TIMEOUT_MS 60000
+#define UPGRADE_DRAIN_POLL_INTERVAL_MS 100
+#define UPGRADE_NANOSECONDS_PER_MILLISECOND 1000000L
+#define UPGRADE_EXEC_FAILED 127
+#define NO_INHERITED_LISTENER -1
+#define NO_READY_FD -1
+#define READY_MESSAGE "R"
+#define READY_MESSAGE_LENGTH 1
+
+bool upgrade_init(char **argv, int drain_timeout);
+
+bool upgrade_enabled(void);
+
+int upgrade_take_listener(void);
+
+void upgrade_add_listener(int sockfd);
+
+bool upgrade_start(void);
+
+void upgrade_wait_for_connection(int listen_sockfd);
+
+void *upgrade_thread(void *upgrade_args);
+
+#endif //COMP30023_2022_PROJECT_2_UPGRADE_H
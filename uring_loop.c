@@ -0,0 +1,968 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "uring_loop.h"
+
+static bool uring_supported(bool *openat2_supported);
+static bool uring_init(uring_t *ring, unsigned entries);
+static void uring_destroy(uring_t *ring);
+static bool reserve_submissions(uring_t *ring, unsigned count);
+static struct io_uring_sqe *get_submission(uring_t *ring);
+static int submit_and_wait(uring_t *ring, unsigned wait_count);
+static void handle_completion(uring_worker_t *worker, struct io_uring_cqe *cqe);
+static void handle_accept(uring_worker_t *worker, int result, unsigned flags);
+static void complete_operation(uring_connection_t *connection, uring_operation_t operation, int result);
+static void advance_connection(uring_worker_t *worker, uring_connection_t *connection);
+static bool read_request(uring_worker_t *worker, uring_connection_t *connection);
+static bool start_response(uring_worker_t *worker, uring_connection_t *connection);
+static bool file_opened(uring_worker_t *worker, uring_connection_t *connection);
+static bool file_stat_ready(uring_worker_t *worker, uring_connection_t *connection);
+static bool send_response(uring_worker_t *worker, uring_connection_t *connection);
+static void finish_response(uring_worker_t *worker, uring_connection_t *connection);
+static void close_connection(uring_worker_t *worker, uring_connection_t *connection);
+static void release_file_path(uring_worker_t *worker, uring_connection_t *connection);
+static void sweep_deadlines(uring_worker_t *worker);
+static void shut_down_expired_connections(deadline_list_t *deadlines, bool timed_out);
+static bool submit_accept(uring_worker_t *worker);
+static bool submit_sweep(uring_worker_t *worker);
+static bool submit_drain_wait(uring_worker_t *worker);
+static void stop_accepting(uring_worker_t *worker);
+static bool submit_receive(uring_worker_t *worker, uring_connection_t *connection);
+static bool submit_open(uring_worker_t *worker, uring_connection_t *connection);
+static bool submit_statx(uring_worker_t *worker, uring_connection_t *connection);
+static bool submit_send(uring_worker_t *worker, uring_connection_t *connection, bool link_body);
+static bool submit_body_chunk(uring_worker_t *worker, uring_connection_t *connection);
+static bool submit_pipe_drain(uring_worker_t *worker, uring_connection_t *connection);
+static void add_body_chunk(uring_worker_t *worker, uring_connection_t *connection);
+static bool open_pipe(uring_connection_t *connection);
+static uint64_t operation_user_data(uring_connection_t *connection, uring_operation_t operation);
+static void statx_to_stat(struct statx *file_statx, struct stat *file_stat);
+
+// Starts config->num_workers io_uring workers which all accept from the shared listening socket, and then waits on
+// them. Each worker does the same job as an epoll event loop worker, but instead of being told when a socket is ready
+// and then making the system calls itself, it queues the calls up as submissions in its ring and is told when they
+// have been done. Everything queued while going through one batch of completions is handed to the kernel in a single
+// io_uring_enter call, which also waits for the next batch. If the kernel does not support io_uring (or the
+// operations the workers need), the epoll event loop is used instead. Only returns if the workers could not be
+// started.
+bool run_uring_loop(int listen_sockfd, server_config_t *config) {
+    bool openat2_supported;
+    if(!uring_supported(&openat2_supported)) {
+        fprintf(stderr, "io_uring is not available, falling back to the epoll event loop.\n");
+        config->serving_mode = SERVING_MODE_EPOLL;
+        return run_event_loop(listen_sockfd, config);
+    }
+
+    // Each worker on a cache line of its own, the same as the epoll workers.
+    uring_worker_t *workers = (uring_worker_t *) aligned_alloc (WORKER_CACHE_LINE_SIZE,
+                                                                config->num_workers * sizeof(uring_worker_t));
+    if(workers == NULL) {
+        perror("aligned_alloc");
+        return false;
+    }
+    memset(workers, 0, config->num_workers * sizeof(uring_worker_t));
+
+    for(int i = 0; i < config->num_workers; i++) {
+        // A pinned worker's rings are set up on its own CPU, so that the kernel allocates them on its NUMA node.
+        if(config->pin_workers && !move_to_worker_cpu(i)) {
+            return false;
+        }
+        workers[i].listen_sockfd = listen_sockfd;
+        workers[i].config = config;
+        workers[i].multishot_accept = true;
+        workers[i].open_beneath = openat2_supported && web_root_resolves_beneath();
+        workers[i].sweep_interval.tv_sec = DEADLINE_SWEEP_INTERVAL_MS / MILLISECONDS_PER_SECOND;
+        workers[i].sweep_interval.tv_nsec = 0;
+        deadline_list_init(&workers[i].keep_alive_deadlines, config->keep_alive_timeout);
+        deadline_list_init(&workers[i].header_deadlines, config->header_timeout);
+        deadline_list_init(&workers[i].send_deadlines, config->send_timeout);
+        if(!uring_init(&workers[i].ring, URING_QUEUE_DEPTH)) {
+            perror("io_uring_setup");
+            return false;
+        }
+        slab_init(&workers[i].connections, sizeof(uring_connection_t), false);
+        slab_init(&workers[i].file_paths, FILE_PATH_BUFFER_SIZE, false);
+    }
+    if(config->pin_workers && !restore_cpus()) {
+        return false;
+    }
+
+    for(int i = 0; i < config->num_workers; i++) {
+        pthread_attr_t attributes;
+        pthread_attr_init(&attributes);
+        if(config->pin_workers && !set_worker_cpu(&attributes, i)) {
+            return false;
+        }
+        if(pthread_create(&workers[i].thread_id, &attributes, uring_worker, (void *) &workers[i]) != 0) {
+            perror("pthread_create");
+            return false;
+        }
+        pthread_attr_destroy(&attributes);
+    }
+    if(!upgrade_start()) {
+        return false;
+    }
+
+    for(int i = 0; i < config->num_workers; i++) {
+        pthread_join(workers[i].thread_id, NULL);
+    }
+    free(workers);
+    return true;
+}
+
+// Function that is passed into pthread_create for each worker. Starts accepting connections and then goes round
+// submitting whatever has been queued up, waiting for at least one completion and handling every completion that is
+// ready, forever. Each completion is taken off the completion queue before it is handled, so the kernel always has
+// room to post more.
+void *uring_worker(void *uring_worker_args) {
+    uring_worker_t *worker = (uring_worker_t *) uring_worker_args;
+    uring_t *ring = &worker->ring;
+
+    slab_reserve(&worker->connections);
+    slab_reserve(&worker->file_paths);
+    if(!submit_accept(worker) || !submit_sweep(worker) || (upgrade_enabled() && !submit_drain_wait(worker))) {
+        return NULL;
+    }
+    while(true) {
+        // EINTR is being interrupted by a signal and EBUSY is the completion queue being full, both of which are
+        // dealt with by going through the completions.
+        if(submit_and_wait(ring, 1) < 0 && errno != EINTR && errno != EBUSY) {
+            perror("io_uring_enter");
+        }
+
+        unsigned head = *ring->cq_head;
+        while(head != atomic_load_explicit((_Atomic unsigned *) ring->cq_tail, memory_order_acquire)) {
+            struct io_uring_cqe cqe = ring->cqes[head & *ring->cq_mask];
+            head++;
+            atomic_store_explicit((_Atomic unsigned *) ring->cq_head, head, memory_order_release);
+            handle_completion(worker, &cqe);
+        }
+    }
+    return NULL;
+}
+
+// Checks that io_uring can be set up and supports every operation the workers use, by probing a small ring. Whether
+// it can also do openat2 is filled in too, though files can still be opened with openat without it.
+// https://man7.org/linux/man-pages/man2/io_uring_register.2.html
+static bool uring_supported(bool *openat2_supported) {
+    static const int required_operations[] = {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_TIMEOUT,
+                                              IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_SENDMSG,
+                                              IORING_OP_SPLICE, IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL};
+    uring_t ring;
+    if(!uring_init(&ring, 1)) {
+        return false;
+    }
+
+    size_t probe_size = sizeof(struct io_uring_probe) + URING_MAX_PROBE_OPS * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = (struct io_uring_probe *) calloc (1, probe_size);
+    bool supported = probe != NULL &&
+            syscall(__NR_io_uring_register, ring.ring_fd, IORING_REGISTER_PROBE, probe, URING_MAX_PROBE_OPS) >= 0;
+    for(size_t i = 0; supported && i < sizeof(required_operations) / sizeof(required_operations[0]); i++) {
+        int operation = required_operations[i];
+        if(operation > probe->last_op || !(probe->ops[operation].flags & IO_URING_OP_SUPPORTED)) {
+            supported = false;
+        }
+    }
+    *openat2_supported = supported && IORING_OP_OPENAT2 <= probe->last_op &&
+            (probe->ops[IORING_OP_OPENAT2].flags & IO_URING_OP_SUPPORTED);
+    free(probe);
+    uring_destroy(&ring);
+    return supported;
+}
+
+// Sets up an io_uring instance with room for entries submissions and maps its queues into memory. The completion
+// queue is made much bigger than the submission queue since every connection can have a few operations in flight.
+// COOP_TASKRUN stops the kernel from interrupting the worker to finish off operations, which it does anyway when the
+// worker next calls io_uring_enter. https://man7.org/linux/man-pages/man2/io_uring_setup.2.html
+// Returns false with errno set if the ring could not be set up.
+static bool uring_init(uring_t *ring, unsigned entries) {
+    struct io_uring_params params;
+    memset(ring, 0, sizeof(uring_t));
+    memset(&params, 0, sizeof params);
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = URING_COMPLETION_QUEUE_DEPTH;
+    ring->ring_fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+    // COOP_TASKRUN only exists from Linux 5.19, so try again without it on older kernels.
+    if(ring->ring_fd < 0 && errno == EINVAL) {
+        memset(&params, 0, sizeof params);
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = URING_COMPLETION_QUEUE_DEPTH;
+        ring->ring_fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+    }
+    if(ring->ring_fd < 0) {
+        return false;
+    }
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    // Newer kernels put both queues in one mapping.
+    bool single_mapping = params.features & IORING_FEAT_SINGLE_MMAP;
+    if(single_mapping) {
+        if(ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring_memory = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                ring->ring_fd, IORING_OFF_SQ_RING);
+    if(ring->sq_ring_memory == MAP_FAILED) {
+        ring->sq_ring_memory = NULL;
+        uring_destroy(ring);
+        return false;
+    }
+    if(single_mapping) {
+        ring->cq_ring_memory = ring->sq_ring_memory;
+    } else {
+        ring->cq_ring_memory = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                    ring->ring_fd, IORING_OFF_CQ_RING);
+        if(ring->cq_ring_memory == MAP_FAILED) {
+            ring->cq_ring_memory = NULL;
+            uring_destroy(ring);
+            return false;
+        }
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe *) mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                                              MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+    if(ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        uring_destroy(ring);
+        return false;
+    }
+
+    char *sq_ring = (char *) ring->sq_ring_memory;
+    char *cq_ring = (char *) ring->cq_ring_memory;
+    ring->sq_entries = params.sq_entries;
+    ring->sq_head = (unsigned *) (sq_ring + params.sq_off.head);
+    ring->sq_tail = (unsigned *) (sq_ring + params.sq_off.tail);
+    ring->sq_mask = (unsigned *) (sq_ring + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) (sq_ring + params.sq_off.array);
+    ring->sqe_tail = *ring->sq_tail;
+    ring->cq_head = (unsigned *) (cq_ring + params.cq_off.head);
+    ring->cq_tail = (unsigned *) (cq_ring + params.cq_off.tail);
+    ring->cq_mask = (unsigned *) (cq_ring + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq_ring + params.cq_off.cqes);
+    return true;
+}
+
+// Unmaps the ring's queues and closes it.
+static void uring_destroy(uring_t *ring) {
+    if(ring->sqes != NULL) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if(ring->cq_ring_memory != NULL && ring->cq_ring_memory != ring->sq_ring_memory) {
+        munmap(ring->cq_ring_memory, ring->cq_ring_size);
+    }
+    if(ring->sq_ring_memory != NULL) {
+        munmap(ring->sq_ring_memory, ring->sq_ring_size);
+    }
+    close(ring->ring_fd);
+}
+
+// Makes sure there is room for count more submissions, handing what has been queued so far to the kernel if there is
+// not. Operations which are linked together are reserved together so that they all end up in the same submission.
+// Returns false if there is still no room.
+static bool reserve_submissions(uring_t *ring, unsigned count) {
+    unsigned head = atomic_load_explicit((_Atomic unsigned *) ring->sq_head, memory_order_acquire);
+    if(ring->sq_entries - (ring->sqe_tail - head) >= count) {
+        return true;
+    }
+    if(submit_and_wait(ring, 0) < 0) {
+        perror("io_uring_enter");
+        return false;
+    }
+    head = atomic_load_explicit((_Atomic unsigned *) ring->sq_head, memory_order_acquire);
+    return ring->sq_entries - (ring->sqe_tail - head) >= count;
+}
+
+// Returns the next free submission queue entry, cleared out, and queues it up to be submitted. There must be room
+// for it, which reserve_submissions makes sure of.
+static struct io_uring_sqe *get_submission(uring_t *ring) {
+    unsigned index = ring->sqe_tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    ring->sq_array[index] = index;
+    ring->sqe_tail++;
+    return sqe;
+}
+
+// Publishes every queued submission to the kernel and waits for at least wait_count completions. Returns the result
+// of io_uring_enter, which is -1 with errno set on an error.
+// https://man7.org/linux/man-pages/man2/io_uring_enter.2.html
+static int submit_and_wait(uring_t *ring, unsigned wait_count) {
+    atomic_store_explicit((_Atomic unsigned *) ring->sq_tail, ring->sqe_tail, memory_order_release);
+    unsigned to_submit = ring->sqe_tail - atomic_load_explicit((_Atomic unsigned *) ring->sq_head,
+                                                               memory_order_acquire);
+    return (int) syscall(__NR_io_uring_enter, ring->ring_fd, to_submit, wait_count,
+                         wait_count > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+}
+
+// Works out which connection and operation a completion is for and records its result. Once the last operation the
+// connection was waiting on has completed, the connection moves on to its next step.
+static void handle_completion(uring_worker_t *worker, struct io_uring_cqe *cqe) {
+    if(cqe->user_data == URING_ACCEPT_USER_DATA) {
+        handle_accept(worker, cqe->res, cqe->flags);
+        return;
+    }
+    if(cqe->user_data == URING_SWEEP_USER_DATA) {
+        sweep_deadlines(worker);
+        return;
+    }
+    if(cqe->user_data == URING_DRAIN_USER_DATA) {
+        stop_accepting(worker);
+        return;
+    }
+    // Whether the accept was still there to be cancelled makes no difference.
+    if(cqe->user_data == URING_CANCEL_USER_DATA) {
+        return;
+    }
+
+    uring_connection_t *connection =
+            (uring_connection_t *) (uintptr_t) (cqe->user_data & ~(uint64_t) URING_OPERATION_MASK);
+    complete_operation(connection, (uring_operation_t) (cqe->user_data & URING_OPERATION_MASK), cqe->res);
+    connection->pending_operations--;
+    if(connection->pending_operations == 0) {
+        advance_connection(worker, connection);
+    }
+}
+
+// Sets up a connection for a socket that has just been accepted, or deals with the accept having failed. A multishot
+// accept keeps on producing a completion for every new connection until the kernel says it has stopped (by leaving
+// out IORING_CQE_F_MORE), at which point it is submitted again. Kernels before 5.19 reject multishot accepts, in
+// which case the worker falls back to submitting a fresh accept after every connection.
+static void handle_accept(uring_worker_t *worker, int result, unsigned flags) {
+    if(result >= 0) {
+        // Multishot accepts cannot hand back each connection's address, so it is asked for separately, and only
+        // when it is going to be logged or counted. https://man7.org/linux/man-pages/man2/getpeername.2.html
+        struct sockaddr_storage client_addr = {.ss_family = AF_UNSPEC};
+        if(access_log_enabled() || admission_limits_clients()) {
+            socklen_t client_addr_size = sizeof client_addr;
+            getpeername(result, (struct sockaddr *) &client_addr, &client_addr_size);
+        }
+        stats_count(STATS_CONNECTIONS_ACCEPTED, 1);
+        uring_connection_t *connection = NULL;
+        if(!admission_admit(&client_addr)) {
+            reject_connection(result);
+        } else if((connection = (uring_connection_t *) slab_alloc(&worker->connections)) == NULL) {
+            close(result);
+            admission_release(&client_addr);
+        } else {
+            // Zeroed so that the connection starts off with an empty buffer and a parser at the start of it.
+            memset(connection, 0, sizeof(uring_connection_t));
+            connection->sockfd = result;
+            connection->client_addr = client_addr;
+            connection->state = URING_READING_REQUEST;
+            connection->opened_fd = NO_FILE_DESCRIPTOR;
+            connection->pipe_fds[0] = NO_PIPE;
+            connection->pipe_fds[1] = NO_PIPE;
+            connection->response.file_fd = NO_FILE_DESCRIPTOR;
+            connection->accepted_at = stats_now();
+            connection->deadline.owner = connection;
+            deadline_start(&connection->deadline, &worker->header_deadlines, monotonic_seconds());
+            advance_connection(worker, connection);
+        }
+    } else if(result == -EINVAL && worker->multishot_accept) {
+        worker->multishot_accept = false;
+    } else if(result != -ECANCELED) {
+        fprintf(stderr, "accept: %s\n", strerror(-result));
+    }
+
+    // A server that is draining leaves accepting to the server taking over.
+    if(!(flags & IORING_CQE_F_MORE) && !draining()) {
+        submit_accept(worker);
+    }
+}
+
+// Records the result of one of a connection's operations. Results are the return values of the equivalent system
+// calls, with errors given as negative error numbers. An operation linked after one which failed or came up short is
+// cancelled (-ECANCELED) without having been done, and the connection just carries on from where the earlier
+// operation left it.
+static void complete_operation(uring_connection_t *connection, uring_operation_t operation, int result) {
+    switch(operation) {
+        case URING_RECEIVE:
+            // 0 means the client closed the connection, or that it was shut down for running out of time.
+            if(result <= 0) {
+                connection->failed = true;
+            } else {
+                connection->bytes_read_so_far += result;
+                stats_record(STATS_STAGE_FIRST_BYTE, connection->accepted_at);
+                connection->accepted_at = STATS_NOT_TIMED;
+            }
+            break;
+        case URING_OPEN:
+            connection->opened_fd = result < 0 ? NO_FILE_DESCRIPTOR : result;
+            break;
+        case URING_STATX:
+            connection->stat_failed = result < 0;
+            break;
+        case URING_SEND:
+            if(result < 0) {
+                connection->failed = true;
+            } else {
+                connection->response.buffers_sent += result;
+            }
+            break;
+        case URING_SPLICE_TO_PIPE:
+            // Nothing being spliced means the file got shorter after it was opened. The Content-Length has already
+            // gone out, so the connection has to be dropped.
+            if(result > 0) {
+                connection->pipe_bytes += result;
+                connection->response.body_offset += result;
+            } else if(result != -ECANCELED) {
+                connection->failed = true;
+            }
+            break;
+        case URING_SPLICE_TO_SOCKET:
+            if(result > 0) {
+                connection->pipe_bytes -= result;
+                stats_count(STATS_FILE_BYTES_SENT, result);
+            } else if(result != -ECANCELED) {
+                connection->failed = true;
+            }
+            break;
+        case URING_ACCEPT:
+            break;
+    }
+}
+
+// Moves the connection through as many stages as it can. Each stage either moves the connection on to another stage
+// and returns true, or submits the operations it needs and returns false, in which case the connection picks up from
+// the same stage once all of them have completed.
+static void advance_connection(uring_worker_t *worker, uring_connection_t *connection) {
+    if(connection->failed) {
+        connection->state = URING_CLOSING;
+    }
+    while(true) {
+        switch(connection->state) {
+            case URING_READING_REQUEST:
+                if(!read_request(worker, connection)) {
+                    return;
+                }
+                break;
+            case URING_OPENING_FILE:
+                if(!file_opened(worker, connection)) {
+                    return;
+                }
+                break;
+            case URING_STATTING_FILE:
+                if(!file_stat_ready(worker, connection)) {
+                    return;
+                }
+                break;
+            case URING_SENDING_RESPONSE:
+                if(!send_response(worker, connection)) {
+                    return;
+                }
+                break;
+            case URING_CLOSING:
+                close_connection(worker, connection);
+                return;
+        }
+    }
+}
+
+// Looks for a complete request in what has been received so far, and receives more if there is not one yet. The
+// receive waits for as long as it takes, and it is the connection's deadline that cuts it short.
+static bool read_request(uring_worker_t *worker, uring_connection_t *connection) {
+    // Something has arrived, so the connection is no longer idle and the header timeout of its next request starts.
+    if(connection->deadline.list == &worker->keep_alive_deadlines && connection->bytes_read_so_far > 0) {
+        deadline_start(&connection->deadline, &worker->header_deadlines, monotonic_seconds());
+    }
+    size_t request_length = find_request_end(&connection->parser, connection->buffer,
+                                             connection->bytes_read_so_far);
+    if(request_length != NO_COMPLETE_REQUEST) {
+        connection->request_length = request_length;
+        return start_response(worker, connection);
+    }
+
+    // A request which fills up the whole buffer without ending is answered with a 404 like other invalid requests,
+    // since it can never be completed. The 404 closes the connection.
+    if(connection->bytes_read_so_far == REQUEST_MAX_BUFFER_SIZE) {
+        connection->response_started_at = access_log_start();
+        prepare_http_response(&connection->response, NULL, NULL);
+        connection->request_length = connection->bytes_read_so_far;
+        connection->state = URING_SENDING_RESPONSE;
+        return true;
+    }
+    if(!submit_receive(worker, connection)) {
+        connection->state = URING_CLOSING;
+        return true;
+    }
+    return false;
+}
+
+// Parses the request and prepares the response to it from the caches if possible, the same way as
+// prepare_response_to_request. Otherwise, the file is opened through the ring instead of with a blocking open().
+static bool start_response(uring_worker_t *worker, uring_connection_t *connection) {
+    http_request_t *request = &connection->request;
+    http_response_t *response = &connection->response;
+
+    connection->state = URING_SENDING_RESPONSE;
+    connection->response_started_at = access_log_start();
+    deadline_stop(&connection->deadline);
+    if(!parse_request_with_stats(connection->buffer, connection->request_length, request)) {
+        prepare_http_response(response, NULL, NULL);
+        return true;
+    }
+    if(prepare_precompressed_response(response, request, worker->config)) {
+        return true;
+    }
+    if(prepare_response_from_caches(response, request, worker->config)) {
+        return true;
+    }
+    // The path has to stay put until the open has been done, so it is built in a buffer from the worker's slab which
+    // the connection holds on to until the response is finished.
+    connection->file_path = (char *) slab_alloc(&worker->file_paths);
+    if(connection->file_path == NULL) {
+        connection->state = URING_CLOSING;
+        return true;
+    }
+    if(!get_file_path(connection->file_path, request->request_path)) {
+        prepare_http_response(response, request, NULL);
+        return true;
+    }
+
+    connection->state = URING_OPENING_FILE;
+    connection->open_started_at = stats_now();
+    if(!submit_open(worker, connection)) {
+        connection->state = URING_CLOSING;
+        return true;
+    }
+    return false;
+}
+
+// Called once the file has been opened. If there is nothing at the file path, the request gets a 404. Otherwise the
+// file is stat'ed through the ring, which gives the same information as fstat().
+static bool file_opened(uring_worker_t *worker, uring_connection_t *connection) {
+    if(connection->opened_fd == NO_FILE_DESCRIPTOR) {
+        prepare_http_response(&connection->response, &connection->request, NULL);
+        connection->state = URING_SENDING_RESPONSE;
+        return true;
+    }
+
+    connection->state = URING_STATTING_FILE;
+    if(!submit_statx(worker, connection)) {
+        connection->state = URING_CLOSING;
+        return true;
+    }
+    return false;
+}
+
+// Called once the opened file has been stat'ed. The response is prepared from the open file, which is added to the
+// file cache when it is enabled so that the next request for it does not have to open it again, and small files are
+// rendered into the response cache.
+static bool file_stat_ready(uring_worker_t *worker, uring_connection_t *connection) {
+    server_config_t *config = worker->config;
+    http_request_t *request = &connection->request;
+    http_response_t *response = &connection->response;
+    struct stat file_stat;
+    int file_fd = connection->opened_fd;
+    char *file_path = connection->file_path;
+
+    stats_record(STATS_STAGE_OPEN, connection->open_started_at);
+    connection->opened_fd = NO_FILE_DESCRIPTOR;
+    memset(&file_stat, 0, sizeof file_stat);
+    if(connection->stat_failed) {
+        close(file_fd);
+        file_fd = NO_FILE_DESCRIPTOR;
+    } else {
+        statx_to_stat(&connection->file_statx, &file_stat);
+    }
+
+    if(config->file_cache != NULL && file_fd != NO_FILE_DESCRIPTOR && S_ISREG(file_stat.st_mode)) {
+        // The file cache entry takes over the file descriptor.
+        file_cache_entry_t *entry = file_cache_add(config->file_cache, request->request_path,
+                                                   CONTENT_ENCODING_IDENTITY, file_path, file_fd, &file_stat);
+        prepare_cached_http_response(response, request, entry);
+        file_path = entry == NULL ? NULL : entry->file_path;
+    } else {
+        prepare_opened_http_response(response, request, file_path, file_fd, &file_stat, CONTENT_ENCODING_IDENTITY);
+    }
+    add_response_to_cache(response, request, file_path, config);
+
+    connection->state = URING_SENDING_RESPONSE;
+    return true;
+}
+
+// Sends whatever is left of the response. The buffers go out with a single sendmsg, and a body from a file is moved
+// to the socket a chunk at a time by splicing it into the connection's pipe and from there into the socket, which
+// like sendfile never copies it into user space. The first chunk is linked behind the sendmsg, so that the headers
+// and the start of the body are submitted together. Once everything has been sent, the connection either goes back to
+// reading the next request or is closed.
+static bool send_response(uring_worker_t *worker, uring_connection_t *connection) {
+    http_response_t *response = &connection->response;
+    bool submitted;
+
+    if(response_buffers_sent(response)) {
+        record_headers_sent(response);
+    }
+    if(!response_buffers_sent(response)) {
+        submitted = submit_send(worker, connection, response_file_body_pending(response) &&
+                                                    connection->pipe_bytes == 0);
+    } else if(connection->pipe_bytes > 0) {
+        // The socket did not take everything that was spliced into the pipe last time.
+        submitted = submit_pipe_drain(worker, connection);
+    } else if(response_file_body_pending(response)) {
+        submitted = submit_body_chunk(worker, connection);
+    } else if(response_next_part(response)) {
+        // The next part of a multipart body goes out the same way, starting with its headers.
+        return true;
+    } else {
+        if(response->file_fd != NO_FILE_DESCRIPTOR) {
+            record_body_sent(response);
+        }
+        finish_response(worker, connection);
+        return true;
+    }
+
+    if(!submitted) {
+        connection->state = URING_CLOSING;
+        return true;
+    }
+    // Every send starts the deadline again, so only a response which stops going anywhere runs out of time.
+    deadline_start(&connection->deadline, &worker->send_deadlines, monotonic_seconds());
+    return false;
+}
+
+// Called once the response has been sent. A persistent connection goes back to reading its next request, starting
+// with whatever was received past the end of this one, and is idle until that arrives. A server that has started
+// draining since the response was prepared closes the connection anyway.
+static void finish_response(uring_worker_t *worker, uring_connection_t *connection) {
+    access_log_response(&connection->client_addr, &connection->response, connection->response_started_at);
+    connection->response_started_at = NOT_LOGGING;
+    release_http_response(&connection->response);
+    release_file_path(worker, connection);
+    if(!connection->response.keep_alive || draining()) {
+        connection->state = URING_CLOSING;
+        return;
+    }
+
+    connection->bytes_read_so_far -= connection->request_length;
+    memmove(connection->buffer, connection->buffer + connection->request_length, connection->bytes_read_so_far);
+    connection->request_length = 0;
+    deadline_start(&connection->deadline, connection->bytes_read_so_far == 0 ? &worker->keep_alive_deadlines
+                                                                            : &worker->header_deadlines,
+                   monotonic_seconds());
+    connection->state = URING_READING_REQUEST;
+}
+
+// Closes the connection and hands it back to the worker's slab along with everything it holds. Only called once none
+// of its operations are in flight, so the kernel is no longer using any of it. A response that was still being sent
+// is logged with however much of it got out.
+static void close_connection(uring_worker_t *worker, uring_connection_t *connection) {
+    deadline_stop(&connection->deadline);
+    access_log_response(&connection->client_addr, &connection->response, connection->response_started_at);
+    release_http_response(&connection->response);
+    release_file_path(worker, connection);
+    if(connection->opened_fd != NO_FILE_DESCRIPTOR) {
+        close(connection->opened_fd);
+    }
+    if(connection->pipe_fds[0] != NO_PIPE) {
+        close(connection->pipe_fds[0]);
+        close(connection->pipe_fds[1]);
+    }
+    close(connection->sockfd);
+    admission_release(&connection->client_addr);
+    slab_free(&worker->connections, connection);
+}
+
+// Called every sweep interval by the sweep timeout. Connections which have run out of time are shut down rather than
+// closed, since the kernel may still be using them for their receive or send. Shutting the socket down makes those
+// finish straight away (a receive with 0 and a send with an error), after which the connection is closed the usual
+// way. Then the timeout is submitted again for the next sweep.
+static void sweep_deadlines(uring_worker_t *worker) {
+    shut_down_expired_connections(&worker->keep_alive_deadlines, false);
+    shut_down_expired_connections(&worker->header_deadlines, true);
+    shut_down_expired_connections(&worker->send_deadlines, true);
+    if(!submit_sweep(worker)) {
+        fprintf(stderr, "io_uring: could not submit the deadline sweep\n");
+    }
+}
+
+// Shuts down every connection in the list whose deadline has run out, counting them as timed out unless they were only
+// idle persistent connections. https://man7.org/linux/man-pages/man2/shutdown.2.html
+static void shut_down_expired_connections(deadline_list_t *deadlines, bool timed_out) {
+    time_t now = monotonic_seconds();
+    uring_connection_t *connection;
+    while((connection = (uring_connection_t *) deadline_list_expired(deadlines, now)) != NULL) {
+        if(timed_out) {
+            stats_count(STATS_CONNECTIONS_TIMED_OUT, 1);
+        }
+        deadline_stop(&connection->deadline);
+        shutdown(connection->sockfd, SHUT_RDWR);
+    }
+}
+
+// Hands the buffer the connection's file path was built in back to the worker's slab, if it has one.
+static void release_file_path(uring_worker_t *worker, uring_connection_t *connection) {
+    if(connection->file_path != NULL) {
+        slab_free(&worker->file_paths, connection->file_path);
+        connection->file_path = NULL;
+    }
+}
+
+// Submits an accept on the listening socket. The new sockets are created close-on-exec, but are otherwise left
+// blocking, since the ring never blocks on them anyway.
+static bool submit_accept(uring_worker_t *worker) {
+    if(!reserve_submissions(&worker->ring, 1)) {
+        return false;
+    }
+    struct io_uring_sqe *sqe = get_submission(&worker->ring);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = worker->listen_sockfd;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    if(worker->multishot_accept) {
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    }
+    sqe->user_data = URING_ACCEPT_USER_DATA;
+    return true;
+}
+
+// Submits a timeout which completes after the sweep interval, for the next sweep of the deadline lists. A timeout
+// with no completion count only ever completes when its time is up.
+// https://man7.org/linux/man-pages/man2/io_uring_enter.2.html
+static bool submit_sweep(uring_worker_t *worker) {
+    if(!reserve_submissions(&worker->ring, 1)) {
+        return false;
+    }
+    struct io_uring_sqe *sqe = get_submission(&worker->ring);
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->addr = (uint64_t) (uintptr_t) &worker->sweep_interval;
+    sqe->len = 1;
+    sqe->user_data = URING_SWEEP_USER_DATA;
+    return true;
+}
+
+// Submits a poll for the eventfd that becomes readable once the server starts draining. A poll without
+// IORING_POLL_ADD_MULTI only completes once, which is all that is needed since the server never stops draining.
+static bool submit_drain_wait(uring_worker_t *worker) {
+    if(!reserve_submissions(&worker->ring, 1)) {
+        return false;
+    }
+    struct io_uring_sqe *sqe = get_submission(&worker->ring);
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = drain_wake_fd();
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = URING_DRAIN_USER_DATA;
+    return true;
+}
+
+// Submits a receive into the rest of the connection's buffer.
+static bool submit_receive(uring_worker_t *worker, uring_connection_t *connection) {
+    if(!reserve_submissions(&worker->ring, 1)) {
+        return false;
+    }
+    struct io_uring_sqe *sqe = get_submission(&worker->ring);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = connection->sockfd;
+    sqe->addr = (uint64_t) (uintptr_t) (connection->buffer + connection->bytes_read_so_far);
+    sqe->len = REQUEST_MAX_BUFFER_SIZE - connection->bytes_read_so_far;
+    sqe->user_data = operation_user_data(connection, URING_RECEIVE);
+    connection->pending_operations++;
+    return true;
+}
+
+// Submits an open of the connection's file path, which is relative to the web root, the same way as
+// web_root_open_file. With openat2 the open_how is passed by pointer and its size goes in len.
+// https://man7.org/linux/man-pages/man2/io_uring_enter.2.html
+static bool submit_open(uring_worker_t *worker, uring_connection_t *connection) {
+    if(!reserve_submissions(&worker->ring, 1)) {
+        return false;
+    }
+    struct io_uring_sqe *sqe = get_submission(&worker->ring);
+    sqe->fd = web_root_fd();
+    sqe->addr = (uint64_t) (uintptr_t) connection->file_path;
+    if(worker->open_beneath) {
+        sqe->opcode = IORING_OP_OPENAT2;
+        sqe->len = sizeof(struct open_how);
+        sqe->off = (uint64_t) (uintptr_t) web_root_open_how();
+    } else {
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->open_flags = WEB_ROOT_OPEN_FLAGS;
+    }
+    sqe->user_data = operation_user_data(connection, URING_OPEN);
+    connection->pending_operations++;
+    return true;
+}
+
+// Submits a statx of the file that was just opened. An empty path with AT_EMPTY_PATH stats the file descriptor
+// itself, like fstat(). https://man7.org/linux/man-pages/man2/statx.2.html
+static bool submit_statx(uring_worker_t *worker, uring_connection_t *connection) {
+    if(!reserve_submissions(&worker->ring, 1)) {
+        return false;
+    }
+    struct io_uring_sqe *sqe = get_submission(&worker->ring);
+    sqe->opcode = IORING_OP_STATX;
+    sqe->fd = connection->opened_fd;
+    sqe->addr = (uint64_t) (uintptr_t) "";
+    sqe->len = STATX_BASIC_STATS;
+    sqe->statx_flags = AT_EMPTY_PATH;
+    sqe->off = (uint64_t) (uintptr_t) &connection->file_statx;
+    sqe->user_data = operation_user_data(connection, URING_STATX);
+    connection->pending_operations++;
+    return true;
+}
+
+// Submits a sendmsg of the response's unsent buffers, with the first chunk of the body linked behind it if
+// link_body is set. MSG_MORE holds the headers back so they leave with the start of the body, as in
+// write_response_buffers. A linked sendmsg also gets MSG_WAITALL, which makes a short send count as a failure so that
+// the splices are cancelled rather than sending some of the body before all of the headers have gone out.
+static bool submit_send(uring_worker_t *worker, uring_connection_t *connection, bool link_body) {
+    http_response_t *response = &connection->response;
+
+    if(link_body && !open_pipe(connection)) {
+        return false;
+    }
+    if(!reserve_submissions(&worker->ring, link_body ? 3 : 1)) {
+        return false;
+    }
+
+    int num_unsent_buffers = get_unsent_response_buffers(response, connection->unsent_buffers);
+    memset(&connection->message, 0, sizeof(struct msghdr));
+    connection->message.msg_iov = connection->unsent_buffers;
+    connection->message.msg_iovlen = num_unsent_buffers;
+
+    struct io_uring_sqe *sqe = get_submission(&worker->ring);
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = connection->sockfd;
+    sqe->addr = (uint64_t) (uintptr_t) &connection->message;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    if(response_file_body_pending(response)) {
+        sqe->msg_flags |= MSG_MORE;
+    }
+    if(link_body) {
+        sqe->flags = IOSQE_IO_LINK;
+        sqe->msg_flags |= MSG_WAITALL;
+    }
+    sqe->user_data = operation_user_data(connection, URING_SEND);
+    connection->pending_operations++;
+
+    if(link_body) {
+        add_body_chunk(worker, connection);
+    }
+    return true;
+}
+
+// Submits the next chunk of the body on its own, once the headers have all been sent.
+static bool submit_body_chunk(uring_worker_t *worker, uring_connection_t *connection) {
+    if(!open_pipe(connection) || !reserve_submissions(&worker->ring, 2)) {
+        return false;
+    }
+    add_body_chunk(worker, connection);
+    return true;
+}
+
+// Submits a splice of whatever is left in the pipe into the socket.
+static bool submit_pipe_drain(uring_worker_t *worker, uring_connection_t *connection) {
+    if(!reserve_submissions(&worker->ring, 1)) {
+        return false;
+    }
+    struct io_uring_sqe *sqe = get_submission(&worker->ring);
+    sqe->opcode = IORING_OP_SPLICE;
+    sqe->fd = connection->sockfd;
+    sqe->off = URING_SPLICE_NO_OFFSET;
+    sqe->splice_fd_in = connection->pipe_fds[0];
+    sqe->splice_off_in = URING_SPLICE_NO_OFFSET;
+    sqe->len = connection->pipe_bytes;
+    if(response_file_body_pending(&connection->response)) {
+        sqe->splice_flags = SPLICE_F_MORE;
+    }
+    sqe->user_data = operation_user_data(connection, URING_SPLICE_TO_SOCKET);
+    connection->pending_operations++;
+    return true;
+}
+
+// Queues up a splice of the next chunk of the body from the file (at the response's offset, so the file position of
+// a shared cached file is never touched) into the pipe, linked to a splice of the same amount from the pipe into the
+// socket. If less than a whole chunk makes it into the pipe, the second splice is cancelled and whatever did make it
+// is drained on its own. SPLICE_F_MORE works like MSG_MORE for every chunk but the last. There must be room for two
+// submissions. https://man7.org/linux/man-pages/man2/splice.2.html
+static void add_body_chunk(uring_worker_t *worker, uring_connection_t *connection) {
+    http_response_t *response = &connection->response;
+    off_t remaining = response->body_end - response->body_offset;
+    unsigned chunk_size = remaining < URING_BODY_CHUNK_SIZE ? (unsigned) remaining : URING_BODY_CHUNK_SIZE;
+
+    struct io_uring_sqe *sqe = get_submission(&worker->ring);
+    sqe->opcode = IORING_OP_SPLICE;
+    sqe->fd = connection->pipe_fds[1];
+    sqe->off = URING_SPLICE_NO_OFFSET;
+    sqe->splice_fd_in = response->file_fd;
+    sqe->splice_off_in = response->body_offset;
+    sqe->len = chunk_size;
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = operation_user_data(connection, URING_SPLICE_TO_PIPE);
+
+    sqe = get_submission(&worker->ring);
+    sqe->opcode = IORING_OP_SPLICE;
+    sqe->fd = connection->sockfd;
+    sqe->off = URING_SPLICE_NO_OFFSET;
+    sqe->splice_fd_in = connection->pipe_fds[0];
+    sqe->splice_off_in = URING_SPLICE_NO_OFFSET;
+    sqe->len = chunk_size;
+    if(remaining > chunk_size) {
+        sqe->splice_flags = SPLICE_F_MORE;
+    }
+    sqe->user_data = operation_user_data(connection, URING_SPLICE_TO_SOCKET);
+    connection->pending_operations += 2;
+}
+
+// Creates the pipe the connection's bodies are spliced through, the first time it is needed. The pipe is kept for
+// the rest of the connection. https://man7.org/linux/man-pages/man2/pipe.2.html
+static bool open_pipe(uring_connection_t *connection) {
+    if(connection->pipe_fds[0] != NO_PIPE) {
+        return true;
+    }
+    if(pipe2(connection->pipe_fds, O_CLOEXEC) < 0) {
+        perror("pipe2");
+        connection->pipe_fds[0] = NO_PIPE;
+        connection->pipe_fds[1] = NO_PIPE;
+        return false;
+    }
+    return true;
+}
+
+// Packs the connection's address and the operation into the user data of a submission, which the kernel hands back
+// in its completion.
+static uint64_t operation_user_data(uring_connection_t *connection, uring_operation_t operation) {
+    return (uint64_t) (uintptr_t) connection | (uint64_t) operation;
+}
+
+// Fills in the parts of a stat struct that the rest of the server uses from what statx returned.
+static void statx_to_stat(struct statx *file_statx, struct stat *file_stat) {
+    file_stat->st_dev = makedev(file_statx->stx_dev_major, file_statx->stx_dev_minor);
+    file_stat->st_ino = file_statx->stx_ino;
+    file_stat->st_mode = file_statx->stx_mode;
+    file_stat->st_nlink = file_statx->stx_nlink;
+    file_stat->st_uid = file_statx->stx_uid;
+    file_stat->st_gid = file_statx->stx_gid;
+    file_stat->st_size = (off_t) file_statx->stx_size;
+    file_stat->st_blksize = (blksize_t) file_statx->stx_blksize;
+    file_stat->st_blocks = (blkcnt_t) file_statx->stx_blocks;
+    file_stat->st_mtim.tv_sec = file_statx->stx_mtime.tv_sec;
+    file_stat->st_mtim.tv_nsec = file_statx->stx_mtime.tv_nsec;
+    file_stat->st_ctim.tv_sec = file_statx->stx_ctime.tv_sec;
+    file_stat->st_ctim.tv_nsec = file_statx->stx_ctime.tv_nsec;
+    file_stat->st_atim.tv_sec = file_statx->stx_atime.tv_sec;
+    file_stat->st_atim.tv_nsec = file_statx->stx_atime.tv_nsec;
+}
+
+// Called once the server starts draining. Cancels the worker's accept, which is found by its user data, so that the
+// server taking over accepts every new connection, and shuts down the worker's idle persistent connections the same
+// way as ones which have run out of time. Connections in the middle of a request or response carry on and are closed
+// once their response has been sent. https://man7.org/linux/man-pages/man2/io_uring_enter.2.html
+static void stop_accepting(uring_worker_t *worker) {
+    if(reserve_submissions(&worker->ring, 1)) {
+        struct io_uring_sqe *sqe = get_submission(&worker->ring);
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = URING_ACCEPT_USER_DATA;
+        sqe->user_data = URING_CANCEL_USER_DATA;
+    }
+    uring_connection_t *connection;
+    while((connection = (uring_connection_t *) deadline_list_first(&worker->keep_alive_deadlines)) != NULL) {
+        deadline_stop(&connection->deadline);
+        shutdown(connection->sockfd, SHUT_RDWR);
+    }
+}
@@ -0,0 +1,168 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_URING_LOOP_H
+#define COMP30023_2022_PROJECT_2_URING_LOOP_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+
+#include "config.h"
+#include "parse.h"
+#include "respond.h"
+#include "file_cache.h"
+#include "event_loop.h"
+#include "access_log.h"
+#include "slab.h"
+#include "deadline.h"
+#include "admission.h"
+#include "upgrade.h"
+#include "affinity.h"
+
+#define URING_QUEUE_DEPTH 256
+#define URING_COMPLETION_QUEUE_DEPTH 4096
+#define URING_MAX_PROBE_OPS 256
+// The default capacity of a pipe, so each splice into the pipe can be taken out again in full.
+#define URING_BODY_CHUNK_SIZE 65536
+#define URING_SPLICE_NO_OFFSET ((uint64_t) -1)
+#define URING_ACCEPT_USER_DATA 0
+// No connection lives at the first few addresses, so none of these can be a connection's user data.
+#define URING_SWEEP_USER_DATA 1
+#define URING_DRAIN_USER_DATA 2
+#define URING_CANCEL_USER_DATA 3
+#define MILLISECONDS_PER_SECOND 1000
+#define NO_PIPE -1
+
+// Connections come from the worker's slab, which rounds every object up to a multiple of max_align_t (at least 8
+// bytes) and lays them out from an aligned start, so the bottom three bits of a connection's address are free to say
+// which of its operations a completion is for.
+#define URING_OPERATION_MASK 7
+
+// The operations that can be in flight for a connection. URING_ACCEPT is only ever used by the listening socket's
+// multishot accept, which has no connection.
+typedef enum uring_operation {
+    URING_ACCEPT,
+    URING_RECEIVE,
+    URING_OPEN,
+    URING_STATX,
+    URING_SEND,
+    URING_SPLICE_TO_PIPE,
+    URING_SPLICE_TO_SOCKET
+} uring_operation_t;
+
+// The stages a connection goes through in the io_uring worker. As in the epoll event loop, every connection starts
+// off reading its request. Files which are not in the file cache are opened and stat'ed through the ring before the
+// response is sent, where the epoll event loop would block on open() and fstat().
+typedef enum uring_connection_state {
+    URING_READING_REQUEST,
+    URING_OPENING_FILE,
+    URING_STATTING_FILE,
+    URING_SENDING_RESPONSE,
+    URING_CLOSING
+} uring_connection_state_t;
+
+// The parts of an io_uring instance that the worker needs, mapped in from the kernel. The submission queue is filled
+// in from sqe_tail, which is only published to the kernel when the worker next calls io_uring_enter, so everything
+// queued up while going through a batch of completions is submitted with a single system call.
+// https://man7.org/linux/man-pages/man7/io_uring.7.html
+typedef struct uring uring_t;
+struct uring {
+    int ring_fd;
+    unsigned sq_entries;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned sqe_tail;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_ring_memory;
+    size_t sq_ring_size;
+    void *cq_ring_memory;
+    size_t cq_ring_size;
+    size_t sqes_size;
+};
+
+// A connection being served by an io_uring worker. A connection can have a few operations in flight at once (such as
+// a send linked to the two splices which move the next chunk of the body), and is only moved on to its next step once
+// all of them have completed. The deadline works the same way as in the epoll event loop. The request is kept here
+// while the file is being opened, since its views point into the buffer. The pipe is only created once a body has to
+// be spliced. The first two times are for the stats, and response_started_at is when the current response was
+// started, for the access log.
+typedef struct uring_connection uring_connection_t;
+struct uring_connection {
+    int sockfd;
+    struct sockaddr_storage client_addr;
+    uring_connection_state_t state;
+    long accepted_at;
+    long open_started_at;
+    long response_started_at;
+    int pending_operations;
+    bool failed;
+    int bytes_read_so_far;
+    size_t request_length;
+    http_parser_t parser;
+    char buffer[REQUEST_MAX_BUFFER_SIZE];
+    http_request_t request;
+    char *file_path;
+    int opened_fd;
+    bool stat_failed;
+    struct statx file_statx;
+    struct iovec unsent_buffers[MAX_RESPONSE_BUFFERS];
+    struct msghdr message;
+    int pipe_fds[2];
+    size_t pipe_bytes;
+    http_response_t response;
+    deadline_t deadline;
+};
+
+// A struct which contains the arguments needed for the uring_worker function. Each worker owns its own ring and
+// every connection it accepts, which come out of its own slab along with the buffers their file paths are built in.
+// open_beneath says whether files are opened with IORING_OP_OPENAT2, which keeps the lookup inside the web root. The
+// deadline lists are the same as an epoll worker's, and are swept every sweep_interval by a timeout on the ring.
+typedef struct uring_worker uring_worker_t;
+struct uring_worker {
+    _Alignas(WORKER_CACHE_LINE_SIZE) pthread_t thread_id;
+    int listen_sockfd;
+    server_config_t *config;
+    uring_t ring;
+    bool multishot_accept;
+    bool open_beneath;
+    struct __kernel_timespec sweep_interval;
+    deadline_list_t keep_alive_deadlines;
+    deadline_list_t header_deadlines;
+    deadline_list_t send_deadlines;
+    slab_t connections;
+    slab_t file_paths;
+};
+
+bool run_uring_loop(int listen_sockfd, server_config_t *config);
+
+void *uring_worker(void *uring_worker_args);
+
+#endif //COMP30023_2022_PROJECT_2_URING_LOOP_H
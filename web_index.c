@@ -0,0 +1,158 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "web_index.h"
+
+static int visit_file(const char *file_path, const struct stat *file_stat, int type, struct FTW *walk);
+static bool add_file(const char *relative_path);
+static bool build_table(void);
+static web_index_entry_t *find_slot(string_view_t path, uint64_t hash);
+
+// Set once at startup, before any worker is started, and never changed after. The walk fills in the list of files,
+// which is then turned into the table. nftw gives its callback no way to pass anything else in.
+static bool index_enabled = false;
+static const char *walked_root_path = NULL;
+static web_index_entry_t *files = NULL;
+static size_t num_files = 0;
+static size_t files_capacity = 0;
+static web_index_entry_t *slots = NULL;
+static size_t slot_mask = 0;
+
+// Walks the web root once and indexes every regular file in it, so that a request for a path which is not in the
+// index can be answered with a 404 without looking anything up on disk, and a precompressed copy which does not exist
+// costs no failed open. The index is never updated, so it is only turned on with --index-web-root, for web roots
+// which do not change while the server runs: a file added later is not served until the server is restarted.
+// Symbolic links to regular files are indexed, but symbolic links to directories are not walked into, so the files
+// under them are not served either. Returns false if the web root could not be walked.
+bool web_index_build(const char *web_root_path) {
+    // Symbolic links are not followed while walking, so the web root path is resolved first in case it is one.
+    char *resolved_root_path = realpath(web_root_path, NULL);
+    if(resolved_root_path == NULL) {
+        perror("realpath");
+        return false;
+    }
+    walked_root_path = resolved_root_path;
+    // https://man7.org/linux/man-pages/man3/nftw.3.html
+    int result = nftw(resolved_root_path, visit_file, WEB_INDEX_MAX_OPEN_DIRECTORIES, FTW_PHYS);
+    if(result < 0) {
+        perror("nftw");
+    }
+    free(resolved_root_path);
+    walked_root_path = NULL;
+    if(result != WEB_INDEX_CONTINUE_WALK || !build_table()) {
+        return false;
+    }
+    index_enabled = true;
+    return true;
+}
+
+bool web_index_enabled(void) {
+    return index_enabled;
+}
+
+// Returns true if the request path leads to a regular file that was in the web root when the index was built. The
+// path is looked up as it is, after its leading slashes, so a path which only leads to a file in a roundabout way
+// (like "/a/./b.html" or "/a//b.html") is not found. The request path must already have been checked for escape
+// components.
+bool web_index_contains(string_view_t request_path) {
+    while(request_path.length > 0 && request_path.data[0] == '/') {
+        request_path.data++;
+        request_path.length--;
+    }
+    return find_slot(request_path, hash_request_path(request_path))->path != NULL;
+}
+
+// Called by nftw for everything in the web root. Regular files are added, and so are symbolic links which lead to
+// one. Anything else is left out, since only regular files are ever served.
+static int visit_file(const char *file_path, const struct stat *file_stat, int type, struct FTW *walk) {
+    // The path nftw gives is the web root path with the path inside it on the end, which is what get_file_path
+    // makes of a request path once the slashes between the two are skipped.
+    const char *relative_path = file_path + strlen(walked_root_path);
+    while(*relative_path == '/') {
+        relative_path++;
+    }
+
+    switch(type) {
+        case FTW_F:
+            if(S_ISREG(file_stat->st_mode) && !add_file(relative_path)) {
+                return WEB_INDEX_STOP_WALK;
+            }
+            break;
+        case FTW_SL: {
+            struct stat target_stat;
+            if(web_root_stat_file(relative_path, &target_stat) == 0 && S_ISREG(target_stat.st_mode) &&
+                    !add_file(relative_path)) {
+                return WEB_INDEX_STOP_WALK;
+            }
+            break;
+        }
+        case FTW_DNR:
+            fprintf(stderr, "Could not read directory %s, the files in it will not be served.\n", file_path);
+            break;
+        default:
+            break;
+    }
+    return WEB_INDEX_CONTINUE_WALK;
+}
+
+// Adds a file to the list, growing it as needed. Returns false if there was no memory.
+static bool add_file(const char *relative_path) {
+    if(num_files == files_capacity) {
+        size_t capacity = files_capacity == 0 ? WEB_INDEX_INITIAL_CAPACITY : files_capacity * 2;
+        web_index_entry_t *grown = (web_index_entry_t *) realloc (files, capacity * sizeof(web_index_entry_t));
+        if(grown == NULL) {
+            perror("realloc");
+            return false;
+        }
+        files = grown;
+        files_capacity = capacity;
+    }
+
+    web_index_entry_t *file = &files[num_files];
+    file->path = strdup(relative_path);
+    if(file->path == NULL) {
+        perror("strdup");
+        return false;
+    }
+    file->path_length = strlen(relative_path);
+    string_view_t path = {.data = file->path, .length = file->path_length};
+    file->hash = hash_request_path(path);
+    num_files++;
+    return true;
+}
+
+// Puts every file in the list into an open addressed table with at least twice as many slots as there are files, so
+// that a lookup rarely goes past its first slot and always reaches an empty one. The entries sit in the table itself
+// rather than behind pointers, so a lookup usually touches one cache line of the table and then the path. The list
+// is freed once the table is built.
+static bool build_table(void) {
+    size_t num_slots = 1;
+    while(num_slots < num_files * WEB_INDEX_SLOTS_PER_FILE) {
+        num_slots <<= 1;
+    }
+    slots = (web_index_entry_t *) calloc (num_slots, sizeof(web_index_entry_t));
+    if(slots == NULL) {
+        perror("calloc");
+        return false;
+    }
+    slot_mask = num_slots - 1;
+
+    for(size_t i = 0; i < num_files; i++) {
+        string_view_t path = {.data = files[i].path, .length = files[i].path_length};
+        *find_slot(path, files[i].hash) = files[i];
+    }
+    free(files);
+    files = NULL;
+    files_capacity = 0;
+    return true;
+}
+
+// Returns the slot that holds the path, or the empty slot it would go in if it is not in the table.
+static web_index_entry_t *find_slot(string_view_t path, uint64_t hash) {
+    size_t slot = hash & slot_mask;
+    while(slots[slot].path != NULL && (slots[slot].hash != hash || slots[slot].path_length != path.length ||
+                                       memcmp(slots[slot].path, path.data, path.length) != 0)) {
+        slot = (slot + 1) & slot_mask;
+    }
+    return &slots[slot];
+}
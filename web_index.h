@@ -0,0 +1,46 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_WEB_INDEX_H
+#define COMP30023_2022_PROJECT_2_WEB_INDEX_H
+
+// nftw() needs this for FTW_PHYS and friends. https://man7.org/linux/man-pages/man3/nftw.3.html
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "parse.h"
+#include "web_root.h"
+
+// nftw keeps up to this many directories open at once while it walks.
+#define WEB_INDEX_MAX_OPEN_DIRECTORIES 32
+#define WEB_INDEX_INITIAL_CAPACITY 1024
+#define WEB_INDEX_SLOTS_PER_FILE 2
+#define WEB_INDEX_CONTINUE_WALK 0
+#define WEB_INDEX_STOP_WALK 1
+
+// A regular file in the web root, by its path relative to the web root (as get_file_path makes it). A slot of the
+// index is empty if path is NULL.
+typedef struct web_index_entry web_index_entry_t;
+struct web_index_entry {
+    uint64_t hash;
+    char *path;
+    size_t path_length;
+};
+
+bool web_index_build(const char *web_root_path);
+
+bool web_index_enabled(void);
+
+bool web_index_contains(string_view_t request_path);
+
+#endif //COMP30023_2022_PROJECT_2_WEB_INDEX_H
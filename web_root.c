@@ -0,0 +1,80 @@
+//
+// Created by User on 17/10/2026.
+//
+#include "web_root.h"
+
+static int openat2_beneath(const char *file_path);
+
+// Set once at startup, before any worker is started.
+static int root_fd = -1;
+static bool resolves_beneath = false;
+static const struct open_how open_how = {
+    .flags = WEB_ROOT_OPEN_FLAGS,
+    .resolve = WEB_ROOT_RESOLVE_FLAGS
+};
+
+// Opens the web root as a directory so that every file is looked up from it, rather than walking the whole path down
+// from / again on every request. O_PATH is enough since the directory is only ever used to look things up in. Then
+// checks whether the kernel has openat2 (Linux 5.6 and up) by looking up the web root itself through it. If it does
+// not, files are opened with plain openat, and what keeps requests inside the web root is parse_request_line only
+// accepting paths which start with a slash together with check_escape_request_path rejecting every ".." component
+// that could climb out. Symbolic links inside the web root are followed wherever they point, like before. Returns
+// false if the web root could not be opened.
+bool web_root_open(const char *web_root_path) {
+    root_fd = open(web_root_path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if(root_fd < 0) {
+        perror("open web root");
+        return false;
+    }
+
+    int fd = openat2_beneath(CURRENT_DIRECTORY);
+    if(fd >= 0) {
+        close(fd);
+        resolves_beneath = true;
+    } else if(errno == ENOSYS || errno == E2BIG || errno == EINVAL) {
+        fprintf(stderr, "openat2 is not available, web root lookups are not checked by the kernel.\n");
+    } else {
+        perror("openat2 web root");
+        return false;
+    }
+    return true;
+}
+
+int web_root_fd(void) {
+    return root_fd;
+}
+
+bool web_root_resolves_beneath(void) {
+    return resolves_beneath;
+}
+
+// How files are opened with openat2, for the io_uring workers which submit the open themselves. The struct has to
+// stay put until the open has been done, which it does since it never changes.
+const struct open_how *web_root_open_how(void) {
+    return &open_how;
+}
+
+// Opens the file at file_path, which is relative to the web root, for reading. Returns the file descriptor, or -1
+// with errno set if there is no such file or it is outside the web root (EXDEV).
+int web_root_open_file(const char *file_path) {
+    if(!resolves_beneath) {
+        return openat(root_fd, file_path, WEB_ROOT_OPEN_FLAGS);
+    }
+    int fd = openat2_beneath(file_path);
+    for(int attempt = 1; fd < 0 && errno == EAGAIN && attempt < WEB_ROOT_OPEN_ATTEMPTS; attempt++) {
+        fd = openat2_beneath(file_path);
+    }
+    return fd;
+}
+
+// Stats the file at file_path, which is relative to the web root, like stat(). Only used to see whether a file which
+// is already open has changed, so a path that now leads outside the web root just shows up as a different file, and
+// is then refused when it is opened again.
+int web_root_stat_file(const char *file_path, struct stat *file_stat) {
+    return fstatat(root_fd, file_path, file_stat, 0);
+}
+
+// glibc has no wrapper for openat2, so it is called through syscall().
+static int openat2_beneath(const char *file_path) {
+    return (int) syscall(SYS_openat2, root_fd, file_path, &open_how, sizeof open_how);
+}
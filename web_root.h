@@ -0,0 +1,45 @@
+//
+// Created by User on 17/10/2026.
+//
+
+#ifndef COMP30023_2022_PROJECT_2_WEB_ROOT_H
+#define COMP30023_2022_PROJECT_2_WEB_ROOT_H
+
+// fstatat() and O_PATH need this. https://man7.org/linux/man-pages/man2/open.2.html
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/syscall.h>
+#include <linux/openat2.h>
+
+// Files are opened for reading only. RESOLVE_BENEATH makes the kernel fail any lookup that would leave the web root,
+// whether through ".." or a symbolic link, and RESOLVE_NO_MAGICLINKS rules out /proc style links which could point
+// anywhere. https://man7.org/linux/man-pages/man2/openat2.2.html
+#define WEB_ROOT_OPEN_FLAGS (O_RDONLY | O_CLOEXEC)
+#define WEB_ROOT_RESOLVE_FLAGS (RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS)
+// openat2 fails with EAGAIN if a rename raced with the lookup, in which case it is worth trying again a few times.
+#define WEB_ROOT_OPEN_ATTEMPTS 3
+#define CURRENT_DIRECTORY "."
+
+bool web_root_open(const char *web_root_path);
+
+int web_root_fd(void);
+
+bool web_root_resolves_beneath(void);
+
+const struct open_how *web_root_open_how(void);
+
+int web_root_open_file(const char *file_path);
+
+int web_root_stat_file(const char *file_path, struct stat *file_stat);
+
+#endif //COMP30023_2022_PROJECT_2_WEB_ROOT_H